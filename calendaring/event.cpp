@@ -19,10 +19,12 @@
 #include "event.h"
 #include <icalendar/icalendar.h>
 #include <kolabformat/kolabobject.h>
+#include <kolabformat/mimeobject.h>
 #include <conversion/kcalconversion.h>
 #include <conversion/commonconversion.h>
 
 #include <iostream>
+#include <QBuffer>
 #include <kolabformat.h>
 #include <kolabevent_p.h>
 
@@ -63,23 +65,22 @@ std::string Event::write() const
 
 bool Event::fromMime(const std::string &input)
 {
-    KMime::Message::Ptr msg = KMime::Message::Ptr(new KMime::Message);
-    msg->setContent( KMime::CRLFtoLF(Kolab::Conversion::fromStdString(input).toUtf8()) );
-    msg->parse();
-    msg->content(KMime::ContentIndex());
-    KolabObjectReader reader(msg);
-    if (reader.getType() != EventObject) {
+    MIMEObject mimeObject;
+    if (mimeObject.parseMessage(input) != EventObject) {
         std::cout << "not an event ";
         return false;
     }
-    const Kolab::Event &e = Kolab::Conversion::fromKCalCore(*reader.getEvent());
-    Kolab::Event::operator=(e);
+    Kolab::Event::operator=(mimeObject.getEvent());
     return true;
 }
 
 std::string Event::toMime() const
 {
-    return std::string(QString(KolabObjectWriter::writeEvent(Kolab::Conversion::toKCalCore(*this))->encodedContent()).toUtf8().constData());
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    KolabObjectWriter::writeEvent(static_cast<const Kolab::Event &>(*this), &buffer);
+    return std::string(data.constData(), data.size());
 }
 
 
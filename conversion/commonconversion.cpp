@@ -19,14 +19,94 @@
 #include "timezoneconverter.h"
 #include <kolabformat/errorhandler.h>
 
-#include <iostream>
 #include <ksystemtimezone.h>
 #include <kdebug.h>
 #include <QUrl>
+#include <QHash>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadStorage>
 
 namespace Kolab {
     namespace Conversion {
 
+//@cond PRIVATE
+struct TimeSpecEntry {
+    KDateTime::Spec spec;
+    /**
+     * False if the timezone could not be resolved, the spec is UTC then
+     */
+    bool valid;
+};
+
+/**
+ * The timezones resolved by a thread.
+ *
+ * Copies of a KTimeZone share a reference count that is not thread-safe in kdelibs4, so each thread reads its own
+ * instances from the system timezone database, and the specs of a cache are only ever copied by its thread.
+ */
+struct TimeSpecCache {
+    TimeSpecCache(): generation(0) {};
+    QHash<QByteArray, TimeSpecEntry> entries;
+    int generation;
+};
+
+static QThreadStorage<TimeSpecCache*> s_timeSpecCache;
+//Bumped by clearTimeSpecCache(), the cache of each thread is cleared on its next use
+static QAtomicInt s_timeSpecGeneration(0);
+static QAtomicInt s_timeSpecHits(0);
+static QAtomicInt s_timeSpecMisses(0);
+//KDateTime::Spec(const KTimeZone&) compares the zone with KTimeZone::utc(), which is shared by all threads
+static QMutex s_utcZoneMutex;
+//@endcond
+
+static TimeSpecCache &timeSpecCache()
+{
+    if (!s_timeSpecCache.hasLocalData()) {
+        s_timeSpecCache.setLocalData(new TimeSpecCache);
+    }
+    TimeSpecCache *cache = s_timeSpecCache.localData();
+    const int generation = s_timeSpecGeneration;
+    if (cache->generation != generation) {
+        cache->entries.clear();
+        cache->generation = generation;
+    }
+    return *cache;
+}
+
+static TimeSpecEntry resolveTimeSpec(const QString &timezone, TimeSpecCache &cache)
+{
+    //Convert non-olson timezones if necessary
+    const QString normalizedTz = TimezoneConverter::normalizeTimezone(timezone);
+    const QByteArray normalizedKey = normalizedTz.toUtf8();
+    const bool alias = (normalizedTz != timezone);
+    if (alias) {
+        //All aliases of a timezone share its spec
+        QHash<QByteArray, TimeSpecEntry>::const_iterator it = cache.entries.constFind(normalizedKey);
+        if (it != cache.entries.constEnd()) {
+            return it.value();
+        }
+    }
+
+    TimeSpecEntry entry;
+    entry.valid = true;
+    if (normalizedTz == QLatin1String("UTC")) {
+        entry.spec = KDateTime::Spec(KDateTime::UTC);
+    } else if (!normalizedTz.isEmpty() && KSystemTimeZones::zones().contains(normalizedTz)) { //Needs ktimezoned (timezone daemon running) http://api.kde.org/4.x-api/kdelibs-apidocs/kdecore/html/classKSystemTimeZones.html
+        //An instance of our own, KSystemTimeZones::zone() returns the one shared by all threads
+        const KTimeZone tz = KSystemTimeZones::readZone(normalizedTz);
+        QMutexLocker locker(&s_utcZoneMutex);
+        entry.spec = KDateTime::Spec(tz);
+    } else {
+        entry.valid = false;
+        entry.spec = KDateTime::Spec(KDateTime::UTC); //Don't crash
+    }
+    if (alias && entry.valid) {
+        cache.entries.insert(normalizedKey, entry);
+    }
+    return entry;
+}
+
 KDateTime::Spec getTimeSpec(bool isUtc, const std::string& timezone)
 {
     if (isUtc) { //UTC
@@ -36,19 +116,48 @@ KDateTime::Spec getTimeSpec(bool isUtc, const std::string& timezone)
         return  KDateTime::Spec(KDateTime::ClockTime);
     }
     //Timezone
-
-    //Convert non-olson timezones if necessary
-    const QString normalizedTz = TimezoneConverter::normalizeTimezone(QString::fromStdString(timezone));
-    Debug() << "normalized " << normalizedTz;
-    KTimeZone tz = KSystemTimeZones::zone(normalizedTz); //Needs ktimezoned (timezone daemon running) http://api.kde.org/4.x-api/kdelibs-apidocs/kdecore/html/classKSystemTimeZones.html
-    if (!tz.isValid()) {
-        Error() << "timezone not found" << QString::fromStdString(timezone);
-        if (!KSystemTimeZones::isTimeZoneDaemonAvailable()) {
-            Error() << "ktimezoned is not available and required for timezone interpretation";
+    const QByteArray key(timezone.data(), timezone.size());
+    TimeSpecCache &cache = timeSpecCache();
+    TimeSpecEntry entry;
+    QHash<QByteArray, TimeSpecEntry>::const_iterator it = cache.entries.constFind(key);
+    const bool cached = (it != cache.entries.constEnd());
+    if (cached) {
+        entry = it.value();
+        s_timeSpecHits.ref();
+    } else {
+        s_timeSpecMisses.ref();
+        entry = resolveTimeSpec(QString::fromStdString(timezone), cache);
+    }
+    const bool daemonAvailable = entry.valid || KSystemTimeZones::isTimeZoneDaemonAvailable();
+    //Without ktimezoned every timezone is unknown, retry once it is available like cityIndex()
+    if (!cached && daemonAvailable) {
+        cache.entries.insert(key, entry);
+    }
+    //Reported on every use, the errors are collected per object
+    if (!entry.valid) {
+        if (!daemonAvailable) {
+            ReportError(Error, TimeZoneDaemonUnavailable, QString());
         }
-        tz = KTimeZone::utc(); //Don't crash
+        ReportError(Error, UnknownTimeZone, QString::fromStdString(timezone));
     }
-    return KDateTime::Spec(tz);
+    return entry.spec;
+}
+
+int timeSpecCacheHits()
+{
+    return s_timeSpecHits;
+}
+
+int timeSpecCacheMisses()
+{
+    return s_timeSpecMisses;
+}
+
+void clearTimeSpecCache()
+{
+    s_timeSpecGeneration.ref();
+    s_timeSpecHits.fetchAndStoreOrdered(0);
+    s_timeSpecMisses.fetchAndStoreOrdered(0);
 }
 
         
@@ -97,7 +206,7 @@ cDateTime fromDate(const KDateTime &dt)
             if (!timezone.isEmpty()) {
                 date.setTimezone(toStdString(timezone));
             } else {
-                Error() << "invalid timezone: " << dt.timeZone().name() << " , assuming floating time";
+                ReportError(Error, UnknownTimeZone, dt.timeZone().name()); //Written as floating time
                 return date;
             }
         } else if (dt.timeType() != KDateTime::ClockTime) {
@@ -143,20 +252,17 @@ std::string fromMailto(const QUrl &mailtoUri, std::string &name)
 {
     const std::string &decoded = toStdString(mailtoUri.toString());
     if (decoded.substr(0, 7).compare("mailto:")) {
-        WARNING("no mailto address");
-        std::cout << decoded << std::endl;
+        ReportError(Warning, NoMailtoAddress, fromStdString(decoded));
         return decoded;
     }
     std::size_t begin = decoded.find('<',7);
     if (begin == std::string::npos) {
-        WARNING("no mailto address");
-        std::cout << decoded << std::endl;
+        ReportError(Warning, NoMailtoAddress, fromStdString(decoded));
         return decoded;
     }
     std::size_t end = decoded.find('>', begin);
     if (end == std::string::npos) {
-        WARNING("no mailto address");
-        std::cout << decoded << std::endl;
+        ReportError(Warning, NoMailtoAddress, fromStdString(decoded));
         return decoded;
     }
     name = decoded.substr(7, begin-7);
@@ -33,8 +33,20 @@ namespace Kolab {
         std::vector<std::string> fromStringList(const QStringList &l);
         /**
          * Returns a UTC, Floating Time or Timezone
+         *
+         * Resolved timezones (and timezones that can't be resolved) are cached by their identifier.
+         * The cache is kept per thread, so the returned spec is only shared with the calling thread.
          */
         KDateTime::Spec getTimeSpec(bool isUtc, const std::string &timezone);
+        /**
+         * Statistics of the timezone cache of getTimeSpec()
+         */
+        KOLAB_EXPORT int timeSpecCacheHits();
+        KOLAB_EXPORT int timeSpecCacheMisses();
+        /**
+         * Clears the timezone caches of all threads and their statistics, i.e. after the system timezones changed.
+         */
+        KOLAB_EXPORT void clearTimeSpecCache();
 
         QUrl toMailto(const std::string &email, const std::string &name = std::string());
         std::string fromMailto(const QUrl &mailtoUri, std::string &name);
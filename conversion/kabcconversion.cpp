@@ -18,9 +18,9 @@
 #include "kabcconversion.h"
 
 #include "commonconversion.h"
+#include "picturecache.h"
 #include <kcalcore/freebusyurlstore.h>
 #include <kdebug.h>
-#include <qbuffer.h>
 #include "kolabformat/errorhandler.h"
 
 
@@ -189,19 +189,19 @@ int fromAddressType(int kabcType, bool &pref)
 {
     int type = 0;
     if (kabcType & KABC::Address::Dom) {
-        Warning() << "domestic address is not supported";
+        ReportError(Warning, NotSupported, QLatin1String("domestic address"));
     } 
     if (kabcType & KABC::Address::Intl) {
-        Warning() << "international address is not supported";
+        ReportError(Warning, NotSupported, QLatin1String("international address"));
     } 
     if (kabcType & KABC::Address::Pref) {
         pref = true;
     } 
     if (kabcType & KABC::Address::Postal) {
-        Warning() << "postal address is not supported";
+        ReportError(Warning, NotSupported, QLatin1String("postal address"));
     } 
     if (kabcType & KABC::Address::Parcel) {
-        Warning() << "parcel is not supported";
+        ReportError(Warning, NotSupported, QLatin1String("parcel"));
     } 
     if (kabcType & KABC::Address::Home) {
         type |= Kolab::Address::Home;
@@ -255,16 +255,16 @@ int fromPhoneType(int kabcType, bool &pref)
         type |= Kolab::Telephone::Video;
     } 
     if (kabcType & KABC::PhoneNumber::Bbs) {
-        Warning() << "mailbox number is not supported";
+        ReportError(Warning, NotSupported, QLatin1String("mailbox number"));
     } 
     if (kabcType & KABC::PhoneNumber::Modem) {
-        Warning() << "modem is not supported";
+        ReportError(Warning, NotSupported, QLatin1String("modem"));
     } 
     if (kabcType & KABC::PhoneNumber::Car) {
         type |= Kolab::Telephone::Car;
     } 
     if (kabcType & KABC::PhoneNumber::Isdn) {
-        Warning() << "isdn number is not supported";
+        ReportError(Warning, NotSupported, QLatin1String("isdn number"));
     } 
     if (kabcType & KABC::PhoneNumber::Pcs) {
         type |= Kolab::Telephone::Text;
@@ -316,12 +316,7 @@ KABC::PhoneNumber::Type toPhoneType(int types, bool pref)
 
 std::string fromPicture(const KABC::Picture &pic, std::string &mimetype)
 {    
-    QByteArray input;
-    QBuffer buffer( &input );
-    buffer.open( QIODevice::WriteOnly );
     QImage img;
-        
-    
     if ( pic.isIntern() ) {
         if ( !pic.data().isNull() ) {
             img = pic.data();
@@ -339,25 +334,13 @@ std::string fromPicture(const KABC::Picture &pic, std::string &mimetype)
         Error() << "invalid picture";
         return std::string();
     }
-    if ( !img.hasAlphaChannel() ) {
-        if (!img.save( &buffer, "JPEG" )) {
-            Error() << "error on jpeg save";
-            return std::string();
-        }
-        mimetype = "image/jpeg";
-    } else {
-        if (!img.save( &buffer, "PNG" )) {
-            Error() << "error on png save";
-            return std::string();
-        }
-        mimetype = "image/png";
-    }
-    return std::string(input.data(), input.size());
+    //Identical pictures are only encoded once
+    return PictureCache::instance().encode(img, mimetype);
 }
 
 KABC::Picture toPicture(const std::string &data, const std::string &mimetype) {
-    QImage img;
-    if (!img.loadFromData( QByteArray::fromRawData(data.data(), data.size()) )) {
+    const QImage &img = PictureCache::instance().decode(data);
+    if (img.isNull()) {
         Error() << "failed to load picture";
     }
     
@@ -786,7 +769,7 @@ Kolab::Contact fromKABC(const KABC::Addressee &addressee)
     
     
     if (!addressee.sound().isEmpty()) {
-        Warning() << "sound is not supported";
+        ReportError(Warning, NotSupported, QLatin1String("sound"));
     }
     
     const std::string &profession = toStdString(addressee.custom( "KADDRESSBOOK", "X-Profession" ));
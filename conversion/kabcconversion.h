@@ -37,6 +37,24 @@ namespace Kolab {
         KOLAB_EXPORT KABC::ContactGroup toKABC(const Kolab::DistList &);
         KOLAB_EXPORT Kolab::DistList fromKABC(const KABC::ContactGroup &);
 
+        /**
+         * Shares identical contact pictures between the contacts converted while a batch exists (i.e. one address book folder).
+         *
+         * Pictures are only cached while at least one batch exists, and are released when the last batch is destroyed.
+         * The batches of several threads share the cache.
+         */
+        class KOLAB_EXPORT PictureCacheBatch {
+        public:
+            /**
+             * @param maxKilobytes the maximum size of the cached images and data
+             */
+            explicit PictureCacheBatch(int maxKilobytes = 8 * 1024);
+            ~PictureCacheBatch();
+        private:
+            PictureCacheBatch(const PictureCacheBatch &);
+            PictureCacheBatch &operator=(const PictureCacheBatch &);
+        };
+
     };
 };
 
@@ -295,13 +295,13 @@ void setIncidence(KCalCore::Incidence &i, const T &e)
         }
         if (!a.delegatedTo().empty()) {
             if (a.delegatedTo().size() > 1) {
-                WARNING("multiple delegatees are not supported");
+                ReportError(Warning, MultipleDelegatees, QString());
             }
             attendee->setDelegate(toMailto(a.delegatedTo().front().email(), a.delegatedTo().front().name()).toString());
         }
         if (!a.delegatedFrom().empty()) {
             if (a.delegatedFrom().size() > 1) {
-                WARNING("multiple delegators are not supported");
+                ReportError(Warning, MultipleDelegators, QString());
             }
             attendee->setDelegator(toMailto(a.delegatedFrom().front().email(), a.delegatedFrom().front().name()).toString());
         }
@@ -381,7 +381,8 @@ void getIncidence(T &i, const I &e)
         if (ptr->isUri()) {
             a.setUri(toStdString(ptr->uri()), toStdString(ptr->mimeType()));
         } else {
-            a.setData(std::string(ptr->decodedData().data(), ptr->decodedData().size()), toStdString(ptr->mimeType()));
+            const QByteArray &data = ptr->decodedData(); //Decodes on every call
+            a.setData(std::string(data.constData(), data.size()), toStdString(ptr->mimeType()));
         }
         a.setLabel(toStdString(ptr->label()));
         attachments.push_back(a);
@@ -639,7 +640,7 @@ void getRecurrence(T &i, const I &e)
     i.setExceptionDates(exdates);
     
     if (!rec->exRules().empty()) {
-        Warning() << "exrules are not supported";
+        ReportError(Warning, NotSupported, QLatin1String("exrules"));
     }
 }
 
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "picturecache.h"
+#include "kabcconversion.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QVector>
+#include "kolabformat/errorhandler.h"
+
+namespace Kolab {
+    namespace Conversion {
+
+PictureCache PictureCache::s_instance;
+
+static QByteArray dataKey(const std::string &data)
+{
+    return 'd' + QCryptographicHash::hash(QByteArray::fromRawData(data.data(), data.size()), QCryptographicHash::Sha1);
+}
+
+static QByteArray imageKey(const QImage &image)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const int header[3] = { image.width(), image.height(), image.format() };
+    hash.addData(reinterpret_cast<const char*>(header), sizeof(header));
+    const QVector<QRgb> &colorTable = image.colorTable();
+    hash.addData(reinterpret_cast<const char*>(colorTable.constData()), colorTable.size() * sizeof(QRgb));
+    //Only the pixels, the padding at the end of the scanlines is undefined
+    const int lineSize = (image.width() * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y) {
+        hash.addData(reinterpret_cast<const char*>(image.scanLine(y)), lineSize);
+    }
+    return 'i' + hash.result();
+}
+
+PictureCache::PictureCache()
+:   mEntries(0),
+    mBatches(0)
+{
+}
+
+PictureCache &PictureCache::instance()
+{
+    return s_instance;
+}
+
+void PictureCache::insert(const QByteArray &key, const Entry &entry)
+{
+    if (!mBatches) {
+        return;
+    }
+    const int cost = (entry.image.byteCount() + static_cast<int>(entry.data.size())) / 1024 + 1;
+    mEntries.insert(key, new Entry(entry), cost);
+}
+
+QImage PictureCache::decode(const std::string &data)
+{
+    const QByteArray &key = dataKey(data);
+    {
+        QMutexLocker locker(&mMutex);
+        if (const Entry *entry = mEntries.object(key)) {
+            return entry->image;
+        }
+    }
+
+    QByteArray rawData = QByteArray::fromRawData(data.data(), data.size());
+    QBuffer buffer(&rawData);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    Entry entry;
+    if (!reader.read(&entry.image)) {
+        return QImage();
+    }
+    entry.data = data;
+    //The data is written back with the type it actually has
+    entry.mimetype = "image/" + std::string(reader.format().toLower().constData());
+    const QByteArray &pixelKey = imageKey(entry.image);
+    QMutexLocker locker(&mMutex);
+    insert(key, entry);
+    insert(pixelKey, entry);
+    return entry.image;
+}
+
+std::string PictureCache::encode(const QImage &image, std::string &mimetype)
+{
+    const QByteArray &key = imageKey(image);
+    {
+        QMutexLocker locker(&mMutex);
+        if (const Entry *entry = mEntries.object(key)) {
+            mimetype = entry->mimetype;
+            return entry->data;
+        }
+    }
+
+    QByteArray encoded;
+    QBuffer buffer(&encoded);
+    buffer.open(QIODevice::WriteOnly);
+    Entry entry;
+    entry.image = image;
+    if (!image.hasAlphaChannel()) {
+        if (!image.save(&buffer, "JPEG")) {
+            Error() << "error on jpeg save";
+            return std::string();
+        }
+        entry.mimetype = "image/jpeg";
+    } else {
+        if (!image.save(&buffer, "PNG")) {
+            Error() << "error on png save";
+            return std::string();
+        }
+        entry.mimetype = "image/png";
+    }
+    entry.data.assign(encoded.constData(), encoded.size());
+    mimetype = entry.mimetype;
+    const QByteArray &encodedKey = dataKey(entry.data);
+    QMutexLocker locker(&mMutex);
+    insert(key, entry);
+    insert(encodedKey, entry);
+    return entry.data;
+}
+
+void PictureCache::beginBatch(int maxKilobytes)
+{
+    QMutexLocker locker(&mMutex);
+    if (!mBatches++ || maxKilobytes > mEntries.maxCost()) {
+        mEntries.setMaxCost(maxKilobytes);
+    }
+}
+
+void PictureCache::endBatch()
+{
+    QMutexLocker locker(&mMutex);
+    Q_ASSERT(mBatches > 0);
+    if (!--mBatches) {
+        mEntries.clear();
+        mEntries.setMaxCost(0);
+    }
+}
+
+void PictureCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mEntries.clear();
+}
+
+PictureCacheBatch::PictureCacheBatch(int maxKilobytes)
+{
+    PictureCache::instance().beginBatch(maxKilobytes);
+}
+
+PictureCacheBatch::~PictureCacheBatch()
+{
+    PictureCache::instance().endBatch();
+}
+
+    }
+}
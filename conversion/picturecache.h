@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KOLABPICTURECACHE_H
+#define KOLABPICTURECACHE_H
+
+#include <QImage>
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+#include <string>
+
+namespace Kolab {
+    namespace Conversion {
+
+/**
+ * A content-addressed cache of contact pictures.
+ *
+ * Address books often share identical pictures between many contacts (i.e. the company logo),
+ * with the cache these are only decoded and encoded once, and all contacts share the same image and data.
+ * Decoded pictures are looked up by a hash of the encoded data, encoded pictures by a hash of the pixels.
+ * A picture that has been decoded is encoded to its original data again.
+ *
+ * Nothing is cached outside of a PictureCacheBatch, so the cache doesn't hold memory for the lifetime of the process.
+ *
+ * The cache is thread-safe.
+ */
+class PictureCache
+{
+public:
+    static PictureCache &instance();
+
+    /**
+     * Returns the decoded @param data, or a null image if it can't be decoded.
+     */
+    QImage decode(const std::string &data);
+
+    /**
+     * Returns @param image encoded as jpeg, or png if it has an alpha channel, and sets @param mimetype.
+     *
+     * Returns an empty string if the image can't be encoded.
+     */
+    std::string encode(const QImage &image, std::string &mimetype);
+
+    /**
+     * Enables the cache until the matching endBatch(), see PictureCacheBatch.
+     *
+     * The maximum size of the cached images and data is the largest @param maxKilobytes of the active batches.
+     */
+    void beginBatch(int maxKilobytes);
+    /**
+     * Clears and disables the cache if this was the last active batch.
+     */
+    void endBatch();
+    void clear();
+
+private:
+    PictureCache();
+
+    struct Entry {
+        QImage image;
+        std::string data;
+        std::string mimetype;
+    };
+    void insert(const QByteArray &key, const Entry &entry);
+
+    static PictureCache s_instance;
+    QMutex mMutex;
+    QCache<QByteArray, Entry> mEntries;
+    int mBatches;
+};
+
+    }
+}
+
+#endif
@@ -19,17 +19,19 @@
 #include <ktimezone.h>
 #include <ksystemtimezone.h>
 #include <kdebug.h>
-#include <QRegExp>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
 #include <QStringList>
 #include "kolabformat/errorhandler.h"
 
 QString TimezoneConverter::normalizeTimezone(const QString& tz)
 {
-    KTimeZone timezone = KSystemTimeZones::zone(tz); //Needs ktimezoned (timezone daemon running) http://api.kde.org/4.x-api/kdelibs-apidocs/kdecore/html/classKSystemTimeZones.html
-    if (timezone.isValid()) {
+    //Only the name is looked up, copying the KTimeZone instances of KSystemTimeZones is not thread-safe
+    if (tz == QLatin1String("UTC") || KSystemTimeZones::zones().contains(tz)) { //Needs ktimezoned (timezone daemon running) http://api.kde.org/4.x-api/kdelibs-apidocs/kdecore/html/classKSystemTimeZones.html
         return tz;
     } else if (!KSystemTimeZones::isTimeZoneDaemonAvailable()) {
-        Error() << "ktimezoned is not available and required for timezone interpretation";
+        ReportError(Error, TimeZoneDaemonUnavailable, QString());
     }
     //We're dealing with an invalid or unknown timezone, try to parse it
     QString guessedTimezone = fromCityName(tz);
@@ -49,36 +51,69 @@ QString TimezoneConverter::fromGMTOffsetTimezone(const QString& tz)
     return QString();
 }
 
-QString TimezoneConverter::fromCityName(const QString& tz)
+static QMutex s_indexMutex;
+static QHash<QString, QString> s_cities;
+
+/**
+ * Returns the olson timezones by their city name.
+ *
+ * The index is built once, but retried as long as no system timezones are available.
+ */
+static QHash<QString, QString> cityIndex()
 {
-    const KTimeZones::ZoneMap zones = KSystemTimeZones::zones();
-    KTimeZones::ZoneMap::const_iterator it = zones.constBegin();
-    QHash<QString, QString> countryMap;
-    for(;it != zones.constEnd(); it++) {
-        const QString cityName = it.key().split('/').last();
-//         kDebug() << it.key() << it.value().name() << cityName;
-        Q_ASSERT(!countryMap.contains(cityName));
-        countryMap.insert(cityName, it.key());
+    QMutexLocker locker(&s_indexMutex);
+    if (s_cities.isEmpty()) {
+        const KTimeZones::ZoneMap zones = KSystemTimeZones::zones();
+        KTimeZones::ZoneMap::const_iterator it = zones.constBegin();
+        for(;it != zones.constEnd(); it++) {
+            const QString cityName = it.key().split('/').last();
+//             kDebug() << it.key() << it.value().name() << cityName;
+            Q_ASSERT(!s_cities.contains(cityName));
+            s_cities.insert(cityName, it.key());
+        }
     }
+    return s_cities;
+}
+
+//The word characters of QRegExp's \b
+static bool isWordCharacter(const QChar &c)
+{
+    return c.isLetterOrNumber() || c.isMark() || c == QLatin1Char('_');
+}
 
-    QRegExp locationFinder("\\b([a-zA-Z])+\\b", Qt::CaseSensitive, QRegExp::RegExp2);
+static bool isAsciiLetter(const QChar &c)
+{
+    const ushort u = c.unicode();
+    return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z');
+}
+
+QString TimezoneConverter::fromCityName(const QString& tz)
+{
+    const QHash<QString, QString> &cities = cityIndex();
+    //Look up all words consisting of letters only, like "\b([a-zA-Z])+\b" would find them
+    const int size = tz.size();
     int pos = 0;
-    while (pos >= 0) {
-        pos = locationFinder.indexIn(tz, pos);
-        if (pos >= 0) {
-            ++pos;
+    while (pos < size) {
+        if (!isWordCharacter(tz.at(pos))) {
+            pos++;
+            continue;
         }
-        const QString location = locationFinder.capturedTexts().first();
-//         kDebug() << "location " << location;
-        if (countryMap.contains(location)) {
-//             kDebug() << "found match " << countryMap.value(location);
-            return countryMap.value(location);
+        const int start = pos;
+        bool letters = true;
+        for (; pos < size && isWordCharacter(tz.at(pos)); pos++) {
+            letters = letters && isAsciiLetter(tz.at(pos));
+        }
+        if (letters) {
+            QHash<QString, QString>::const_iterator it = cities.constFind(tz.mid(start, pos - start));
+            if (it != cities.constEnd()) {
+//                 kDebug() << "found match " << it.value();
+                return it.value();
+            }
         }
     }
     return QString();
 }
 
-
 //Based on
 // * http://msdn.microsoft.com/en-us/library/ms912391(v=winembedded.11).aspx
 // * http://technet.microsoft.com/en-us/library/cc749073(v=ws.10).aspx
@@ -172,17 +207,128 @@ static const struct WindowsTimezone {
 };
 static const int numWindowsTimezones = sizeof windowsTimezones / sizeof *windowsTimezones;
 
-QString TimezoneConverter::fromHardcodedList(const QString& tz)
+//@cond PRIVATE
+/**
+ * Finds all specifiers and names of windowsTimezones contained in a string in a single pass (Aho-Corasick).
+ */
+class WindowsTimezoneMatcher
+{
+public:
+    WindowsTimezoneMatcher();
+
+    /**
+     * Returns the index of the first entry of windowsTimezones with its specifier or name contained in @param tz, or -1.
+     */
+    int match(const QString &tz) const;
+
+private:
+    struct Node {
+        Node(): fail(0), entry(-1) {}
+        QHash<ushort, int> next;
+        int fail;
+        /**
+         * The first entry of the patterns ending in this node, including the ones ending in its failure links
+         */
+        int entry;
+    };
+    void add(const char *pattern, int entry);
+
+    QVector<Node> mNodes;
+};
+
+static void setFirstEntry(int &entry, int candidate)
+{
+    if (candidate >= 0 && (entry < 0 || candidate < entry)) {
+        entry = candidate;
+    }
+}
+
+WindowsTimezoneMatcher::WindowsTimezoneMatcher()
 {
-    for (int i = 0; i <numWindowsTimezones; i++) {
-        const WindowsTimezone &windowsTimezone = windowsTimezones[i];
-        const QByteArray specifier(windowsTimezone.timezoneSpecifier);
-        const QByteArray windowsName(windowsTimezone.name);
-        if ((!specifier.isEmpty() && tz.contains(specifier)) ||
-            (!windowsName.isEmpty() && tz.contains(windowsName))) {
-            //TODO find the olson timezone matching the local timezone if we have multiple to map to
-            return QString::fromLatin1(windowsTimezone.olson[0]);
+    mNodes.append(Node());
+    for (int i = 0; i < numWindowsTimezones; i++) {
+        add(windowsTimezones[i].timezoneSpecifier, i);
+        add(windowsTimezones[i].name, i);
+    }
+
+    //Breadth first, so the failure link of a node is complete before the node itself
+    QList<int> queue;
+    foreach (int child, mNodes.at(0).next) {
+        queue.append(child);
+    }
+    while (!queue.isEmpty()) {
+        const int state = queue.takeFirst();
+        const QHash<ushort, int> next = mNodes.at(state).next;
+        for (QHash<ushort, int>::const_iterator it = next.constBegin(); it != next.constEnd(); ++it) {
+            int fail = mNodes.at(state).fail;
+            while (fail && !mNodes.at(fail).next.contains(it.key())) {
+                fail = mNodes.at(fail).fail;
+            }
+            fail = mNodes.at(fail).next.value(it.key(), 0);
+            Node &child = mNodes[it.value()];
+            child.fail = fail;
+            setFirstEntry(child.entry, mNodes.at(fail).entry);
+            queue.append(it.value());
         }
     }
-    return QString();
+}
+
+void WindowsTimezoneMatcher::add(const char *pattern, int entry)
+{
+    const QString p = QString::fromLatin1(pattern);
+    if (p.isEmpty()) {
+        return;
+    }
+    int state = 0;
+    for (int i = 0; i < p.size(); i++) {
+        const ushort c = p.at(i).unicode();
+        int next = mNodes.at(state).next.value(c, -1);
+        if (next < 0) {
+            next = mNodes.size();
+            mNodes.append(Node());
+            mNodes[state].next.insert(c, next);
+        }
+        state = next;
+    }
+    setFirstEntry(mNodes[state].entry, entry);
+}
+
+int WindowsTimezoneMatcher::match(const QString &tz) const
+{
+    int entry = -1;
+    int state = 0;
+    for (int i = 0; i < tz.size(); i++) {
+        const ushort c = tz.at(i).unicode();
+        while (state && !mNodes.at(state).next.contains(c)) {
+            state = mNodes.at(state).fail;
+        }
+        state = mNodes.at(state).next.value(c, 0);
+        setFirstEntry(entry, mNodes.at(state).entry);
+    }
+    return entry;
+}
+
+static WindowsTimezoneMatcher *s_windowsTimezoneMatcher = 0;
+
+/**
+ * The matcher is built on first use and immutable afterwards
+ */
+static const WindowsTimezoneMatcher &windowsTimezoneMatcher()
+{
+    QMutexLocker locker(&s_indexMutex);
+    if (!s_windowsTimezoneMatcher) {
+        s_windowsTimezoneMatcher = new WindowsTimezoneMatcher;
+    }
+    return *s_windowsTimezoneMatcher;
+}
+//@endcond
+
+QString TimezoneConverter::fromHardcodedList(const QString& tz)
+{
+    const int entry = windowsTimezoneMatcher().match(tz);
+    if (entry < 0) {
+        return QString();
+    }
+    //TODO find the olson timezone matching the local timezone if we have multiple to map to
+    return QString::fromLatin1(windowsTimezones[entry].olson[0]);
 }
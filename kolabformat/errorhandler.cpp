@@ -21,76 +21,215 @@
 #include <qdebug.h>
 #include <QTime>
 #include <QStringList>
-#include <qmutex.h>
+#include <QThreadStorage>
 #include <iostream>
 
 #include <kolabformat.h>
 
 namespace Kolab {
 
-QMutex mutex;
-    
+static QThreadStorage<ErrorHandler*> threadErrorHandler;
+
+const int ErrorHandler::Capacity;
+ErrorHandler::Severity ErrorHandler::s_logThreshold = ErrorHandler::Debug;
+bool ErrorHandler::s_outputEnabled = true;
+
+ErrorHandler &ErrorHandler::instance()
+{
+    if (!threadErrorHandler.hasLocalData()) {
+        threadErrorHandler.setLocalData(new ErrorHandler);
+    }
+    return *threadErrorHandler.localData();
+}
+
 void logMessage(const QString &message, const QString &file, int line, ErrorHandler::Severity s)
 {
     ErrorHandler::instance().addError(s, message, file+" "+QString::number(line));
 }
 
+ErrorHandler::ErrorHandler()
+:   m_worstError(Debug),
+    m_first(0),
+    m_count(0),
+    m_dropped(0),
+    m_rendered(true)
+{
+}
 
-void ErrorHandler::addError(ErrorHandler::Severity s, const QString& message, const QString &location)
+QString ErrorHandler::render(const Record &r)
 {
-    QMutexLocker locker(&mutex);
-    QString filename = location;
-    if (!filename.split(QLatin1Char('/')).isEmpty()) {
-       filename = filename.split(QLatin1Char('/')).last();
+    switch (r.code) {
+        case NoKolabObject:
+            return QLatin1String("no kolab object found");
+        case NoMailtoAddress:
+            return QLatin1String("no mailto address: ") + r.argument;
+        case MultipleDelegatees:
+            return QLatin1String("multiple delegatees are not supported");
+        case MultipleDelegators:
+            return QLatin1String("multiple delegators are not supported");
+        case AttachmentNotFound:
+            return QLatin1String("could not find attachment: ") + r.argument;
+        case NoKolabTypeHeader:
+            return QLatin1String("could not find the X-Kolab-Type Header");
+        case UnsupportedVersion:
+            return QLatin1String("Kolab Version Header available but not on the same version as the implementation: ") + r.argument;
+        case TimeZoneDaemonUnavailable:
+            return QLatin1String("ktimezoned is not available and required for timezone interpretation");
+        case UnknownTimeZone:
+            return QLatin1String("timezone not found: ") + r.argument;
+        case NotSupported:
+            return r.argument + QLatin1String(" is not supported");
+        case Message:
+        case LibkolabxmlError:
+            break;
     }
-    const QString output = QTime::currentTime().toString(QLatin1String("(hh:mm:ss) ")) + filename + QLatin1String(":\t") + message;
-    std::cout << output.toStdString() << std::endl;
-    if (s == Debug) {
+    return r.argument;
+}
+
+QString ErrorHandler::location(const Record &r)
+{
+    if (!r.file) {
+        return r.location;
+    }
+    if (r.line <= 0) {
+        return QString::fromLatin1(r.file);
+    }
+    return QString::fromLatin1(r.file) + "(" + QString::number(r.line)+")";
+}
+
+void ErrorHandler::print(const Record &r) const
+{
+    const QString &l = location(r);
+    const QString filename = l.mid(l.lastIndexOf(QLatin1Char('/')) + 1);
+    const QString output = QTime::currentTime().toString(QLatin1String("(hh:mm:ss) ")) + filename + QLatin1String(":\t") + render(r);
+    if (r.severity >= Error) {
+        std::cout << output.toStdString() << std::endl;
+    } else {
+        std::cout << output.toStdString() << '\n';
+    }
+}
+
+void ErrorHandler::record(const Record &r)
+{
+    if (isLogged(r.severity)) {
+        print(r);
+    }
+    if (r.severity == Debug) {
         return;
     }
-    if (s > m_worstError) {
-        m_worstError = s;
-        m_worstErrorMessage = message;
+    if (r.severity > m_worstError) {
+        m_worstError = r.severity;
+        m_worstRecord = r;
+    }
+    if (m_count < Capacity) {
+        m_records[(m_first + m_count) % Capacity] = r;
+        m_count++;
+    } else {
+        //Overwrite the oldest error
+        m_records[m_first] = r;
+        m_first = (m_first + 1) % Capacity;
+        m_dropped++;
     }
-    m_errorQueue.append(Err(s, message, location));
+    m_rendered = false;
+}
+
+void ErrorHandler::addError(ErrorHandler::Severity s, const QString& message, const QString &location)
+{
+    Record r;
+    r.severity = s;
+    r.argument = message;
+    r.location = location;
+    record(r);
+}
+
+void ErrorHandler::addError(ErrorHandler::Severity s, ErrorHandler::Code code, const QString &argument, const char *file, int line)
+{
+    Record r;
+    r.severity = s;
+    r.code = code;
+    r.argument = argument;
+    r.file = file;
+    r.line = line;
+    record(r);
+}
+
+void ErrorHandler::setLogThreshold(ErrorHandler::Severity threshold)
+{
+    s_logThreshold = threshold;
+}
+
+ErrorHandler::Severity ErrorHandler::logThreshold()
+{
+    return s_logThreshold;
+}
+
+void ErrorHandler::setOutputEnabled(bool enabled)
+{
+    s_outputEnabled = enabled;
 }
 
 ErrorHandler::Severity ErrorHandler::error() const
 {
-    QMutexLocker locker(&mutex);
     return m_worstError;
 }
 
+ErrorHandler::Code ErrorHandler::errorCode() const
+{
+    return m_worstRecord.code;
+}
+
 QString ErrorHandler::errorMessage() const
 {
-    QMutexLocker locker(&mutex);
-    return m_worstErrorMessage;
+    if (m_worstError == Debug) {
+        return QString();
+    }
+    return render(m_worstRecord);
 }
 
 const QList< ErrorHandler::Err >& ErrorHandler::getErrors() const
 {
-    QMutexLocker locker(&mutex);
-    return m_errorQueue;
+    if (!m_rendered) {
+        m_renderedErrors.clear();
+        for (int i = 0; i < m_count; i++) {
+            const Record &r = m_records[(m_first + i) % Capacity];
+            m_renderedErrors.append(Err(r.severity, render(r), location(r), r.code));
+        }
+        m_rendered = true;
+    }
+    return m_renderedErrors;
+}
+
+int ErrorHandler::droppedErrors() const
+{
+    return m_dropped;
 }
 
 void ErrorHandler::clear()
 {
-    QMutexLocker locker(&mutex);
-    m_errorQueue.clear();
+    for (int i = 0; i < m_count; i++) {
+        //Release the arguments
+        m_records[(m_first + i) % Capacity] = Record();
+    }
+    m_first = 0;
+    m_count = 0;
+    m_dropped = 0;
     m_worstError = Debug;
+    m_worstRecord = Record();
+    m_renderedErrors.clear();
+    m_rendered = true;
 }
 
 void ErrorHandler::handleLibkolabxmlErrors()
 {
     switch (Kolab::error()) {
         case Kolab::Warning:
-            instance().addError(ErrorHandler::Warning, QString::fromStdString(Kolab::errorMessage()), "libkolabxml");
+            instance().addError(ErrorHandler::Warning, LibkolabxmlError, QString::fromStdString(Kolab::errorMessage()), "libkolabxml", 0);
             break;
         case Kolab::Error:
-            instance().addError(ErrorHandler::Error, QString::fromStdString(Kolab::errorMessage()), "libkolabxml");
+            instance().addError(ErrorHandler::Error, LibkolabxmlError, QString::fromStdString(Kolab::errorMessage()), "libkolabxml", 0);
             break;
         case Kolab::Critical:
-            instance().addError(ErrorHandler::Critical, QString::fromStdString(Kolab::errorMessage()), "libkolabxml");
+            instance().addError(ErrorHandler::Critical, LibkolabxmlError, QString::fromStdString(Kolab::errorMessage()), "libkolabxml", 0);
             break;
         default:
             //Do nothing, there is no message available in this case
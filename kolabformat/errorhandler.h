@@ -37,8 +37,13 @@ namespace Kolab {
  * 
  * all non-const functions are not for the user of this class and only exist for internal usage.
  * 
+ * Errors are recorded as code with an argument in a buffer of fixed capacity, and only rendered to text when they are read.
+ * If more than Capacity errors are reported during an operation, the oldest ones are dropped (the worst error is always kept).
+ * 
+ * Every thread has its own error handler, so operations running concurrently in different threads
+ * don't see (or clear) each others errors. Recording an error requires no locking.
+ * 
  * TODO: Hide everything which is not meant for the user from the interface.
- * FIXME: Use Threadlocal storage to make this threadsafe.
  */
 class KOLAB_EXPORT ErrorHandler
 {
@@ -50,22 +55,57 @@ public:
         Critical //Critical error, produced object cannot be used and should be thrown away (writing back will result in dataloss).
     };
     
+    /**
+     * Numeric error codes, the error text is only built when the errors are read.
+     */
+    enum Code {
+        Message, //A free form message, the argument is the message
+        LibkolabxmlError, //The argument is the message of libkolabxml
+        NoKolabObject,
+        NoMailtoAddress,
+        MultipleDelegatees,
+        MultipleDelegators,
+        AttachmentNotFound, //The argument is the uri or name of the attachment
+        NoKolabTypeHeader,
+        UnsupportedVersion, //The argument is the version of the message
+        TimeZoneDaemonUnavailable,
+        UnknownTimeZone, //The argument is the name of the timezone
+        NotSupported //The argument is the name of the unsupported property
+    };
+    
     struct Err {
-        Err(Severity s, const QString &m, const QString &l): severity(s), message(m), location(l){};
+        Err(Severity s, const QString &m, const QString &l, Code c = Message): severity(s), message(m), location(l), code(c){};
         Severity severity;
         QString message;
         QString location;
+        Code code;
     };
     
-    static ErrorHandler &instance()
-    {
-        static ErrorHandler inst;
-        return inst;
-    }
+    /**
+     * The number of errors which are kept, older errors are dropped.
+     */
+    static const int Capacity = 64;
+    
+    /**
+     * Returns the error handler of the calling thread.
+     */
+    static ErrorHandler &instance();
     
     void addError(Severity s, const QString &message, const QString &location);
+    /**
+     * Records an error by code, @param file must be a string literal (i.e. __FILE__).
+     */
+    void addError(Severity s, Code code, const QString &argument, const char *file, int line);
+    /**
+     * Returns the last Capacity errors, oldest first.
+     */
     const QList <Err> &getErrors() const;
+    /**
+     * The number of errors which didn't fit into the buffer since the last clear().
+     */
+    int droppedErrors() const;
     Severity error() const;
+    Code errorCode() const;
     QString errorMessage() const;
     void clear();
     
@@ -79,6 +119,39 @@ public:
         ErrorHandler::instance().clear();
     }
     
+    /**
+     * Messages with a severity below @param threshold are neither formatted nor printed.
+     * 
+     * Warnings and errors below the threshold are still recorded in the error handler with their severity, code and location,
+     * so error() and errorCode() don't depend on the threshold, but their message text and argument are left empty.
+     * The threshold is shared by all threads, set it before starting any.
+     * The default is Debug, so everything is printed.
+     */
+    static void setLogThreshold(Severity threshold);
+    static Severity logThreshold();
+    /**
+     * Disables (or enables) printing of all messages.
+     */
+    static void setOutputEnabled(bool);
+
+    /**
+     * Returns true if a message of severity @param s is printed.
+     */
+    static bool isLogged(Severity s)
+    {
+        return s_outputEnabled && s >= s_logThreshold;
+    }
+
+    /**
+     * Returns true if the text of a message of severity @param s is built.
+     *
+     * Unlike isLogged() this doesn't depend on the output, because the text of warnings and errors is also kept in the error handler.
+     */
+    static bool isFormatted(Severity s)
+    {
+        return s >= s_logThreshold;
+    }
+
     static bool errorOccured()
     {
         if (ErrorHandler::instance().error() >= Error) {
@@ -88,13 +161,35 @@ public:
     }
     
 private:
-    ErrorHandler():m_worstError(Debug) {};
+    ErrorHandler();
     ErrorHandler(const ErrorHandler &);
     ErrorHandler & operator= (const ErrorHandler &);
     
+    struct Record {
+        Record(): severity(Debug), code(Message), file(0), line(0) {};
+        Severity severity;
+        Code code;
+        QString argument;
+        const char *file;
+        int line;
+        QString location; //Only used if there is no file
+    };
+    static QString render(const Record &);
+    static QString location(const Record &);
+    void print(const Record &) const;
+    void record(const Record &);
+    
+    static Severity s_logThreshold;
+    static bool s_outputEnabled;
+
     Severity m_worstError;
-    QString m_worstErrorMessage;
-    QList <Err> m_errorQueue;
+    Record m_worstRecord;
+    Record m_records[Capacity];
+    int m_first;
+    int m_count;
+    int m_dropped;
+    mutable QList <Err> m_renderedErrors;
+    mutable bool m_rendered;
 };
 
 void logMessage(const QString &,const QString &, int, ErrorHandler::Severity s);
@@ -104,48 +199,82 @@ void logMessage(const QString &,const QString &, int, ErrorHandler::Severity s);
 #define ERROR(message) logMessage(message,__FILE__, __LINE__, ErrorHandler::Error);
 #define CRITICAL(message) logMessage(message,__FILE__, __LINE__, ErrorHandler::Critical);
 
+/**
+ * Records an error by code, i.e. ReportError(Warning, NoMailtoAddress, QString())
+ *
+ * The argument is not evaluated below the log threshold.
+ */
+#define ReportError(severity, code, argument) if (!Kolab::ErrorHandler::isFormatted(Kolab::ErrorHandler::severity)) Kolab::ErrorHandler::instance().addError(Kolab::ErrorHandler::severity, Kolab::ErrorHandler::code, QString(), __FILE__, __LINE__); else Kolab::ErrorHandler::instance().addError(Kolab::ErrorHandler::severity, Kolab::ErrorHandler::code, argument, __FILE__, __LINE__)
+
 
 /**
  * Drop in replacement for qWarning()
  * 
  * Note that this is not only for debug builds, its a fundamental part to detect errors.
  * 
+ * The message is only built if it is at or above the log threshold (see ErrorHandler::setLogThreshold),
+ * and all parts are appended to the same message, without copying the logger.
+ * The arguments of a message below the threshold are not evaluated, warnings and errors are then recorded without text.
+ * 
+ * Debug() messages can be removed at compile time by defining KOLAB_NO_DEBUG_LOGGING (cmake -DDEBUG_LOGGING=OFF).
+ * 
  * TODO: It should be possible to replace this with a kWarning/qWarning error handler
  */
 struct KolabLogger {
-    bool isLast;
-    QString m_message;
-    QString m_location;
     ErrorHandler::Severity m_severity;
-    KolabLogger(ErrorHandler::Severity s, int line, const QString &file): isLast(true), m_message(), m_location(file + "(" + QString::number(line)+")"), m_severity(s) {};
-    KolabLogger(ErrorHandler::Severity s, const QString &message, const QString &location): isLast(true), m_message(message), m_location(location), m_severity(s) {};
-    ~KolabLogger(){if (isLast) ErrorHandler::instance().addError(m_severity, m_message, m_location);}
-    QString maybeSpace() const { if (!m_message.isEmpty()) return " "; return ""; }
-    KolabLogger operator<<(const QString &message) {
-        isLast = false;
-        return KolabLogger(m_severity, m_message+maybeSpace()+message, m_location);
+    bool m_enabled;
+    int m_line;
+    const char *m_file;
+    QString m_message;
+    KolabLogger(ErrorHandler::Severity s, int line, const char *file): m_severity(s), m_enabled(s > ErrorHandler::Debug || ErrorHandler::isLogged(s)), m_line(line), m_file(file) {};
+    ~KolabLogger(){if (m_enabled) ErrorHandler::instance().addError(m_severity, ErrorHandler::Message, m_message, m_file, m_line);}
+    void maybeSpace() { if (!m_message.isEmpty()) m_message += QLatin1Char(' '); }
+    KolabLogger &operator<<(const QString &message) {
+        if (m_enabled) {
+            maybeSpace();
+            m_message += message;
+        }
+        return *this;
     }
-    KolabLogger operator<<(const QByteArray &message) {
-        isLast = false;
-        return KolabLogger(m_severity, m_message+maybeSpace()+message, m_location);
+    KolabLogger &operator<<(const QByteArray &message) {
+        if (m_enabled) {
+            maybeSpace();
+            m_message += QString::fromAscii(message.constData(), message.size());
+        }
+        return *this;
     }
-    KolabLogger operator<<(const int &n) {
-        isLast = false;
-        return KolabLogger(m_severity, m_message+maybeSpace()+QString::number(n), m_location);
+    KolabLogger &operator<<(int n) {
+        if (m_enabled) {
+            maybeSpace();
+            m_message += QString::number(n);
+        }
+        return *this;
     }
-    KolabLogger operator<<(const double &n) {
-        isLast = false;
-        return KolabLogger(m_severity, m_message+maybeSpace()+QString::number(n), m_location);
+    KolabLogger &operator<<(double n) {
+        if (m_enabled) {
+            maybeSpace();
+            m_message += QString::number(n);
+        }
+        return *this;
     }
-    inline KolabLogger operator<<(const char* t) {
-        isLast = false;
-        return KolabLogger(m_severity, m_message+maybeSpace()+QString::fromAscii(t), m_location);
+    KolabLogger &operator<<(const char* t) {
+        if (m_enabled) {
+            maybeSpace();
+            m_message += QString::fromAscii(t);
+        }
+        return *this;
     }
 };
-#define Debug() Kolab::KolabLogger(Kolab::ErrorHandler::Debug, __LINE__, __FILE__)
-#define Warning() Kolab::KolabLogger(Kolab::ErrorHandler::Warning, __LINE__, __FILE__)
-#define Error() Kolab::KolabLogger(Kolab::ErrorHandler::Error, __LINE__, __FILE__)
-#define Critical() Kolab::KolabLogger(Kolab::ErrorHandler::Critical, __LINE__, __FILE__)
+//The else branch makes Debug() << ... a single statement which is safe to use in an if without braces
+#ifdef KOLAB_NO_DEBUG_LOGGING
+#define Debug() if (true) {} else Kolab::KolabLogger(Kolab::ErrorHandler::Debug, __LINE__, __FILE__)
+#else
+#define Debug() if (!Kolab::ErrorHandler::isLogged(Kolab::ErrorHandler::Debug)) {} else Kolab::KolabLogger(Kolab::ErrorHandler::Debug, __LINE__, __FILE__)
+#endif
+#define KOLAB_LOGGER(severity) if (!Kolab::ErrorHandler::isFormatted(severity)) Kolab::ErrorHandler::instance().addError(severity, Kolab::ErrorHandler::Message, QString(), __FILE__, __LINE__); else Kolab::KolabLogger(severity, __LINE__, __FILE__)
+#define Warning() KOLAB_LOGGER(Kolab::ErrorHandler::Warning)
+#define Error() KOLAB_LOGGER(Kolab::ErrorHandler::Error)
+#define Critical() KOLAB_LOGGER(Kolab::ErrorHandler::Critical)
 
 }
 #endif // ERRORHANDLER_H
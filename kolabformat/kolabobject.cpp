@@ -30,12 +30,16 @@
 #include <kolabformatV2/distributionlist.h>
 #include <kolabformatV2/note.h>
 #include <mime/mimeutils.h>
+#include <mime/mimestreamwriter.h>
+#include <mime/mimescanner.h>
 #include <conversion/kcalconversion.h>
 #include <conversion/kabcconversion.h>
 #include <conversion/kolabconversion.h>
 #include <conversion/commonconversion.h>
 #include <akonadi/notes/noteutils.h>
+#include <kmime/kmime_util.h>
 #include <kolabformat.h>
+#include <QFile>
 
 
 namespace Kolab {
@@ -67,7 +71,8 @@ class KolabObjectReader::Private
 {
 public:
     Private()
-    :   mObjectType( InvalidObject ),
+    :   mMessage(new KMime::Message),
+        mObjectType( InvalidObject ),
         mVersion( KolabV3 ),
         mOverrideObjectType(InvalidObject),
         mDoOverrideVersion(false)
@@ -75,9 +80,16 @@ public:
         mAddressee = KABC::Addressee();
     }
 
-    ObjectType readKolabV2(const KMime::Message::Ptr &msg, Kolab::ObjectType objectType);
-    ObjectType readKolabV3(const KMime::Message::Ptr &msg, Kolab::ObjectType objectType);
-    
+    void reset();
+    template <typename Message, typename Parts>
+    ObjectType read(const Message &msg, const Parts &parts);
+    template <typename Message, typename Parts>
+    ObjectType readKolabV2(const Message &msg, const Parts &parts, Kolab::ObjectType objectType);
+    template <typename Message, typename Parts>
+    ObjectType readKolabV3(const Message &msg, const Parts &parts, Kolab::ObjectType objectType);
+
+    KMime::Message::Ptr mMessage;
+
     KCalCore::Incidence::Ptr mIncidence;
     KABC::Addressee mAddressee;
     KABC::ContactGroup mContactGroup;
@@ -120,115 +132,89 @@ void KolabObjectReader::setVersion(Version version)
     d->mDoOverrideVersion = true;
 }
 
-Kolab::ObjectType getObjectType(const QString &type)
+ObjectType peekObjectHeaders(const QByteArray &rawMessage, Version &version, QString &uid)
 {
-    if (type == eventKolabType()) {
-        return EventObject;
-    } else if (type == todoKolabType()) {
-        return TodoObject;
-    } else if (type == journalKolabType()) {
-        return JournalObject;
-    } else if (type == contactKolabType()) {
-        return ContactObject;
-    } else if (type == distlistKolabType() || type == distlistKolabTypeCompat()) {
-        return DistlistObject;
-    } else if (type == noteKolabType()) {
-        return NoteObject;
-    } else if (type == freebusyKolabType()) {
-        return FreebusyObject;
-    } else if (type.contains(dictKolabType())) { //Previous versions appended the language to the type
-        return DictionaryConfigurationObject;
+    QList<QByteArray> names;
+    names << X_KOLAB_TYPE_HEADER << X_KOLAB_MIME_VERSION_HEADER << X_KOLAB_MIME_VERSION_HEADER_COMPAT << "Subject";
+    const QList<QByteArray> values = Mime::peekHeaders(rawMessage, names);
+
+    if (values.at(1).isNull() && values.at(2).isNull()) {
+        version = KolabV2;
+    } else {
+        version = KolabV3;
     }
-    Warning() << "Unknown object type: " << type;
-    return Kolab::InvalidObject;
+    QByteArray usedCharset;
+    uid = KMime::decodeRFC2047String(values.at(3), usedCharset);
+    if (values.at(0).isNull()) {
+        ReportError(Warning, NoKolabTypeHeader, QString());
+        return InvalidObject;
+    }
+    return Mime::getObjectType(QString::fromLatin1(values.at(0)));
 }
 
-QByteArray getTypeString(Kolab::ObjectType type)
+void printMessageDebugInfo(const KMime::Message::Ptr &msg)
 {
-    switch (type) {
-        case EventObject:
-            return KOLAB_TYPE_EVENT;
-        case TodoObject:
-            return KOLAB_TYPE_TASK;
-        case JournalObject:
-            return KOLAB_TYPE_JOURNAL;
-        case FreebusyObject:
-            return KOLAB_TYPE_FREEBUSY;
-        case ContactObject:
-            return KOLAB_TYPE_CONTACT;
-        case DistlistObject:
-            return KOLAB_TYPE_DISTLIST;
-        case NoteObject:
-            return KOLAB_TYPE_NOTE;
-        case DictionaryConfigurationObject:
-            return KOLAB_TYPE_CONFIGURATION;
-        default:
-            Critical() << "unknown type "<< type;
-    }
-    return QByteArray();
+    //TODO replace by Debug stream for Mimemessage
+    Debug() << "MessageId: " << msg->messageID()->asUnicodeString();
+    Debug() << "Subject: " << msg->subject()->asUnicodeString();
+//     Debug() << msg->encodedContent();
 }
 
-QByteArray getMimeType(Kolab::ObjectType type)
+void printMessageDebugInfo(const Mime::Scanner &scanner)
 {
-    switch (type) {
-        case EventObject:
-        case TodoObject:
-        case JournalObject:
-        case FreebusyObject:
-            return MIME_TYPE_XCAL;
-        case ContactObject:
-        case DistlistObject:
-            return MIME_TYPE_XCARD;
-        case NoteObject:
-        case DictionaryConfigurationObject:
-            return MIME_TYPE_KOLAB;
-        default:
-            Critical() << "unknown type "<< type;
-    }
-    return QByteArray();
+    QByteArray usedCharset;
+    Debug() << "MessageId: " << scanner.header("Message-ID");
+    Debug() << "Subject: " << KMime::decodeRFC2047String(scanner.header("Subject"), usedCharset);
 }
 
-Kolab::ObjectType detectType(const KMime::Message::Ptr &msg)
+static KDateTime messageDate(const KMime::Message::Ptr &msg)
 {
-    Q_FOREACH(const QByteArray &type, Mime::getContentMimeTypeList(msg)) {
-        Kolab::ObjectType t = getObjectType(type); //works for v2 types
-        if (t != InvalidObject) {
-            return t;
-        }
-    }
-    return InvalidObject;
+    return msg->date()->dateTime();
 }
 
-void printMessageDebugInfo(const KMime::Message::Ptr &msg)
+static KDateTime messageDate(const Mime::Scanner &scanner)
 {
-    //TODO replace by Debug stream for Mimemessage
-    Debug() << "MessageId: " << msg->messageID()->asUnicodeString();
-    Debug() << "Subject: " << msg->subject()->asUnicodeString();
-//     Debug() << msg->encodedContent();
+    KMime::Headers::Date date;
+    date.from7BitString(scanner.header("Date"));
+    return date.dateTime();
 }
 
-ObjectType KolabObjectReader::Private::readKolabV2(const KMime::Message::Ptr &msg, Kolab::ObjectType objectType)
+void KolabObjectReader::Private::reset()
+{
+    mObjectType = InvalidObject;
+    mVersion = KolabV3;
+    mIncidence.clear();
+    mAddressee = KABC::Addressee();
+    mContactGroup = KABC::ContactGroup();
+    mNote.reset();
+    mDictionary.clear();
+    mDictionaryLanguage.clear();
+    mFreebusy = Kolab::Freebusy();
+}
+
+template <typename Message, typename Parts>
+ObjectType KolabObjectReader::Private::readKolabV2(const Message &msg, const Parts &parts, Kolab::ObjectType objectType)
 {
     if (objectType == DictionaryConfigurationObject) {
-        KMime::Content *xmlContent = Mime::findContentByType( msg, "application/xml" );
-        if ( !xmlContent ) {
+        const typename Parts::Part *xmlPart = parts.findByType( "application/xml" );
+        if ( !xmlPart ) {
             Critical() << "no application/xml part found";
             printMessageDebugInfo(msg);
             return InvalidObject;
         }
-        const QByteArray &xmlData = xmlContent->decodedContent();
+        const QByteArray &xmlData = parts.decodedContent(*xmlPart);
         mDictionary = readLegacyDictionaryConfiguration(xmlData, mDictionaryLanguage);
         ErrorHandler::handleLibkolabxmlErrors();
         mObjectType = objectType;
         return mObjectType;
     }
-    KMime::Content *xmlContent = Mime::findContentByType( msg, getTypeString(objectType)  );
-    if ( !xmlContent ) {
-        Critical() << "no part with type" << getTypeString(objectType) << " found";
+    const typename Parts::Part *xmlPart = parts.findByType( Mime::getTypeString(objectType) );
+    if ( !xmlPart ) {
+        Critical() << "no part with type" << Mime::getTypeString(objectType) << " found";
         printMessageDebugInfo(msg);
         return InvalidObject;
     }
-    const QByteArray &xmlData = xmlContent->decodedContent();
+    const QByteArray &xmlData = parts.decodedContent(*xmlPart);
     Q_ASSERT(!xmlData.isEmpty());
     QStringList attachments;
 
@@ -243,22 +229,22 @@ ObjectType KolabObjectReader::Private::readKolabV2(const KMime::Message::Ptr &ms
             mIncidence = fromXML<KCalCore::Journal::Ptr, KolabV2::Journal>(xmlData, attachments);
             break;
         case ContactObject:
-            mAddressee = addresseeFromKolab(xmlData, msg);
+            mAddressee = addresseeFromKolab(xmlData, parts);
             break;
         case DistlistObject:
             mContactGroup = contactGroupFromKolab(xmlData);
             break;
         case NoteObject:
-            mNote = noteFromKolab(xmlData, msg->date()->dateTime());
+            mNote = noteFromKolab(xmlData, messageDate(msg));
             break;
         default:
-            CRITICAL("no kolab object found ");
+            ReportError(Critical, NoKolabObject, QString());
             break;
     }
     if (!mIncidence.isNull()) {
 //             kDebug() << "v2 attachments " << attachments.size() << d->mIncidence->attachments().size();
         mIncidence->clearAttachments();
-        Mime::getAttachments(mIncidence, attachments, msg);
+        Mime::getAttachments(mIncidence, attachments, parts);
         if (mIncidence->attachments().size() != attachments.size()) {
             Error() << "Could not extract all attachments. " << mIncidence->attachments().size() << " out of " << attachments.size();
         }
@@ -270,47 +256,50 @@ ObjectType KolabObjectReader::Private::readKolabV2(const KMime::Message::Ptr &ms
     return objectType;
 }
 
-ObjectType KolabObjectReader::Private::readKolabV3(const KMime::Message::Ptr &msg, Kolab::ObjectType objectType)
+template <typename Message, typename Parts>
+ObjectType KolabObjectReader::Private::readKolabV3(const Message &msg, const Parts &parts, Kolab::ObjectType objectType)
 {
-    KMime::Content *xmlContent = Mime::findContentByType( msg, getMimeType(objectType) );
-    if ( !xmlContent ) {
-        Critical() << "no " << getMimeType(objectType) << " part found";
+    const typename Parts::Part *xmlPart = parts.findByType( Mime::getMimeType(objectType) );
+    if ( !xmlPart ) {
+        Critical() << "no " << Mime::getMimeType(objectType) << " part found";
         printMessageDebugInfo(msg);
         return InvalidObject;
     }
+    std::string xml;
+    parts.decode(*xmlPart, xml);
     switch (objectType) {
         case EventObject: {
-            const Kolab::Event & event = Kolab::readEvent(std::string(xmlContent->decodedContent().data(), xmlContent->decodedContent().size()), false);
+            const Kolab::Event & event = Kolab::readEvent(xml, false);
             mIncidence = Kolab::Conversion::toKCalCore(event);
         }
             break;
         case TodoObject: {
-            const Kolab::Todo & event = Kolab::readTodo(std::string(xmlContent->decodedContent().data(), xmlContent->decodedContent().size()), false);
+            const Kolab::Todo & event = Kolab::readTodo(xml, false);
             mIncidence = Kolab::Conversion::toKCalCore(event);
         }
             break;
         case JournalObject: {
-            const Kolab::Journal & event = Kolab::readJournal(std::string(xmlContent->decodedContent().data(), xmlContent->decodedContent().size()), false);
+            const Kolab::Journal & event = Kolab::readJournal(xml, false);
             mIncidence = Kolab::Conversion::toKCalCore(event);
         }
             break;
         case ContactObject: {
-            const Kolab::Contact &contact = Kolab::readContact(std::string(xmlContent->decodedContent().data(), xmlContent->decodedContent().size()), false);
+            const Kolab::Contact &contact = Kolab::readContact(xml, false);
             mAddressee = Kolab::Conversion::toKABC(contact); //TODO extract attachments
         }
             break;
         case DistlistObject: {
-            const Kolab::DistList &distlist = Kolab::readDistlist(std::string(xmlContent->decodedContent().data(), xmlContent->decodedContent().size()), false);
+            const Kolab::DistList &distlist = Kolab::readDistlist(xml, false);
             mContactGroup = Kolab::Conversion::toKABC(distlist);
         }
             break;
         case NoteObject: {
-            const Kolab::Note &note = Kolab::readNote(std::string(xmlContent->decodedContent().data(), xmlContent->decodedContent().size()), false);
+            const Kolab::Note &note = Kolab::readNote(xml, false);
             mNote = Kolab::Conversion::toNote(note);
         }
             break;
         case DictionaryConfigurationObject: {
-            const Kolab::Configuration &configuration = Kolab::readConfiguration(std::string(xmlContent->decodedContent().data(), xmlContent->decodedContent().size()), false);
+            const Kolab::Configuration &configuration = Kolab::readConfiguration(xml, false);
             const Kolab::Dictionary &dictionary = configuration.dictionary();
             mDictionary.clear();
             foreach (const std::string &entry, dictionary.entries()) {
@@ -320,7 +309,7 @@ ObjectType KolabObjectReader::Private::readKolabV3(const KMime::Message::Ptr &ms
         }
             break;
         case FreebusyObject: {
-            const Kolab::Freebusy &fb = Kolab::readFreebusy(std::string(xmlContent->decodedContent().data(), xmlContent->decodedContent().size()), false);
+            const Kolab::Freebusy &fb = Kolab::readFreebusy(xml, false);
             mFreebusy = fb;
         }
             break;
@@ -332,7 +321,7 @@ ObjectType KolabObjectReader::Private::readKolabV3(const KMime::Message::Ptr &ms
 
     if (!mIncidence.isNull()) {
 //             kDebug() << "getting attachments";
-        Mime::getAttachmentsById(mIncidence, msg);
+        Mime::getAttachmentsById(mIncidence, parts);
     }
     if (ErrorHandler::errorOccured()) {
         printMessageDebugInfo(msg);
@@ -342,26 +331,17 @@ ObjectType KolabObjectReader::Private::readKolabV3(const KMime::Message::Ptr &ms
     return objectType;
 }
 
-ObjectType KolabObjectReader::parseMimeMessage(const KMime::Message::Ptr &msg)
+/**
+ * Reads the object from the parts of @param msg, which is either a KMime::Message::Ptr with its Mime::PartIndex or a Mime::Scanner.
+ */
+template <typename Message, typename Parts>
+ObjectType KolabObjectReader::Private::read(const Message &msg, const Parts &parts)
 {
-    ErrorHandler::clearErrors();
-    d->mObjectType = InvalidObject;
-    if (msg->contents().isEmpty()) {
-        Critical() << "message has no contents (we likely failed to parse it correctly)";
-        printMessageDebugInfo(msg);
-        return InvalidObject;
-    }
     Kolab::ObjectType objectType = InvalidObject;
-    if (d->mOverrideObjectType == InvalidObject) {
-        if (KMime::Headers::Base *xKolabHeader = msg->getHeaderByType(X_KOLAB_TYPE_HEADER)) {
-            objectType = getObjectType(xKolabHeader->asUnicodeString().trimmed());
-        } else {
-            Warning() << "could not find the X-Kolab-Type Header, trying autodetection" ;
-            //This works only for v2 messages atm.
-            objectType = detectType(msg);
-        }
+    if (mOverrideObjectType == InvalidObject) {
+        objectType = Mime::getObjectType(msg);
     } else {
-        objectType = d->mOverrideObjectType;
+        objectType = mOverrideObjectType;
     }
     if (objectType == InvalidObject) {
         Critical() << "unable to detect object type";
@@ -369,32 +349,50 @@ ObjectType KolabObjectReader::parseMimeMessage(const KMime::Message::Ptr &msg)
         return InvalidObject;
     }
 
-    if (!d->mDoOverrideVersion) {
-        KMime::Headers::Base *xKolabVersion = msg->getHeaderByType(X_KOLAB_MIME_VERSION_HEADER);
-        if (!xKolabVersion) {
-            //For backwards compatibility to development versions, can be removed in future versions
-            xKolabVersion = msg->getHeaderByType(X_KOLAB_MIME_VERSION_HEADER_COMPAT);
-        }
-        if (!xKolabVersion) {
-            d->mVersion = KolabV2;
-        } else {
-            if (xKolabVersion->asUnicodeString() != KOLAB_VERSION_V3) { //TODO version compatibility check?
-                Warning() << "Kolab Version Header available but not on the same version as the implementation: " << xKolabVersion->asUnicodeString();
-            }
-            d->mVersion = KolabV3;
-        }
+    if (!mDoOverrideVersion) {
+        mVersion = Mime::getVersion(msg);
     } else {
-        d->mVersion = d->mOverrideVersion;
+        mVersion = mOverrideVersion;
     }
 
-    if (d->mVersion == KolabV2) {
-        return d->readKolabV2(msg, objectType);
+    if (mVersion == KolabV2) {
+        return readKolabV2(msg, parts, objectType);
     } else {
-        return d->readKolabV3(msg, objectType);
+        return readKolabV3(msg, parts, objectType);
     }
     return InvalidObject;
 }
 
+ObjectType KolabObjectReader::parseMimeMessage(const KMime::Message::Ptr &msg)
+{
+    ErrorHandler::clearErrors();
+    d->reset();
+    if (!msg || msg->contents().isEmpty()) {
+        Critical() << "message has no contents (we likely failed to parse it correctly)";
+        if (msg) {
+            printMessageDebugInfo(msg);
+        }
+        return InvalidObject;
+    }
+    //All parts are looked up in the same index
+    return d->read(msg, Mime::PartIndex(msg));
+}
+
+ObjectType KolabObjectReader::parseMessage(const QByteArray &rawMessage)
+{
+    const Mime::Scanner scanner(rawMessage);
+    if (!scanner.isValid()) {
+        //None of the read objects keeps a reference to the message, so we can reuse it for the next message
+        d->mMessage->clear();
+        d->mMessage->setContent(KMime::CRLFtoLF(rawMessage));
+        d->mMessage->parse();
+        return parseMimeMessage(d->mMessage);
+    }
+    ErrorHandler::clearErrors();
+    d->reset();
+    return d->read(scanner, scanner);
+}
+
 Version KolabObjectReader::getVersion() const
 {
     return d->mVersion;
@@ -452,15 +450,104 @@ Freebusy KolabObjectReader::getFreebusy() const
 }
 
 
-//Normalize incidences before serializing them
-KCalCore::Incidence::Ptr normalizeIncidence(KCalCore::Incidence::Ptr original)
+//@cond PRIVATE
+class KolabObjectBatchReader::Private
 {
-    KCalCore::Incidence::Ptr i = KCalCore::Incidence::Ptr(original->clone()); //We copy to avoid destructive writing
-    Q_FOREACH (KCalCore::Attachment::Ptr attachment, i->attachments()) {
-        attachment->setUri(QString::fromLatin1("cid:")+QString::fromLatin1(KMime::uniqueString() + '@' + "kolab.resource.akonadi")); //Serialize the attachment as attachment with uri, referencing the created mime-part
+public:
+    KolabObjectBatchReader::Result result(ObjectType type);
+
+    KolabObjectReader mReader;
+    Conversion::PictureCacheBatch mPictureCache;
+};
+//@endcond
+
+KolabObjectBatchReader::KolabObjectBatchReader()
+: d( new KolabObjectBatchReader::Private )
+{
+}
+
+KolabObjectBatchReader::~KolabObjectBatchReader()
+{
+    delete d;
+}
+
+void KolabObjectBatchReader::setObjectType(ObjectType type)
+{
+    d->mReader.setObjectType(type);
+}
+
+void KolabObjectBatchReader::setVersion(Version version)
+{
+    d->mReader.setVersion(version);
+}
+
+KolabObjectBatchReader::Result KolabObjectBatchReader::Private::result(ObjectType type)
+{
+    Result result;
+    result.type = type;
+    result.version = mReader.getVersion();
+    result.errorSeverity = ErrorHandler::instance().error();
+    if (result.errorSeverity > ErrorHandler::Debug) {
+        result.errorMessage = ErrorHandler::instance().errorMessage();
     }
-    return i;
+    switch (result.type) {
+        case EventObject:
+        case TodoObject:
+        case JournalObject:
+            result.incidence = mReader.getIncidence();
+            break;
+        case ContactObject:
+            result.contact = mReader.getContact();
+            break;
+        case DistlistObject:
+            result.distlist = mReader.getDistlist();
+            break;
+        case NoteObject:
+            result.note = mReader.getNote();
+            break;
+        case DictionaryConfigurationObject:
+            result.dictionary = mReader.getDictionary(result.dictionaryLanguage);
+            break;
+        case FreebusyObject:
+            result.freebusy = mReader.getFreebusy();
+            break;
+        default:
+            break;
+    }
+    return result;
 }
+
+KolabObjectBatchReader::Result KolabObjectBatchReader::read(const KMime::Message::Ptr &msg)
+{
+    return d->result(d->mReader.parseMimeMessage(msg));
+}
+
+KolabObjectBatchReader::Result KolabObjectBatchReader::read(const QByteArray &rawMessage)
+{
+    return d->result(d->mReader.parseMessage(rawMessage));
+}
+
+QList<KolabObjectBatchReader::Result> KolabObjectBatchReader::read(const QList<KMime::Message::Ptr> &messages)
+{
+    QList<Result> results;
+    results.reserve(messages.size());
+    foreach (const KMime::Message::Ptr &msg, messages) {
+        results.append(read(msg));
+    }
+    return results;
+}
+
+QList<KolabObjectBatchReader::Result> KolabObjectBatchReader::read(const QList<QByteArray> &rawMessages)
+{
+    QList<Result> results;
+    results.reserve(rawMessages.size());
+    foreach (const QByteArray &rawMessage, rawMessages) {
+        results.append(read(rawMessage));
+    }
+    return results;
+}
+
+
 /*
 KABC::Addressee normalizeContact(const KABC::Addressee &a)
 {
@@ -471,6 +558,50 @@ KABC::Addressee normalizeContact(const KABC::Addressee &a)
     return i;
 }*/
 
+static bool hasInlineAttachments(const std::vector<Kolab::Attachment> &attachments)
+{
+    for (std::vector<Kolab::Attachment>::const_iterator it = attachments.begin(); it != attachments.end(); ++it) {
+        if (Mime::isEmbeddedAttachment(*it)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Serializes a libkolabxml incidence.
+ *
+ * The inline attachments of @param incidence are replaced in place by cid: references to the returned attachment parts,
+ * which are encoded straight from the original attachments. The payloads are released with the replaced attachments.
+ * Returns false if the attachment parts could not be created.
+ */
+template <typename T>
+static bool writeIncidenceV3(T &incidence, std::string (*writeFunction)(const T &, const std::string &), const QString &productId, QByteArray &xml, QList<KMime::Content*> &attachmentParts)
+{
+    const std::vector<Kolab::Attachment> &attachments = incidence.attachments();
+    if (hasInlineAttachments(attachments)) {
+        std::vector<Kolab::Attachment> references;
+        if (!Mime::createAttachmentParts(attachments, references, attachmentParts)) {
+            return false;
+        }
+        incidence.setAttachments(references);
+    }
+    const std::string &v3String = writeFunction(incidence, Conversion::toStdString(productId));
+    ErrorHandler::handleLibkolabxmlErrors();
+    xml = QByteArray(v3String.data(), v3String.size());
+    return true;
+}
+
+static KMime::Message::Ptr createIncidenceMessage(const KCalCore::Incidence::Ptr &i, const QString &xKolabType, const QByteArray &xml, const QList<KMime::Content*> &attachmentParts, const QString &productId)
+{
+    QString email, name;
+    if (i->organizer()) {
+        email = i->organizer()->email();
+        name = i->organizer()->name();
+    }
+    return Mime::createMessage(i->uid(), email, name, xCalMimeType(), xKolabType, xml, attachmentParts, productId);
+}
+
 QString getProductId(const QString &pId)
 {
     if (pId.isEmpty()) {
@@ -488,14 +619,16 @@ KMime::Message::Ptr KolabObjectWriter::writeEvent(const KCalCore::Event::Ptr &i,
     }
     Q_ASSERT(!i.isNull());
     if (v == KolabV3) {
-        KCalCore::Event::Ptr ic = normalizeIncidence(i).dynamicCast<KCalCore::Event>();
-        const Kolab::Event &incidence = Kolab::Conversion::fromKCalCore(*ic);
-        const std::string &v3String = Kolab::writeEvent(incidence, std::string(getProductId(productId).toUtf8().constData()));
-        ErrorHandler::handleLibkolabxmlErrors();
-        return Mime::createMessage(ic, xCalMimeType(), eventKolabType(), QString::fromUtf8(v3String.c_str()).toUtf8(), true, getProductId(productId));
+        Kolab::Event incidence = Kolab::Conversion::fromKCalCore(*i);
+        QList<KMime::Content*> attachmentParts;
+        QByteArray xml;
+        if (!writeIncidenceV3(incidence, &Kolab::writeEvent, getProductId(productId), xml, attachmentParts)) {
+            return KMime::Message::Ptr();
+        }
+        return createIncidenceMessage(i, eventKolabType(), xml, attachmentParts, getProductId(productId));
     }
-    const QString &xml = KolabV2::Event::eventToXML(i, tz);
-    return Mime::createMessage(i, eventKolabType(), eventKolabType(), xml.toUtf8(), false, getProductId(productId));
+    const QByteArray &xml = KolabV2::Event::eventToXML(i, tz);
+    return Mime::createMessage(i, eventKolabType(), eventKolabType(), xml, false, getProductId(productId));
 }
 
 KMime::Message::Ptr KolabObjectWriter::writeTodo(const KCalCore::Todo::Ptr &i, Version v, const QString &productId, const QString &tz)
@@ -507,14 +640,16 @@ KMime::Message::Ptr KolabObjectWriter::writeTodo(const KCalCore::Todo::Ptr &i, V
     }
     Q_ASSERT(!i.isNull());
     if (v == KolabV3) {
-        KCalCore::Todo::Ptr ic = normalizeIncidence(i).dynamicCast<KCalCore::Todo>();
-        const Kolab::Todo &incidence = Kolab::Conversion::fromKCalCore(*ic);
-        const std::string &v3String = Kolab::writeTodo(incidence, Conversion::toStdString(getProductId(productId)));
-        ErrorHandler::handleLibkolabxmlErrors();
-        return Mime::createMessage(ic, xCalMimeType(), todoKolabType(), Conversion::fromStdString(v3String).toUtf8(), true, getProductId(productId));
+        Kolab::Todo incidence = Kolab::Conversion::fromKCalCore(*i);
+        QList<KMime::Content*> attachmentParts;
+        QByteArray xml;
+        if (!writeIncidenceV3(incidence, &Kolab::writeTodo, getProductId(productId), xml, attachmentParts)) {
+            return KMime::Message::Ptr();
+        }
+        return createIncidenceMessage(i, todoKolabType(), xml, attachmentParts, getProductId(productId));
     }
-    const QString &xml = KolabV2::Task::taskToXML(i, tz);
-    return Mime::createMessage(i, todoKolabType(), todoKolabType(), xml.toUtf8(), false, getProductId(productId));
+    const QByteArray &xml = KolabV2::Task::taskToXML(i, tz);
+    return Mime::createMessage(i, todoKolabType(), todoKolabType(), xml, false, getProductId(productId));
 }
 
 KMime::Message::Ptr KolabObjectWriter::writeJournal(const KCalCore::Journal::Ptr &i, Version v, const QString &productId, const QString &tz)
@@ -526,14 +661,16 @@ KMime::Message::Ptr KolabObjectWriter::writeJournal(const KCalCore::Journal::Ptr
     }
     Q_ASSERT(!i.isNull());
     if (v == KolabV3) {
-        KCalCore::Journal::Ptr ic = normalizeIncidence(i).dynamicCast<KCalCore::Journal>();
-        const Kolab::Journal &incidence = Kolab::Conversion::fromKCalCore(*ic);
-        const std::string &v3String = Kolab::writeJournal(incidence, Conversion::toStdString(getProductId(productId)));
-        ErrorHandler::handleLibkolabxmlErrors();
-        return  Mime::createMessage(ic, xCalMimeType(), journalKolabType(), Conversion::fromStdString(v3String).toUtf8(), true, getProductId(productId));
+        Kolab::Journal incidence = Kolab::Conversion::fromKCalCore(*i);
+        QList<KMime::Content*> attachmentParts;
+        QByteArray xml;
+        if (!writeIncidenceV3(incidence, &Kolab::writeJournal, getProductId(productId), xml, attachmentParts)) {
+            return KMime::Message::Ptr();
+        }
+        return createIncidenceMessage(i, journalKolabType(), xml, attachmentParts, getProductId(productId));
     }
-    const QString &xml = KolabV2::Journal::journalToXML(i, tz);
-    return Mime::createMessage(i, journalKolabType(), journalKolabType(), xml.toUtf8(), false, getProductId(productId));
+    const QByteArray &xml = KolabV2::Journal::journalToXML(i, tz);
+    return Mime::createMessage(i, journalKolabType(), journalKolabType(), xml, false, getProductId(productId));
 }
 
 KMime::Message::Ptr KolabObjectWriter::writeIncidence(const KCalCore::Incidence::Ptr &i, Version v, const QString& productId, const QString& tz)
@@ -618,6 +755,227 @@ KMime::Message::Ptr KolabObjectWriter::writeDictionary(const QStringList &entrie
     return  Mime::createMessage(Conversion::fromStdString(configuration.uid()), kolabMimeType(), dictKolabType(), Conversion::fromStdString(v3String).toUtf8(), true, getProductId(productId));
 }
 
+KMime::Message::Ptr KolabObjectWriter::writeEvent(const Kolab::Event &event, Version v, const QString &productId)
+{
+    ErrorHandler::clearErrors();
+    if (v != KolabV3) {
+        return writeEvent(Conversion::toKCalCore(event), v, productId);
+    }
+    QList<KMime::Content*> attachmentParts;
+    QByteArray xml;
+    if (hasInlineAttachments(event.attachments())) {
+        //libkolabxml only serializes the attachments of the container itself, so the references go into a copy
+        Kolab::Event copy(event);
+        if (!writeIncidenceV3(copy, &Kolab::writeEvent, getProductId(productId), xml, attachmentParts)) {
+            return KMime::Message::Ptr();
+        }
+    } else {
+        const std::string &v3String = Kolab::writeEvent(event, Conversion::toStdString(getProductId(productId)));
+        ErrorHandler::handleLibkolabxmlErrors();
+        xml = QByteArray(v3String.data(), v3String.size());
+    }
+    return Mime::createMessage(Conversion::fromStdString(Kolab::getSerializedUID()), Conversion::fromStdString(event.organizer().email()), Conversion::fromStdString(event.organizer().name()), xCalMimeType(), eventKolabType(), xml, attachmentParts, getProductId(productId));
+}
+
+KMime::Message::Ptr KolabObjectWriter::writeTodo(const Kolab::Todo &todo, Version v, const QString &productId)
+{
+    ErrorHandler::clearErrors();
+    if (v != KolabV3) {
+        return writeTodo(Conversion::toKCalCore(todo), v, productId);
+    }
+    QList<KMime::Content*> attachmentParts;
+    QByteArray xml;
+    if (hasInlineAttachments(todo.attachments())) {
+        //libkolabxml only serializes the attachments of the container itself, so the references go into a copy
+        Kolab::Todo copy(todo);
+        if (!writeIncidenceV3(copy, &Kolab::writeTodo, getProductId(productId), xml, attachmentParts)) {
+            return KMime::Message::Ptr();
+        }
+    } else {
+        const std::string &v3String = Kolab::writeTodo(todo, Conversion::toStdString(getProductId(productId)));
+        ErrorHandler::handleLibkolabxmlErrors();
+        xml = QByteArray(v3String.data(), v3String.size());
+    }
+    return Mime::createMessage(Conversion::fromStdString(Kolab::getSerializedUID()), Conversion::fromStdString(todo.organizer().email()), Conversion::fromStdString(todo.organizer().name()), xCalMimeType(), todoKolabType(), xml, attachmentParts, getProductId(productId));
+}
+
+KMime::Message::Ptr KolabObjectWriter::writeJournal(const Kolab::Journal &journal, Version v, const QString &productId)
+{
+    ErrorHandler::clearErrors();
+    if (v != KolabV3) {
+        return writeJournal(Conversion::toKCalCore(journal), v, productId);
+    }
+    QList<KMime::Content*> attachmentParts;
+    QByteArray xml;
+    if (hasInlineAttachments(journal.attachments())) {
+        //libkolabxml only serializes the attachments of the container itself, so the references go into a copy
+        Kolab::Journal copy(journal);
+        if (!writeIncidenceV3(copy, &Kolab::writeJournal, getProductId(productId), xml, attachmentParts)) {
+            return KMime::Message::Ptr();
+        }
+    } else {
+        const std::string &v3String = Kolab::writeJournal(journal, Conversion::toStdString(getProductId(productId)));
+        ErrorHandler::handleLibkolabxmlErrors();
+        xml = QByteArray(v3String.data(), v3String.size());
+    }
+    return Mime::createMessage(Conversion::fromStdString(Kolab::getSerializedUID()), QString(), QString(), xCalMimeType(), journalKolabType(), xml, attachmentParts, getProductId(productId));
+}
+
+static QString preferredEmail(const Kolab::Contact &contact)
+{
+    const std::vector<std::string> &emails = contact.emailAddresses();
+    if (emails.empty()) {
+        return QString();
+    }
+    const int preferred = contact.emailAddressPreferredIndex();
+    return Conversion::fromStdString((preferred >= 0 && preferred < static_cast<int>(emails.size())) ? emails.at(preferred) : emails.front());
+}
+
+KMime::Message::Ptr KolabObjectWriter::writeContact(const Kolab::Contact &contact, Version v, const QString &productId)
+{
+    ErrorHandler::clearErrors();
+    if (v != KolabV3) {
+        return writeContact(Conversion::toKABC(contact), v, productId);
+    }
+    const std::string &v3String = Kolab::writeContact(contact, Conversion::toStdString(getProductId(productId)));
+    ErrorHandler::handleLibkolabxmlErrors();
+    return Mime::createMessage(Conversion::fromStdString(Kolab::getSerializedUID()), preferredEmail(contact), Conversion::fromStdString(contact.name()), xCardMimeType(), contactKolabType(), QByteArray(v3String.data(), v3String.size()), QList<KMime::Content*>(), getProductId(productId));
+}
+
+KMime::Message::Ptr KolabObjectWriter::writeDistlist(const Kolab::DistList &distlist, Version v, const QString &productId)
+{
+    ErrorHandler::clearErrors();
+    if (v != KolabV3) {
+        return writeDistlist(Conversion::toKABC(distlist), v, productId);
+    }
+    const std::string &v3String = Kolab::writeDistlist(distlist, Conversion::toStdString(getProductId(productId)));
+    ErrorHandler::handleLibkolabxmlErrors();
+    return Mime::createMessage(Conversion::fromStdString(Kolab::getSerializedUID()), QString(), QString(), xCardMimeType(), distlistKolabType(), QByteArray(v3String.data(), v3String.size()), QList<KMime::Content*>(), getProductId(productId));
+}
+
+/**
+ * Streams a libkolabxml incidence, the inline attachments are written from the container without copying them into mime parts.
+ */
+template <typename T>
+static bool streamIncidenceV3(const T &incidence, std::string (*writeFunction)(const T &, const std::string &), const QString &fromEmail, const QString &fromName, const QString &xKolabType, QIODevice *device, const QString &productId, bool crlf)
+{
+    ErrorHandler::clearErrors();
+    std::string xml;
+    QList<QByteArray> cids;
+    //Opened before anything is written, so a spilled file that has been removed fails the write up front
+    QList<QFile*> spilledFiles;
+    const std::vector<Kolab::Attachment> &attachments = incidence.attachments();
+    if (hasInlineAttachments(attachments)) {
+        std::vector<Kolab::Attachment> references;
+        for (std::vector<Kolab::Attachment>::const_iterator it = attachments.begin(); it != attachments.end(); ++it) {
+            const Kolab::Attachment &attachment = *it;
+            if (!Mime::isEmbeddedAttachment(attachment)) {
+                references.push_back(attachment);
+                cids.append(QByteArray());
+                spilledFiles.append(0);
+                continue;
+            }
+            QFile *file = 0;
+            if (!attachment.uri().empty()) {
+                file = new QFile;
+                if (!Mime::AttachmentSpill::openSpilledFile(attachment.uri(), *file)) {
+                    Critical() << "the spilled attachment " << Conversion::fromStdString(attachment.uri()) << " has been removed already";
+                    delete file;
+                    qDeleteAll(spilledFiles);
+                    return false;
+                }
+            }
+            spilledFiles.append(file);
+            const QByteArray cid = KMime::uniqueString() + '@' + "kolab.resource.akonadi";
+            Kolab::Attachment reference;
+            reference.setUri(std::string("cid:") + cid.constData(), attachment.mimetype());
+            reference.setLabel(attachment.label());
+            references.push_back(reference);
+            cids.append(cid);
+        }
+        T i(incidence);
+        i.setAttachments(references);
+        xml = writeFunction(i, Conversion::toStdString(productId));
+    } else {
+        xml = writeFunction(incidence, Conversion::toStdString(productId));
+    }
+    const QString &uid = Conversion::fromStdString(Kolab::getSerializedUID());
+    ErrorHandler::handleLibkolabxmlErrors();
+    if (ErrorHandler::errorOccured()) {
+        Error() << "failed to serialize the object, nothing written";
+        qDeleteAll(spilledFiles);
+        return false;
+    }
+
+    Mime::StreamWriter writer(device, crlf);
+    writer.writeHeader(uid, fromEmail, fromName, xKolabType, productId);
+    writer.writeMainPart(xCalMimeType(), xml);
+    int index = 0;
+    for (std::vector<Kolab::Attachment>::const_iterator it = attachments.begin(); it != attachments.end(); ++it) {
+        const Kolab::Attachment &attachment = *it;
+        const QByteArray &cid = cids.value(index);
+        QFile *file = spilledFiles.value(index++);
+        if (cid.isEmpty()) {
+            continue;
+        }
+        if (file) {
+            //Spilled attachments are streamed from their file
+            writer.writeAttachmentPart(cid, Conversion::fromStdString(attachment.mimetype()), Conversion::fromStdString(attachment.label()), file);
+        } else {
+            writer.writeAttachmentPart(cid, Conversion::fromStdString(attachment.mimetype()), Conversion::fromStdString(attachment.label()), attachment.data());
+        }
+    }
+    qDeleteAll(spilledFiles);
+    return writer.finish();
+}
+
+bool KolabObjectWriter::writeEvent(const Kolab::Event &event, QIODevice *device, const QString &productId, bool crlf)
+{
+    return streamIncidenceV3(event, &Kolab::writeEvent, Conversion::fromStdString(event.organizer().email()), Conversion::fromStdString(event.organizer().name()), eventKolabType(), device, getProductId(productId), crlf);
+}
+
+bool KolabObjectWriter::writeTodo(const Kolab::Todo &todo, QIODevice *device, const QString &productId, bool crlf)
+{
+    return streamIncidenceV3(todo, &Kolab::writeTodo, Conversion::fromStdString(todo.organizer().email()), Conversion::fromStdString(todo.organizer().name()), todoKolabType(), device, getProductId(productId), crlf);
+}
+
+bool KolabObjectWriter::writeJournal(const Kolab::Journal &journal, QIODevice *device, const QString &productId, bool crlf)
+{
+    return streamIncidenceV3(journal, &Kolab::writeJournal, QString(), QString(), journalKolabType(), device, getProductId(productId), crlf);
+}
+
+bool KolabObjectWriter::writeContact(const Kolab::Contact &contact, QIODevice *device, const QString &productId, bool crlf)
+{
+    ErrorHandler::clearErrors();
+    const std::string &v3String = Kolab::writeContact(contact, Conversion::toStdString(getProductId(productId)));
+    const QString &uid = Conversion::fromStdString(Kolab::getSerializedUID());
+    ErrorHandler::handleLibkolabxmlErrors();
+    if (ErrorHandler::errorOccured()) {
+        Error() << "failed to serialize the object, nothing written";
+        return false;
+    }
+    Mime::StreamWriter writer(device, crlf);
+    writer.writeHeader(uid, preferredEmail(contact), Conversion::fromStdString(contact.name()), contactKolabType(), getProductId(productId));
+    writer.writeMainPart(xCardMimeType(), v3String);
+    return writer.finish();
+}
+
+bool KolabObjectWriter::writeDistlist(const Kolab::DistList &distlist, QIODevice *device, const QString &productId, bool crlf)
+{
+    ErrorHandler::clearErrors();
+    const std::string &v3String = Kolab::writeDistlist(distlist, Conversion::toStdString(getProductId(productId)));
+    const QString &uid = Conversion::fromStdString(Kolab::getSerializedUID());
+    ErrorHandler::handleLibkolabxmlErrors();
+    if (ErrorHandler::errorOccured()) {
+        Error() << "failed to serialize the object, nothing written";
+        return false;
+    }
+    Mime::StreamWriter writer(device, crlf);
+    writer.writeHeader(uid, QString(), QString(), distlistKolabType(), getProductId(productId));
+    writer.writeMainPart(xCardMimeType(), v3String);
+    return writer.finish();
+}
+
 KMime::Message::Ptr KolabObjectWriter::writeFreebusy(const Freebusy &freebusy, Version v, const QString& productId)
 {
     ErrorHandler::clearErrors();
@@ -27,22 +27,32 @@
 #include <kcalcore/journal.h>
 #include <kcalcore/todo.h>
 #include <kmime/kmime_message.h>
+#include <kolabformat.h>
 
 #include "kolabdefinitions.h"
+#include "errorhandler.h"
 
-namespace Kolab {
+class QIODevice;
 
-class Freebusy;
+namespace Kolab {
 
 
 KOLAB_EXPORT KCalCore::Event::Ptr readV2EventXML(const QByteArray &xmlData, QStringList &attachments);
 
+/**
+ * Returns the object type, version and uid of a raw Kolab Mime message by only scanning the header block.
+ *
+ * The uid is read from the Subject header, which is where KolabObjectWriter stores it.
+ * The type of messages without X-Kolab-Type header can't be detected this way (InvalidObject is returned), use KolabObjectReader in that case.
+ */
+KOLAB_EXPORT ObjectType peekObjectHeaders(const QByteArray &rawMessage, Version &version, QString &uid);
+
 /**
  * Class to read Kolab Mime files
  * 
  * It implements the Kolab specifics of Mime message handling.
- * This class is not reusable and only meant to read a single object.
- * Parse the mime message and then call the correct getter, based on the type
+ * Parse the mime message and then call the correct getter, based on the type.
+ * Parsing a new message discards the previously read object, use KolabObjectBatchReader to read many objects.
  * 
  */
 class KOLAB_EXPORT KolabObjectReader {
@@ -52,6 +62,12 @@ public:
     ~KolabObjectReader();
     
     ObjectType parseMimeMessage(const KMime::Message::Ptr &msg);
+    /**
+     * Parses a raw mime message.
+     *
+     * Regular multipart/mixed messages (v2 and v3) are read directly from @param rawMessage, everything else is parsed with KMime.
+     */
+    ObjectType parseMessage(const QByteArray &rawMessage);
 
     /**
      * Set to override the autodetected object type, before parsing the message.
@@ -95,6 +111,61 @@ private:
     //@endcond
 };
 
+/**
+ * Class to read a sequence of Kolab Mime files (i.e. the contents of a folder)
+ *
+ * The reader is reused for every item, instead of creating a new KolabObjectReader per message.
+ * Identical contact pictures are shared between the items while the batch reader exists (see Conversion::PictureCacheBatch).
+ * The errors that occured while reading an item are reported with the result of that item.
+ */
+class KOLAB_EXPORT KolabObjectBatchReader {
+public:
+    struct Result {
+        Result(): type(InvalidObject), version(KolabV3), errorSeverity(ErrorHandler::Debug) {};
+        ObjectType type;
+        Version version;
+        ErrorHandler::Severity errorSeverity;
+        QString errorMessage;
+        KCalCore::Incidence::Ptr incidence;
+        KABC::Addressee contact;
+        KABC::ContactGroup distlist;
+        KMime::Message::Ptr note;
+        QStringList dictionary;
+        QString dictionaryLanguage;
+        Kolab::Freebusy freebusy;
+    };
+
+    KolabObjectBatchReader();
+    ~KolabObjectBatchReader();
+
+    /**
+     * Set to override the autodetected object type for all items.
+     */
+    void setObjectType(ObjectType);
+
+    /**
+     * Set to override the autodetected version for all items.
+     */
+    void setVersion(Version);
+
+    Result read(const KMime::Message::Ptr &msg);
+    /**
+     * Reads the raw mime message with KolabObjectReader::parseMessage().
+     */
+    Result read(const QByteArray &rawMessage);
+
+    QList<Result> read(const QList<KMime::Message::Ptr> &messages);
+    QList<Result> read(const QList<QByteArray> &rawMessages);
+
+private:
+    KolabObjectBatchReader(const KolabObjectBatchReader &);
+    KolabObjectBatchReader &operator=(const KolabObjectBatchReader &);
+    //@cond PRIVATE
+    class Private;
+    Private *const d;
+    //@endcond
+};
+
 /**
  * Class to write Kolab Mime files
  * 
@@ -111,7 +182,32 @@ public:
     static KMime::Message::Ptr writeNote(const KMime::Message::Ptr &, Version v = KolabV3, const QString &productId = QString());
     static KMime::Message::Ptr writeDictionary(const QStringList &, const QString &lang, Version v = KolabV3, const QString &productId = QString());
     static KMime::Message::Ptr writeFreebusy(const Kolab::Freebusy &, Version v = KolabV3, const QString &productId = QString());
-    
+
+    /**
+     * Write the libkolabxml containers directly, without conversion to KCalCore/KABC objects.
+     *
+     * Inline attachments are written as attachment parts referenced by cid:.
+     * Only v3 is implemented natively, for v2 the containers are converted and written with the v2 implementation.
+     */
+    static KMime::Message::Ptr writeEvent(const Kolab::Event &, Version v = KolabV3, const QString &productId = QString());
+    static KMime::Message::Ptr writeTodo(const Kolab::Todo &, Version v = KolabV3, const QString &productId = QString());
+    static KMime::Message::Ptr writeJournal(const Kolab::Journal &, Version v = KolabV3, const QString &productId = QString());
+    static KMime::Message::Ptr writeContact(const Kolab::Contact &, Version v = KolabV3, const QString &productId = QString());
+    static KMime::Message::Ptr writeDistlist(const Kolab::DistList &, Version v = KolabV3, const QString &productId = QString());
+
+    /**
+     * Write the libkolabxml containers as v3 mime message directly to @param device.
+     *
+     * The message is encoded while it is written, without building a KMime::Message or an encoded copy of it in memory.
+     * Use @param crlf to write CRLF line endings, i.e. for an IMAP APPEND.
+     *
+     * @return false if the object could not be serialized or the device could not be written to.
+     */
+    static bool writeEvent(const Kolab::Event &, QIODevice *device, const QString &productId = QString(), bool crlf = false);
+    static bool writeTodo(const Kolab::Todo &, QIODevice *device, const QString &productId = QString(), bool crlf = false);
+    static bool writeJournal(const Kolab::Journal &, QIODevice *device, const QString &productId = QString(), bool crlf = false);
+    static bool writeContact(const Kolab::Contact &, QIODevice *device, const QString &productId = QString(), bool crlf = false);
+    static bool writeDistlist(const Kolab::DistList &, QIODevice *device, const QString &productId = QString(), bool crlf = false);
 };
 
 }; //Namespace
@@ -3,6 +3,7 @@
     #define SWIG_PYTHON_EXTRA_NATIVE_CONTAINERS
     
     #include "../kolabformat/xmlobject.h"
+    #include "../kolabformat/mimeobject.h"
     #include "../kolabformat/kolabdefinitions.h"
 %}
 
@@ -12,5 +13,9 @@
 %import(module="kolabformat") <kolabevent.h>
 %import "../shared.i"
 
+/* The spill threshold of MIMEObject */
+typedef long long qint64;
+
 %include "../kolabformat/xmlobject.h"
+%include "../kolabformat/mimeobject.h"
 %include "../kolabformat/kolabdefinitions.h"
@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mimeobject.h"
+#include "kolabobject.h"
+#include "errorhandler.h"
+
+#include <mime/mimeutils.h>
+#include <mime/mimescanner.h>
+#include <conversion/kcalconversion.h>
+#include <conversion/kabcconversion.h>
+#include <conversion/kolabconversion.h>
+#include <conversion/commonconversion.h>
+
+namespace Kolab {
+
+//@cond PRIVATE
+class MIMEObject::Private
+{
+public:
+    Private()
+    :   mObjectType(InvalidObject),
+        mVersion(KolabV3),
+        mOverrideObjectType(InvalidObject),
+        mOverrideVersion(KolabV3),
+        mDoOverrideVersion(false)
+    {
+    }
+
+    void reset();
+    template <typename Message>
+    ObjectType readKolabV2(const Message &msg);
+    ObjectType readKolabV3(const KMime::Message::Ptr &msg, Kolab::ObjectType objectType);
+    ObjectType readKolabV3(const Mime::Scanner &scanner, bool &handled);
+    template <typename Parts>
+    ObjectType readKolabV3(const std::string &xml, Kolab::ObjectType objectType, const Parts &parts);
+
+    ObjectType mObjectType;
+    Version mVersion;
+    ObjectType mOverrideObjectType;
+    Version mOverrideVersion;
+    bool mDoOverrideVersion;
+    Mime::AttachmentSpill mSpill;
+
+    Kolab::Event mEvent;
+    Kolab::Todo mTodo;
+    Kolab::Journal mJournal;
+    Kolab::Contact mContact;
+    Kolab::DistList mDistlist;
+    Kolab::Note mNote;
+    Kolab::Configuration mConfiguration;
+    Kolab::Freebusy mFreebusy;
+};
+//@endcond
+
+void MIMEObject::Private::reset()
+{
+    mObjectType = InvalidObject;
+    mSpill.clear();
+    mEvent = Kolab::Event();
+    mTodo = Kolab::Todo();
+    mJournal = Kolab::Journal();
+    mContact = Kolab::Contact();
+    mDistlist = Kolab::DistList();
+    mNote = Kolab::Note();
+    mConfiguration = Kolab::Configuration();
+    mFreebusy = Kolab::Freebusy();
+}
+
+static ObjectType parse(KolabObjectReader &reader, const KMime::Message::Ptr &msg)
+{
+    return reader.parseMimeMessage(msg);
+}
+
+static ObjectType parse(KolabObjectReader &reader, const QByteArray &rawMessage)
+{
+    return reader.parseMessage(rawMessage);
+}
+
+/**
+ * Reads @param msg, either a KMime::Message::Ptr or the raw message.
+ */
+template <typename Message>
+ObjectType MIMEObject::Private::readKolabV2(const Message &msg)
+{
+    //There is no native v2 implementation, so we have to convert
+    KolabObjectReader reader;
+    reader.setVersion(KolabV2);
+    if (mOverrideObjectType != InvalidObject) {
+        reader.setObjectType(mOverrideObjectType);
+    }
+    const ObjectType objectType = parse(reader, msg);
+    switch (objectType) {
+        case EventObject:
+            if (KCalCore::Event::Ptr event = reader.getEvent()) {
+                mEvent = Conversion::fromKCalCore(*event);
+            }
+            break;
+        case TodoObject:
+            if (KCalCore::Todo::Ptr todo = reader.getTodo()) {
+                mTodo = Conversion::fromKCalCore(*todo);
+            }
+            break;
+        case JournalObject:
+            if (KCalCore::Journal::Ptr journal = reader.getJournal()) {
+                mJournal = Conversion::fromKCalCore(*journal);
+            }
+            break;
+        case ContactObject:
+            mContact = Conversion::fromKABC(reader.getContact());
+            break;
+        case DistlistObject:
+            mDistlist = Conversion::fromKABC(reader.getDistlist());
+            break;
+        case NoteObject:
+            if (KMime::Message::Ptr note = reader.getNote()) {
+                mNote = Conversion::fromNote(note);
+            }
+            break;
+        case DictionaryConfigurationObject: {
+            QString lang;
+            const QStringList entries = reader.getDictionary(lang);
+            Kolab::Dictionary dictionary(Conversion::toStdString(lang));
+            dictionary.setEntries(Conversion::fromStringList(entries));
+            mConfiguration = Kolab::Configuration(dictionary);
+        }
+            break;
+        default:
+            break;
+    }
+    mObjectType = objectType;
+    return objectType;
+}
+
+ObjectType MIMEObject::Private::readKolabV3(const KMime::Message::Ptr &msg, Kolab::ObjectType objectType)
+{
+    const Mime::PartIndex index(msg);
+    const Mime::PartIndex::Part *xmlPart = index.findByType( Mime::getMimeType(objectType) );
+    if ( !xmlPart ) {
+        Critical() << "no " << Mime::getMimeType(objectType) << " part found";
+        return InvalidObject;
+    }
+    std::string xml;
+    Mime::decodeContent(xmlPart->content, xml);
+    return readKolabV3(xml, objectType, index);
+}
+
+/**
+ * Reads a regular v3 message directly from the scanned raw message.
+ *
+ * @param handled is set to false if the message has to be parsed with KMime, because it relies on autodetection.
+ */
+ObjectType MIMEObject::Private::readKolabV3(const Mime::Scanner &scanner, bool &handled)
+{
+    handled = false;
+    Kolab::ObjectType objectType = mOverrideObjectType;
+    if (objectType == InvalidObject) {
+        const QByteArray &type = scanner.header(X_KOLAB_TYPE_HEADER);
+        if (type.isNull()) {
+            return InvalidObject;
+        }
+        objectType = Mime::getObjectType(QString::fromUtf8(type));
+    }
+    if (objectType == InvalidObject) {
+        return InvalidObject;
+    }
+    const Mime::Scanner::Part *xmlPart = scanner.findByType(Mime::getMimeType(objectType));
+    if (!xmlPart) {
+        return InvalidObject;
+    }
+    handled = true;
+    std::string xml;
+    scanner.decode(*xmlPart, xml);
+    return readKolabV3(xml, objectType, scanner);
+}
+
+template <typename Parts>
+ObjectType MIMEObject::Private::readKolabV3(const std::string &xml, Kolab::ObjectType objectType, const Parts &parts)
+{
+    switch (objectType) {
+        case EventObject:
+            mEvent = Kolab::readEvent(xml, false);
+            mEvent.setAttachments(Mime::getAttachmentsById(mEvent.attachments(), parts, &mSpill));
+            break;
+        case TodoObject:
+            mTodo = Kolab::readTodo(xml, false);
+            mTodo.setAttachments(Mime::getAttachmentsById(mTodo.attachments(), parts, &mSpill));
+            break;
+        case JournalObject:
+            mJournal = Kolab::readJournal(xml, false);
+            mJournal.setAttachments(Mime::getAttachmentsById(mJournal.attachments(), parts, &mSpill));
+            break;
+        case ContactObject:
+            mContact = Kolab::readContact(xml, false);
+            break;
+        case DistlistObject:
+            mDistlist = Kolab::readDistlist(xml, false);
+            break;
+        case NoteObject:
+            mNote = Kolab::readNote(xml, false);
+            break;
+        case DictionaryConfigurationObject:
+            mConfiguration = Kolab::readConfiguration(xml, false);
+            break;
+        case FreebusyObject:
+            mFreebusy = Kolab::readFreebusy(xml, false);
+            break;
+        default:
+            Critical() << "no kolab object found ";
+            break;
+    }
+    ErrorHandler::handleLibkolabxmlErrors();
+    if (ErrorHandler::instance().error() >= ErrorHandler::Critical) {
+        //The document could not be read
+        return InvalidObject;
+    }
+    mObjectType = objectType;
+    return objectType;
+}
+
+MIMEObject::MIMEObject()
+: d( new MIMEObject::Private )
+{
+}
+
+MIMEObject::~MIMEObject()
+{
+    delete d;
+}
+
+void MIMEObject::setObjectType(ObjectType type)
+{
+    d->mOverrideObjectType = type;
+}
+
+void MIMEObject::setVersion(Version version)
+{
+    d->mOverrideVersion = version;
+    d->mDoOverrideVersion = true;
+}
+
+void MIMEObject::setAttachmentSpillThreshold(qint64 bytes)
+{
+    d->mSpill.setThreshold(bytes);
+}
+
+ObjectType MIMEObject::parseMessage(const std::string &msg)
+{
+    //Regular messages are read directly from the raw message, everything else is parsed by KMime
+    const QByteArray rawMessage = QByteArray::fromRawData(msg.data(), msg.size());
+    const Mime::Scanner scanner(rawMessage);
+    if (scanner.isValid()) {
+        ErrorHandler::clearErrors();
+        d->reset();
+        d->mVersion = d->mDoOverrideVersion ? d->mOverrideVersion : Mime::getVersion(scanner);
+        if (d->mVersion == KolabV2) {
+            return d->readKolabV2(rawMessage);
+        }
+        bool handled = false;
+        const ObjectType objectType = d->readKolabV3(scanner, handled);
+        if (handled) {
+            return objectType;
+        }
+    }
+
+    KMime::Message::Ptr message(new KMime::Message);
+    message->setContent(KMime::CRLFtoLF(rawMessage));
+    message->parse();
+    return parseMimeMessage(message);
+}
+
+ObjectType MIMEObject::parseMimeMessage(const KMime::Message::Ptr &msg)
+{
+    ErrorHandler::clearErrors();
+    d->reset();
+    if (!msg || msg->contents().isEmpty()) {
+        Critical() << "message has no contents (we likely failed to parse it correctly)";
+        return InvalidObject;
+    }
+    if (!d->mDoOverrideVersion) {
+        d->mVersion = Mime::getVersion(msg);
+    } else {
+        d->mVersion = d->mOverrideVersion;
+    }
+    if (d->mVersion == KolabV2) {
+        return d->readKolabV2(msg);
+    }
+
+    Kolab::ObjectType objectType = d->mOverrideObjectType;
+    if (objectType == InvalidObject) {
+        objectType = Mime::getObjectType(msg);
+    }
+    if (objectType == InvalidObject) {
+        Critical() << "unable to detect object type";
+        return InvalidObject;
+    }
+    return d->readKolabV3(msg, objectType);
+}
+
+ObjectType MIMEObject::getType() const
+{
+    return d->mObjectType;
+}
+
+Version MIMEObject::getVersion() const
+{
+    return d->mVersion;
+}
+
+Kolab::Event MIMEObject::getEvent() const
+{
+    return d->mEvent;
+}
+
+Kolab::Todo MIMEObject::getTodo() const
+{
+    return d->mTodo;
+}
+
+Kolab::Journal MIMEObject::getJournal() const
+{
+    return d->mJournal;
+}
+
+Kolab::Contact MIMEObject::getContact() const
+{
+    return d->mContact;
+}
+
+Kolab::DistList MIMEObject::getDistlist() const
+{
+    return d->mDistlist;
+}
+
+Kolab::Note MIMEObject::getNote() const
+{
+    return d->mNote;
+}
+
+Kolab::Configuration MIMEObject::getConfiguration() const
+{
+    return d->mConfiguration;
+}
+
+Kolab::Freebusy MIMEObject::getFreebusy() const
+{
+    return d->mFreebusy;
+}
+
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KOLABMIMEOBJECT_H
+#define KOLABMIMEOBJECT_H
+
+#ifndef SWIG
+#include "kolab_export.h"
+#include <kmime/kmime_message.h>
+#else
+/* No export/import SWIG interface files */
+#define KOLAB_EXPORT
+#endif
+
+#include <kolabformat.h>
+
+#include "kolabdefinitions.h"
+
+namespace Kolab {
+
+/**
+ * Class to read Kolab Mime files into the libkolabxml containers
+ *
+ * In contrast to KolabObjectReader v3 objects are not converted to KCalCore/KABC objects,
+ * which saves two full conversions per object for users of the Kolab containers.
+ * Attachments referenced by a cid: uri are resolved from the attachment parts of the message.
+ *
+ * V2 objects are read using the v2 implementation and converted.
+ */
+class KOLAB_EXPORT MIMEObject
+{
+public:
+    MIMEObject();
+    ~MIMEObject();
+
+    /**
+     * Set to override the autodetected object type, before parsing the message.
+     */
+    void setObjectType(ObjectType);
+
+    /**
+     * Set to override the autodetected version, before parsing the message.
+     */
+    void setVersion(Version);
+
+    /**
+     * Attachments larger than @param bytes are decoded to temporary files and referenced by a file: uri, instead of being held in memory.
+     *
+     * The files are removed when the next message is parsed or the MIMEObject is destroyed.
+     * KolabObjectWriter embeds such attachments again when writing v3, the streaming writer encodes them directly from the file.
+     * Writing an object whose spilled files have been removed fails, so the objects must be written before that.
+     * 0 (the default) disables spilling.
+     */
+    void setAttachmentSpillThreshold(qint64 bytes);
+
+    /**
+     * Parses a raw mime message.
+     */
+    ObjectType parseMessage(const std::string &msg);
+#ifndef SWIG
+    ObjectType parseMimeMessage(const KMime::Message::Ptr &msg);
+#endif
+
+    /**
+     * Returns the Object type of the parsed kolab object.
+     */
+    ObjectType getType() const;
+    /**
+     * Returns the kolab-format version of the parsed kolab object.
+     */
+    Version getVersion() const;
+
+    /**
+     * Getter to get the retrieved object.
+     * Only the correct one will return a valid object.
+     *
+     * Use getType() to determine the correct one to call.
+     */
+    Kolab::Event getEvent() const;
+    Kolab::Todo getTodo() const;
+    Kolab::Journal getJournal() const;
+    Kolab::Contact getContact() const;
+    Kolab::DistList getDistlist() const;
+    Kolab::Note getNote() const;
+    Kolab::Configuration getConfiguration() const;
+    Kolab::Freebusy getFreebusy() const;
+
+private:
+    MIMEObject(const MIMEObject &);
+    MIMEObject &operator=(const MIMEObject &);
+    //@cond PRIVATE
+    class Private;
+    Private *const d;
+    //@endcond
+};
+
+}
+
+#endif // KOLABMIMEOBJECT_H
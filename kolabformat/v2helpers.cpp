@@ -31,96 +31,100 @@
 
 #include <kabc/contactgroup.h>
 
-#include <qdom.h>
+#include <QXmlStreamReader>
 #include <kdebug.h>
 #include <qbuffer.h>
+#include <qimagereader.h>
 #include <akonadi/notes/noteutils.h>
 
 namespace Kolab {
 
-static QImage getPicture(const QString &pictureAttachmentName, const KMime::Message::Ptr &data, QByteArray &type)
+/**
+ * Returns the encoded picture, it is only decoded if the pixels are accessed.
+ *
+ * Only the image header is checked here, pictures that can't be read are dropped like before.
+ */
+template <typename Parts>
+static QByteArray getPicture(const QString &pictureAttachmentName, const Parts &parts, QByteArray &type)
 {
-    if (!data) {
-        Critical() << "empty message";
-        return QImage();
-    }
-    KMime::Content *imgContent = Mime::findContentByName(data, pictureAttachmentName/*"kolab-picture.png"*/, type);
-    if (!imgContent) {
-        Warning() << "could not find picture: " << pictureAttachmentName;
-        return QImage();
+    const typename Parts::Part *part = parts.findByName(pictureAttachmentName/*"kolab-picture.png"*/);
+    if (!part) {
+        ReportError(Warning, AttachmentNotFound, pictureAttachmentName);
+        return QByteArray();
     }
-    QByteArray imgData = imgContent->decodedContent();
+    //Anything but jpeg is read as png
+    const bool jpeg = (part->type == "image/jpeg");
+    type = jpeg ? QByteArray("image/jpeg") : QByteArray("image/png");
+    QByteArray imgData = parts.decodedContent(*part);
     QBuffer buffer(&imgData);
     buffer.open(QIODevice::ReadOnly);
-    QImage image;
-    bool success = false;
-    if (type == "image/jpeg") {
-        success = image.load(&buffer, "JPEG");
-        //FIXME I tried getting the code to interpret the picture as PNG, but the VCard implementation writes it as JPEG anyways...
-//         if (success) {
-//             QByteArray pic;
-//             QBuffer b(&pic);
-//             b.open(QIODevice::ReadWrite);
-//             Q_ASSERT(image.save(&b, "PNG"));
-//             b.close();
-//             Debug() << pic.toBase64();
-//             QBuffer b2(&pic);
-//             b2.open(QIODevice::ReadOnly);
-//             success = image.load(&b2, "PNG");
-//             b2.close();
-//             Q_ASSERT(success);
-//         }
-    } else {
-        type = "image/png";
-        success = image.load(&buffer, "PNG");
-    }
-    buffer.close();
-    if (!success) {
+    if (!QImageReader(&buffer, jpeg ? "JPEG" : "PNG").canRead()) {
         Warning() << "failed to load picture";
+        return QByteArray();
     }
-    return image;
+    return imgData;
 }
 
-KABC::Addressee addresseeFromKolab( const QByteArray &xmlData, const KMime::Message::Ptr &data)
+template <typename Parts>
+static KABC::Addressee addresseeFromKolabImpl( const QByteArray &xmlData, const Parts &parts)
 {
-    if (!data) {
-        Critical() << "empty message";
-        return KABC::Addressee();
-    }
     KABC::Addressee addressee;
 //     Debug() << "xmlData " << xmlData;
-    KolabV2::Contact contact(QString::fromUtf8(xmlData));
+    KolabV2::Contact contact(xmlData);
     QByteArray type;
     const QString &pictureAttachmentName = contact.pictureAttachmentName();
     if (!pictureAttachmentName.isEmpty()) {
-        const QImage &img = getPicture(pictureAttachmentName, data, type);
-        contact.setPicture(img, type);
+        const QByteArray &img = getPicture(pictureAttachmentName, parts, type);
+        if (!img.isEmpty()) {
+            contact.setPictureData(img, type);
+        }
     }
     
     const QString &logoAttachmentName = contact.logoAttachmentName();
     if (!logoAttachmentName.isEmpty()) {
-        contact.setLogo(getPicture(logoAttachmentName, data, type), type);
+        const QByteArray &img = getPicture(logoAttachmentName, parts, type);
+        if (!img.isEmpty()) {
+            contact.setLogoData(img, type);
+        }
     }
     
     const QString &soundAttachmentName = contact.soundAttachmentName();
     if (!soundAttachmentName.isEmpty()) {
-        QByteArray type;
-        KMime::Content *content = Mime::findContentByName(data, soundAttachmentName/*"sound"*/, type);
-        if (content) {
-            const QByteArray &sData = content->decodedContent();
+        const typename Parts::Part *part = parts.findByName(soundAttachmentName/*"sound"*/);
+        if (part) {
+            const QByteArray &sData = parts.decodedContent(*part);
             contact.setSound(sData);
         } else {
-            Warning() << "could not find sound: " << soundAttachmentName;
+            ReportError(Warning, AttachmentNotFound, soundAttachmentName);
         }
     }
     contact.saveTo(&addressee);
     return addressee;
 }
 
+KABC::Addressee addresseeFromKolab( const QByteArray &xmlData, const KMime::Message::Ptr &data)
+{
+    if (!data) {
+        Critical() << "empty message";
+        return KABC::Addressee();
+    }
+    return addresseeFromKolab(xmlData, Mime::PartIndex(data));
+}
+
+KABC::Addressee addresseeFromKolab( const QByteArray &xmlData, const Mime::PartIndex &index)
+{
+    return addresseeFromKolabImpl(xmlData, index);
+}
+
+KABC::Addressee addresseeFromKolab( const QByteArray &xmlData, const Mime::Scanner &scanner)
+{
+    return addresseeFromKolabImpl(xmlData, scanner);
+}
+
 KABC::Addressee addresseeFromKolab(const QByteArray &xmlData, QString &pictureAttachmentName, QString &logoAttachmentName, QString &soundAttachmentName)
 {
     KABC::Addressee addressee;
-    KolabV2::Contact contact(QString::fromUtf8(xmlData));
+    KolabV2::Contact contact(xmlData);
     pictureAttachmentName = contact.pictureAttachmentName();
     logoAttachmentName = contact.logoAttachmentName();
     soundAttachmentName = contact.soundAttachmentName();
@@ -155,19 +159,26 @@ KMime::Message::Ptr contactToKolabFormat(const KolabV2::Contact& contact, const
     message->subject()->fromUnicodeString( contact.uid(), "utf-8" );
     message->from()->fromUnicodeString( contact.fullEmail(), "utf-8" );
     
-    KMime::Content* content = Mime::createMainPart( KOLAB_TYPE_CONTACT, contact.saveXML().toUtf8() );
+    KMime::Content* content = Mime::createMainPart( KOLAB_TYPE_CONTACT, contact.saveXML() );
     message->addContent( content );
     
-    if ( !contact.picture().isNull() ) {
-        QString type;
-        const QByteArray &pic = createPicture(contact.picture(), contact.pictureFormat(), type);
+    if ( contact.hasPicture() ) {
+        //The picture we have read is written back unchanged
+        QString type = contact.pictureFormat();
+        QByteArray pic = contact.pictureData();
+        if (pic.isEmpty()) {
+            pic = createPicture(contact.picture(), contact.pictureFormat(), type);
+        }
         content = Mime::createAttachmentPart(QByteArray(), type, /*"kolab-picture.png"*/contact.pictureAttachmentName(), pic );
         message->addContent(content);
     }
     
-    if ( !contact.logo().isNull() ) {
-        QString type;
-        const QByteArray &pic = createPicture(contact.logo(), contact.logoFormat(), type);
+    if ( contact.hasLogo() ) {
+        QString type = contact.logoFormat();
+        QByteArray pic = contact.logoData();
+        if (pic.isEmpty()) {
+            pic = createPicture(contact.logo(), contact.logoFormat(), type);
+        }
         content = Mime::createAttachmentPart(QByteArray(), type, /*"kolab-logo.png"*/contact.logoAttachmentName(), pic );
         message->addContent(content);
     }
@@ -185,7 +196,7 @@ KABC::ContactGroup contactGroupFromKolab(const QByteArray &xmlData)
 {
     KABC::ContactGroup contactGroup;
     //     kDebug() << "xmlData " << xmlData;
-    KolabV2::DistributionList distList(QString::fromUtf8(xmlData));
+    KolabV2::DistributionList distList(xmlData);
     distList.saveTo(&contactGroup);
     return contactGroup;
 }
@@ -200,7 +211,7 @@ KMime::Message::Ptr distListToKolabFormat(const KolabV2::DistributionList& distL
     message->subject()->fromUnicodeString( distList.uid(), "utf-8" );
     message->from()->fromUnicodeString( distList.uid(), "utf-8" );
     
-    KMime::Content* content = Mime::createMainPart( KOLAB_TYPE_DISTLIST, distList.saveXML().toUtf8() );
+    KMime::Content* content = Mime::createMainPart( KOLAB_TYPE_DISTLIST, distList.saveXML() );
     message->addContent( content );
     
     message->assemble();
@@ -243,36 +254,36 @@ QByteArray noteToKolabXML(const KMime::Message::Ptr& msg)
     KolabV2::Note j;
     j.setSummary( note.title() );
     j.setBody( note.text() );
-    return j.saveXML().toUtf8();
+    return j.saveXML();
 }
 
 QStringList readLegacyDictionaryConfiguration(const QByteArray &xmlData, QString &language)
 {
     QStringList dictionary;
-    const QDomDocument xmlDoc = KolabV2::KolabBase::loadDocument( QString::fromUtf8(xmlData) ); //TODO extract function from V2 format
-    if ( xmlDoc.isNull() ) {
-        Error() << "Failed to read the xml document";
+    QXmlStreamReader reader(xmlData);
+    if (!reader.readNextStartElement()) {
+        Error() << "Failed to read the xml document" << reader.errorString();
         return QStringList();
     }
-
-    QDomElement top = xmlDoc.documentElement();
-
-    if ( top.tagName() != "configuration" ) {
+    if (reader.name() != QLatin1String("configuration")) {
         qWarning( "XML error: Top tag was %s instead of the expected configuration",
-                top.tagName().toAscii().data() );
+                reader.name().toString().toAscii().data() );
         return QStringList();
     }
 
-    for ( QDomNode n = top.firstChild(); !n.isNull(); n = n.nextSibling() ) {
-        if ( n.isComment() || !n.isElement() )
-            continue;
-        QDomElement e = n.toElement();
-        if (e.tagName() == "language") {
-            language = e.text();
-        } else if (e.tagName() == "e") {
-            dictionary.append(e.text());
+    while (reader.readNextStartElement()) {
+        if (reader.name() == QLatin1String("language")) {
+            language = reader.readElementText(QXmlStreamReader::IncludeChildElements);
+        } else if (reader.name() == QLatin1String("e")) {
+            dictionary.append(reader.readElementText(QXmlStreamReader::IncludeChildElements));
+        } else {
+            reader.skipCurrentElement();
         }
     }
+    if (reader.hasError()) {
+        Error() << "Failed to read the xml document" << reader.errorString();
+        return QStringList();
+    }
     return dictionary;
 }
 
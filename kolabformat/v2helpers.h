@@ -28,6 +28,7 @@
 #include "kolabformatV2/distributionlist.h"
 #include "kolabformatV2/note.h"
 #include "mime/mimeutils.h"
+#include "mime/mimescanner.h"
 #include "kolabformat/errorhandler.h"
 
 #include <kabc/contactgroup.h>
@@ -45,38 +46,36 @@ namespace Kolab {
 template <typename KCalPtr, typename Container>
 static KCalPtr fromXML(const QByteArray &xmlData, QStringList &attachments)
 {
-    const QDomDocument xmlDoc = KolabV2::KolabBase::loadDocument( QString::fromUtf8(xmlData) ); //TODO extract function from V2 format
-    if ( xmlDoc.isNull() ) {
+    //Single pass over the raw xml, the inline attachment names are collected on the way
+    const KCalPtr i = Container::fromXml( xmlData, QString(), attachments ); //For parsing we don't need the timezone, so we don't set one
+    if ( !i ) {
         Critical() << "Failed to read the xml document";
         return KCalPtr();
     }
-    const KCalPtr i = Container::fromXml( xmlDoc, QString() ); //For parsing we don't need the timezone, so we don't set one
-    Q_ASSERT ( i );
-    QDomNodeList nodes = xmlDoc.elementsByTagName("inline-attachment");
-    for (int i = 0; i < nodes.size(); i++ ) {
-        attachments.append(nodes.at(i).toElement().text());
-    }
     return i;
 }
 
 template <typename IncidencePtr, typename Converter>
 static inline IncidencePtr incidenceFromKolabImpl( const KMime::Message::Ptr &data, const QByteArray &mimetype, const QString &timezoneId )
 {
-    KMime::Content *xmlContent = Mime::findContentByType( data, mimetype );
-    if ( !xmlContent ) {
+    const Mime::PartIndex index(data);
+    const Mime::PartIndex::Part *xmlPart = index.findByType( mimetype );
+    if ( !xmlPart ) {
         Critical() << "couldn't find part";
         return IncidencePtr();
     }
-    const QByteArray &xmlData = xmlContent->decodedContent();
+    const QByteArray &xmlData = xmlPart->content->decodedContent();
     
     QStringList attachments;
     IncidencePtr ptr = fromXML<IncidencePtr, Converter>(xmlData, attachments); //TODO do we care about timezone?
-    Mime::getAttachments(ptr, attachments, data);
+    Mime::getAttachments(ptr, attachments, index);
     
     return ptr;
 }
 
 KABC::Addressee addresseeFromKolab( const QByteArray &xmlData, const KMime::Message::Ptr &data);
+KABC::Addressee addresseeFromKolab( const QByteArray &xmlData, const Mime::PartIndex &index);
+KABC::Addressee addresseeFromKolab( const QByteArray &xmlData, const Mime::Scanner &scanner);
 KABC::Addressee addresseeFromKolab( const QByteArray &xmlData, QString &pictureAttachmentName, QString &logoAttachmentName, QString &soundAttachmentName);
 
 KMime::Message::Ptr contactToKolabFormat(const KolabV2::Contact& contact, const QString &productId);
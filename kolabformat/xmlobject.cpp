@@ -61,8 +61,8 @@ std::string XMLObject::writeEvent(const Event &event, Version version, const std
         }
         mWrittenUID = Conversion::toStdString(i->uid());
         //The timezone is used for created and last modified dates
-        const QString &xml = KolabV2::Event::eventToXML(i, QLatin1String("UTC"));
-        return Conversion::toStdString(xml);
+        const QByteArray &xml = KolabV2::Event::eventToXML(i, QLatin1String("UTC"));
+        return std::string(xml.constData(), xml.size());
     }
     const std::string result = Kolab::writeEvent(event, productId);
     mWrittenUID = Kolab::getSerializedUID();
@@ -101,8 +101,8 @@ std::string XMLObject::writeTodo(const Todo &event, Version version, const std::
         }
         mWrittenUID = Conversion::toStdString(i->uid());
         //The timezone is used for created and last modified dates
-        const QString &xml = KolabV2::Task::taskToXML(i, QLatin1String("UTC"));
-        return Conversion::toStdString(xml);
+        const QByteArray &xml = KolabV2::Task::taskToXML(i, QLatin1String("UTC"));
+        return std::string(xml.constData(), xml.size());
     }
     const std::string result = Kolab::writeTodo(event, productId);
     mWrittenUID = Kolab::getSerializedUID();
@@ -141,8 +141,8 @@ std::string XMLObject::writeJournal(const Journal &event, Version version, const
         }
         mWrittenUID = Conversion::toStdString(i->uid());
         //The timezone is used for created and last modified dates
-        const QString &xml = KolabV2::Journal::journalToXML(i, QLatin1String("UTC"));
-        return Conversion::toStdString(xml);
+        const QByteArray &xml = KolabV2::Journal::journalToXML(i, QLatin1String("UTC"));
+        return std::string(xml.constData(), xml.size());
     }
     const std::string result = Kolab::writeJournal(event, productId);
     mWrittenUID = Kolab::getSerializedUID();
@@ -230,7 +230,8 @@ std::string XMLObject::writeContact(const Contact &contact, Version version, con
         }
         mWrittenUID = Conversion::toStdString(addressee.uid());
         const KolabV2::Contact contact(&addressee);
-        return Conversion::toStdString(contact.saveXML());
+        const QByteArray &xml = contact.saveXML();
+        return std::string(xml.constData(), xml.size());
     }
     const std::string result = Kolab::writeContact(contact, productId);
     mWrittenUID = Kolab::getSerializedUID();
@@ -257,7 +258,8 @@ std::string XMLObject::writeDistlist(const DistList &distlist, Version version,
         }
         mWrittenUID = Conversion::toStdString(contactGroup.id());
         const KolabV2::DistributionList d(&contactGroup);
-        return Conversion::toStdString(d.saveXML());
+        const QByteArray &xml = d.saveXML();
+        return std::string(xml.constData(), xml.size());
     }
     const std::string result = Kolab::writeDistlist(distlist, productId);
     mWrittenUID = Kolab::getSerializedUID();
@@ -31,6 +31,7 @@
 */
 
 #include "contact.h"
+#include "xmlwriter.h"
 
 #include <kabc/addressee.h>
 #include <kcalcore/freebusyurlstore.h>
@@ -59,6 +60,12 @@ Contact::Contact( const QString& xml )
   load( xml );
 }
 
+Contact::Contact( const QByteArray& xml )
+  : mHasGeo( false )
+{
+  load( xml );
+}
+
 Contact::~Contact()
 {
 }
@@ -283,6 +290,54 @@ QDate Contact::anniversary() const
   return mAnniversary;
 }
 
+// Only png and jpeg pictures can be read back, see getPicture() in v2helpers
+static QString pictureMimeType( const QString& type )
+{
+  const QString t = type.toLower();
+  if ( t == "image/jpeg" || t == "jpeg" || t == "jpg" )
+    return "image/jpeg";
+  if ( t == "image/png" || t == "png" )
+    return "image/png";
+  return QString();
+}
+
+static QImage decodePicture( const QByteArray& data, const QString& format )
+{
+  QImage image;
+  if ( !image.loadFromData( data, format == "image/jpeg" ? "JPEG" : "PNG" ) )
+    kWarning() << "failed to load picture";
+  return image;
+}
+
+static KABC::Picture toAddresseePicture( const QByteArray& data, const QImage& image,
+                                         const QString& format )
+{
+  KABC::Picture picture;
+#ifdef KABC_PICTURE_RAWDATA
+  if ( !data.isEmpty() ) {
+    picture.setRawData( data, format );
+    return picture;
+  }
+#endif
+  picture.setData( image.isNull() ? decodePicture( data, format ) : image );
+  picture.setType( format );
+  return picture;
+}
+
+QImage Contact::picture() const
+{
+  if ( mPicture.isNull() && !mPictureData.isEmpty() )
+    mPicture = decodePicture( mPictureData, mPictureFormat );
+  return mPicture;
+}
+
+QImage Contact::logo() const
+{
+  if ( mLogo.isNull() && !mLogoData.isEmpty() )
+    mLogo = decodePicture( mLogoData, mLogoFormat );
+  return mLogo;
+}
+
 void Contact::setChildren( const QString& children )
 {
   mChildren = children;
@@ -406,18 +461,18 @@ bool Contact::loadNameAttribute( QDomElement& element )
   return true;
 }
 
-void Contact::saveNameAttribute( QDomElement& element ) const
+void Contact::saveNameAttribute( XmlWriter& writer ) const
 {
-  QDomElement e = element.ownerDocument().createElement( "name" );
-  element.appendChild( e );
+  writer.writeStartElement( "name" );
 
-  writeString( e, "given-name", givenName() );
-  writeString( e, "middle-names", middleNames() );
-  writeString( e, "last-name", lastName() );
-  writeString( e, "full-name", fullName() );
-  writeString( e, "initials", initials() );
-  writeString( e, "prefix", prefix() );
-  writeString( e, "suffix", suffix() );
+  writeString( writer, "given-name", givenName() );
+  writeString( writer, "middle-names", middleNames() );
+  writeString( writer, "last-name", lastName() );
+  writeString( writer, "full-name", fullName() );
+  writeString( writer, "initials", initials() );
+  writeString( writer, "prefix", prefix() );
+  writeString( writer, "suffix", suffix() );
+  writer.writeEndElement();
 }
 
 bool Contact::loadPhoneAttribute( QDomElement& element )
@@ -445,23 +500,23 @@ bool Contact::loadPhoneAttribute( QDomElement& element )
   return true;
 }
 
-void Contact::savePhoneAttributes( QDomElement& element ) const
+void Contact::savePhoneAttributes( XmlWriter& writer ) const
 {
   QList<PhoneNumber>::ConstIterator it = mPhoneNumbers.constBegin();
   for ( ; it != mPhoneNumbers.constEnd(); ++it ) {
-    QDomElement e = element.ownerDocument().createElement( "phone" );
-    element.appendChild( e );
+    writer.writeStartElement( "phone" );
     const PhoneNumber& p = *it;
-    writeString( e, "type", p.type );
-    writeString( e, "number", p.number );
+    writeString( writer, "type", p.type );
+    writeString( writer, "number", p.number );
+    writer.writeEndElement();
   }
 }
 
-void Contact::saveEmailAttributes( QDomElement& element ) const
+void Contact::saveEmailAttributes( XmlWriter& writer ) const
 {
   QList<Email>::ConstIterator it = mEmails.constBegin();
   for ( ; it != mEmails.constEnd(); ++it )
-    saveEmailAttribute( element, *it );
+    saveEmailAttribute( writer, *it );
 }
 
 void Contact::loadCustomAttributes( QDomElement& element )
@@ -473,20 +528,21 @@ void Contact::loadCustomAttributes( QDomElement& element )
   mCustomList.append( custom );
 }
 
-void Contact::saveCustomAttributes( QDomElement& element ) const
+void Contact::saveCustomAttributes( XmlWriter& writer ) const
 {
   QList<Custom>::ConstIterator it = mCustomList.constBegin();
   for ( ; it != mCustomList.constEnd(); ++it ) {
     Q_ASSERT( !(*it).name.isEmpty() );
     if ( (*it).app == s_unhandledTagAppName ) {
-      writeString( element, (*it).name, (*it).value );
+      writeString( writer, (*it).name, (*it).value );
     } else {
       // Let's use attributes so that other tag-preserving-code doesn't need sub-elements
-      QDomElement e = element.ownerDocument().createElement( "x-custom" );
-      element.appendChild( e );
-      e.setAttribute( "app", (*it).app );
-      e.setAttribute( "name", (*it).name );
-      e.setAttribute( "value", (*it).value );
+      // The attribute order is the one of the former DOM based writer
+      writer.writeStartElement( "x-custom" );
+      writer.writeAttribute( "value", (*it).value );
+      writer.writeAttribute( "app", (*it).app );
+      writer.writeAttribute( "name", (*it).name );
+      writer.writeEndElement();
     }
   }
 }
@@ -529,27 +585,27 @@ bool Contact::loadAddressAttribute( QDomElement& element )
   return true;
 }
 
-void Contact::saveAddressAttributes( QDomElement& element ) const
+void Contact::saveAddressAttributes( XmlWriter& writer ) const
 {
   QList<Address>::ConstIterator it = mAddresses.constBegin();
   for ( ; it != mAddresses.constEnd(); ++it ) {
-    QDomElement e = element.ownerDocument().createElement( "address" );
-    element.appendChild( e );
+    writer.writeStartElement( "address" );
     const Address& a = *it;
-    writeString( e, "type", a.type );
-    writeString( e, "x-kde-type", QString::number( a.kdeAddressType ) );
+    writeString( writer, "type", a.type );
+    writeString( writer, "x-kde-type", QString::number( a.kdeAddressType ) );
     if ( !a.street.isEmpty() )
-      writeString( e, "street", a.street );
+      writeString( writer, "street", a.street );
     if ( !a.pobox.isEmpty() )
-      writeString( e, "pobox", a.pobox );
+      writeString( writer, "pobox", a.pobox );
     if ( !a.locality.isEmpty() )
-    writeString( e, "locality", a.locality );
+    writeString( writer, "locality", a.locality );
     if ( !a.region.isEmpty() )
-      writeString( e, "region", a.region );
+      writeString( writer, "region", a.region );
     if ( !a.postalCode.isEmpty() )
-      writeString( e, "postal-code", a.postalCode );
+      writeString( writer, "postal-code", a.postalCode );
     if ( !a.country.isEmpty() )
-      writeString( e, "country", a.country );
+      writeString( writer, "country", a.country );
+    writer.writeEndElement();
   }
 }
 
@@ -722,48 +778,59 @@ bool Contact::loadAttribute( QDomElement& element )
   return KolabBase::loadAttribute( element );
 }
 
-bool Contact::saveAttributes( QDomElement& element ) const
+bool Contact::saveAttributes( XmlWriter& writer ) const
 {
   // Save the base class elements
-  KolabBase::saveAttributes( element );
-  saveNameAttribute( element );
-  writeString( element, "free-busy-url", freeBusyUrl() );
-  writeString( element, "organization", organization() );
-  writeString( element, "web-page", webPage() );
-  writeString( element, "im-address", imAddress() );
-  writeString( element, "department", department() );
-  writeString( element, "office-location", officeLocation() );
-  writeString( element, "profession", profession() );
-  writeString( element, "role", role() );
-  writeString( element, "job-title", title() );
-  writeString( element, "manager-name", managerName() );
-  writeString( element, "assistant", assistant() );
-  writeString( element, "nick-name", nickName() );
-  writeString( element, "spouse-name", spouseName() );
-  writeString( element, "birthday", dateToString( birthday() ) );
-  writeString( element, "anniversary", dateToString( anniversary() ) );
-  if ( !picture().isNull() )
-    writeString( element, "picture", mPictureAttachmentName );
-  if ( !logo().isNull() )
-    writeString( element, "x-logo", mLogoAttachmentName );
+  KolabBase::saveAttributes( writer );
+  saveNameAttribute( writer );
+  writeString( writer, "free-busy-url", freeBusyUrl() );
+  writeString( writer, "organization", organization() );
+  writeString( writer, "web-page", webPage() );
+  writeString( writer, "im-address", imAddress() );
+  writeString( writer, "department", department() );
+  writeString( writer, "office-location", officeLocation() );
+  writeString( writer, "profession", profession() );
+  writeString( writer, "role", role() );
+  writeString( writer, "job-title", title() );
+  writeString( writer, "manager-name", managerName() );
+  writeString( writer, "assistant", assistant() );
+  writeString( writer, "nick-name", nickName() );
+  writeString( writer, "spouse-name", spouseName() );
+  writeString( writer, "birthday", dateToString( birthday() ) );
+  writeString( writer, "anniversary", dateToString( anniversary() ) );
+  if ( hasPicture() )
+    writeString( writer, "picture", mPictureAttachmentName );
+  if ( hasLogo() )
+    writeString( writer, "x-logo", mLogoAttachmentName );
   if ( !sound().isNull() )
-    writeString( element, "x-sound", mSoundAttachmentName );
-  writeString( element, "children", children() );
-  writeString( element, "gender", gender() );
-  writeString( element, "language", language() );
-  savePhoneAttributes( element );
-  saveEmailAttributes( element );
-  saveAddressAttributes( element );
-  writeString( element, "preferred-address", preferredAddress() );
+    writeString( writer, "x-sound", mSoundAttachmentName );
+  writeString( writer, "children", children() );
+  writeString( writer, "gender", gender() );
+  writeString( writer, "language", language() );
+  savePhoneAttributes( writer );
+  saveEmailAttributes( writer );
+  saveAddressAttributes( writer );
+  writeString( writer, "preferred-address", preferredAddress() );
   if ( mHasGeo ) {
-    writeString( element, "latitude", QString::number( latitude(), 'g', DBL_DIG ) );
-    writeString( element, "longitude", QString::number( longitude(), 'g', DBL_DIG ) );
+    writeString( writer, "latitude", QString::number( latitude(), 'g', DBL_DIG ) );
+    writeString( writer, "longitude", QString::number( longitude(), 'g', DBL_DIG ) );
   }
-  saveCustomAttributes( element );
+  saveCustomAttributes( writer );
 
   return true;
 }
 
+void Contact::loadUnhandledAttribute( QDomElement& element )
+{
+  // Unhandled tag - save for later storage
+  //kDebug() <<"Saving unhandled tag" << element.tagName();
+  Custom c;
+  c.app = s_unhandledTagAppName;
+  c.name = element.tagName();
+  c.value = element.text();
+  mCustomList.append( c );
+}
+
 bool Contact::loadXML( const QDomDocument& document )
 {
   QDomElement top = document.documentElement();
@@ -779,15 +846,8 @@ bool Contact::loadXML( const QDomDocument& document )
       continue;
     if ( n.isElement() ) {
       QDomElement e = n.toElement();
-      if ( !loadAttribute( e ) ) {
-        // Unhandled tag - save for later storage
-        //kDebug() <<"Saving unhandled tag" << e.tagName();
-        Custom c;
-        c.app = s_unhandledTagAppName;
-        c.name = e.tagName();
-        c.value = e.text();
-        mCustomList.append( c );
-      }
+      if ( !loadAttribute( e ) )
+        loadUnhandledAttribute( e );
     } else
       kDebug() <<"Node is not a comment or an element???";
   }
@@ -795,16 +855,6 @@ bool Contact::loadXML( const QDomDocument& document )
   return true;
 }
 
-QString Contact::saveXML() const
-{
-  QDomDocument document = domTree();
-  QDomElement element = document.createElement("contact" );
-  element.setAttribute( "version", "1.0" );
-  saveAttributes( element );
-  document.appendChild( element );
-  return document.toString();
-}
-
 static QString addressTypeToString( int /*KABC::Address::Type*/ type )
 {
   if ( type & KABC::Address::Home )
@@ -1013,12 +1063,12 @@ void Contact::setFields( const KABC::Addressee* addressee )
     }
   }
 
-  setPicture( loadPictureFromAddressee( addressee->photo() ), addressee->photo().type() );
+  loadPictureFromAddressee( addressee->photo(), mPicture, mPictureData, mPictureFormat );
   mPictureAttachmentName = addressee->custom( "KOLAB", "PictureAttachmentName" );
   if ( mPictureAttachmentName.isEmpty() )
     mPictureAttachmentName = s_pictureAttachmentName;
 
-  setLogo( loadPictureFromAddressee( addressee->logo() ), addressee->logo().type() );
+  loadPictureFromAddressee( addressee->logo(), mLogo, mLogoData, mLogoFormat );
   mLogoAttachmentName = addressee->custom( "KOLAB", "LogoAttachmentName" );
   if ( mLogoAttachmentName.isEmpty() )
     mLogoAttachmentName = s_logoAttachmentName;
@@ -1113,19 +1163,13 @@ void Contact::saveTo( KABC::Addressee* addressee )
 
   // We need to store both the original attachment name and the picture data into the addressee.
   // This is important, otherwise we would save the image under another attachment name w/o deleting the original one!
-  if ( !mPicture.isNull() ) {
-    KABC::Picture picture( mPicture );
-    picture.setType(mPictureFormat);
-    addressee->setPhoto( picture );
-  }
+  if ( hasPicture() )
+    addressee->setPhoto( toAddresseePicture( mPictureData, mPicture, mPictureFormat ) );
   // Note that we must save the filename in all cases, so that removing the picture
   // actually deletes the attachment.
   addressee->insertCustom( "KOLAB", "PictureAttachmentName", mPictureAttachmentName );
-  if ( !mLogo.isNull() ) {
-    KABC::Picture picture( mLogo );
-    picture.setType(mLogoFormat);
-    addressee->setLogo( picture );
-  }
+  if ( hasLogo() )
+    addressee->setLogo( toAddresseePicture( mLogoData, mLogo, mLogoFormat ) );
   addressee->insertCustom( "KOLAB", "LogoAttachmentName", mLogoAttachmentName );
   if ( !mSound.isNull() )
     addressee->setSound( KABC::Sound( mSound ) );
@@ -1173,9 +1217,12 @@ void Contact::saveTo( KABC::Addressee* addressee )
   //kDebug() << addressee->customs();
 }
 
-QImage Contact::loadPictureFromAddressee( const KABC::Picture& picture )
+void Contact::loadPictureFromAddressee( const KABC::Picture& picture, QImage& image,
+                                        QByteArray& data, QString& format )
 {
-  QImage img;
+  image = QImage();
+  data.clear();
+  format = picture.type();
   if ( !picture.isIntern() && !picture.url().isEmpty() ) {
     QString tmpFile;
     kWarning() << "external pictures are currently not supported";
@@ -1184,9 +1231,18 @@ QImage Contact::loadPictureFromAddressee( const KABC::Picture& picture )
 //       img.load( tmpFile );
 //       KIO::NetAccess::removeTempFile( tmpFile );
 //     }
-  } else
-    img = picture.data();
-  return img;
+    return;
+  }
+#ifdef KABC_PICTURE_RAWDATA
+  // Keep pictures we can read back encoded, so they are written unchanged
+  const QString mimeType = pictureMimeType( picture.type() );
+  if ( !mimeType.isEmpty() && !picture.rawData().isEmpty() ) {
+    data = picture.rawData();
+    format = mimeType;
+    return;
+  }
+#endif
+  image = picture.data();
 }
 
 QByteArray KolabV2::Contact::loadSoundFromAddressee( const KABC::Sound& sound )
@@ -69,6 +69,8 @@ public:
 
   explicit Contact( const KABC::Addressee* address );
   Contact( const QString& xml );
+  // loading from the UTF-8 encoded xml, without building a DOM
+  explicit Contact( const QByteArray& xml );
   ~Contact();
 
   void saveTo( KABC::Addressee* address );
@@ -141,15 +143,23 @@ public:
   void setAnniversary( const QDate& date );
   QDate anniversary() const;
 
-  void setPicture( const QImage& image, const QString &format) { mPicture = image; mPictureFormat = format; }
+  void setPicture( const QImage& image, const QString &format) { mPicture = image; mPictureData.clear(); mPictureFormat = format; }
+  // Sets the encoded png or jpeg picture, it is only decoded by picture()
+  void setPictureData( const QByteArray& data, const QString &format ) { mPictureData = data; mPicture = QImage(); mPictureFormat = format; }
   QString pictureAttachmentName() const { return mPictureAttachmentName; }
   QString pictureFormat() const { return mPictureFormat; }
-  QImage picture() const { return mPicture; }
+  QImage picture() const;
+  // The encoded picture, empty if the picture has been set as image
+  QByteArray pictureData() const { return mPictureData; }
+  bool hasPicture() const { return !mPictureData.isEmpty() || !mPicture.isNull(); }
 
-  void setLogo( const QImage& image, const QString &format ) { mLogo = image; mLogoFormat = format; }
+  void setLogo( const QImage& image, const QString &format ) { mLogo = image; mLogoData.clear(); mLogoFormat = format; }
+  void setLogoData( const QByteArray& data, const QString &format ) { mLogoData = data; mLogo = QImage(); mLogoFormat = format; }
   QString logoAttachmentName() const { return mLogoAttachmentName; }
   QString logoFormat() const { return mLogoFormat; }
-  QImage logo() const { return mLogo; }
+  QImage logo() const;
+  QByteArray logoData() const { return mLogoData; }
+  bool hasLogo() const { return !mLogoData.isEmpty() || !mLogo.isNull(); }
 
   void setSound( const QByteArray& sound ) { mSound = sound; }
   QString soundAttachmentName() const { return mSoundAttachmentName; }
@@ -192,33 +202,34 @@ public:
   bool loadAttribute( QDomElement& );
 
   // Save the attributes of this class
-  bool saveAttributes( QDomElement& ) const;
+  bool saveAttributes( XmlWriter& ) const;
 
   // Load this note by reading the XML file
   bool loadXML( const QDomDocument& xml );
 
-  // Serialize this note to an XML string
-  QString saveXML() const;
-
 protected:
   void setFields( const KABC::Addressee* );
 
+  QString topTagName() const { return "contact"; }
+  void loadUnhandledAttribute( QDomElement& );
+
 private:
   bool loadNameAttribute( QDomElement& element );
-  void saveNameAttribute( QDomElement& element ) const;
+  void saveNameAttribute( XmlWriter& writer ) const;
 
   bool loadPhoneAttribute( QDomElement& element );
-  void savePhoneAttributes( QDomElement& element ) const;
+  void savePhoneAttributes( XmlWriter& writer ) const;
 
-  void saveEmailAttributes( QDomElement& element ) const;
+  void saveEmailAttributes( XmlWriter& writer ) const;
 
   bool loadAddressAttribute( QDomElement& element );
-  void saveAddressAttributes( QDomElement& element ) const;
+  void saveAddressAttributes( XmlWriter& writer ) const;
 
   void loadCustomAttributes( QDomElement& element );
-  void saveCustomAttributes( QDomElement& element ) const;
+  void saveCustomAttributes( XmlWriter& writer ) const;
 
-  QImage loadPictureFromAddressee( const KABC::Picture& picture );
+  void loadPictureFromAddressee( const KABC::Picture& picture, QImage& image,
+                                 QByteArray& data, QString& format );
 
   QByteArray loadSoundFromAddressee( const KABC::Sound& sound );
 
@@ -246,9 +257,12 @@ private:
   QString mSpouseName;
   QDate mBirthday;
   QDate mAnniversary;
-  QImage mPicture;
+  // Decoded on demand from the encoded data
+  mutable QImage mPicture;
+  QByteArray mPictureData;
   QString mPictureFormat;
-  QImage mLogo;
+  mutable QImage mLogo;
+  QByteArray mLogoData;
   QString mLogoFormat;
   QByteArray mSound;
   QString mPictureAttachmentName;
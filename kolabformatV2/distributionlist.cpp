@@ -30,6 +30,7 @@
 */
 
 #include "distributionlist.h"
+#include "xmlwriter.h"
 
 #include <kabc/addressee.h>
 #include <kabc/contactgroup.h>
@@ -51,6 +52,11 @@ DistributionList::DistributionList( const QString& xml )
   load( xml );
 }
 
+DistributionList::DistributionList( const QByteArray& xml )
+{
+  load( xml );
+}
+
 DistributionList::~DistributionList()
 {
 }
@@ -83,15 +89,15 @@ void KolabV2::DistributionList::loadDistrListMember( const QDomElement& element
   mDistrListMembers.append( member );
 }
 
-void DistributionList::saveDistrListMembers( QDomElement& element ) const
+void DistributionList::saveDistrListMembers( XmlWriter& writer ) const
 {
   QList<Member>::ConstIterator it = mDistrListMembers.constBegin();
   for( ; it != mDistrListMembers.constEnd(); ++it ) {
-    QDomElement e = element.ownerDocument().createElement( "member" );
-    element.appendChild( e );
+    writer.writeStartElement( "member" );
     const Member& m = *it;
-    writeString( e, "display-name", m.displayName );
-    writeString( e, "smtp-address", m.email );
+    writeString( writer, "display-name", m.displayName );
+    writeString( writer, "smtp-address", m.email );
+    writer.writeEndElement();
   }
 }
 
@@ -117,16 +123,27 @@ bool DistributionList::loadAttribute( QDomElement& element )
   return KolabBase::loadAttribute( element );
 }
 
-bool DistributionList::saveAttributes( QDomElement& element ) const
+bool DistributionList::saveAttributes( XmlWriter& writer ) const
 {
   // Save the base class elements
-  KolabBase::saveAttributes( element );
-  writeString( element, "display-name", name() );
-  saveDistrListMembers( element );
+  KolabBase::saveAttributes( writer );
+  writeString( writer, "display-name", name() );
+  saveDistrListMembers( writer );
 
   return true;
 }
 
+void DistributionList::loadUnhandledAttribute( QDomElement& element )
+{
+  // Unhandled tag - save for later storage
+  //kDebug() <<"Saving unhandled tag" << element.tagName();
+  Custom c;
+  c.app = s_unhandledTagAppName;
+  c.name = element.tagName();
+  c.value = element.text();
+  mCustomList.append( c );
+}
+
 bool DistributionList::loadXML( const QDomDocument& document )
 {
   QDomElement top = document.documentElement();
@@ -143,15 +160,8 @@ bool DistributionList::loadXML( const QDomDocument& document )
       continue;
     if ( n.isElement() ) {
       QDomElement e = n.toElement();
-      if ( !loadAttribute( e ) ) {
-        // Unhandled tag - save for later storage
-        //kDebug() <<"Saving unhandled tag" << e.tagName();
-        Custom c;
-        c.app = s_unhandledTagAppName;
-        c.name = e.tagName();
-        c.value = e.text();
-        mCustomList.append( c );
-      }
+      if ( !loadAttribute( e ) )
+        loadUnhandledAttribute( e );
     } else
       kDebug() <<"Node is not a comment or an element???";
   }
@@ -159,16 +169,6 @@ bool DistributionList::loadXML( const QDomDocument& document )
   return true;
 }
 
-QString DistributionList::saveXML() const
-{
-  QDomDocument document = domTree();
-  QDomElement element = document.createElement( "distribution-list" );
-  element.setAttribute( "version", "1.0" );
-  saveAttributes( element );
-  document.appendChild( element );
-  return document.toString();
-}
-
 QString DistributionList::productID() const
 {
   // TODO should we get name/version from desktop file?
@@ -44,6 +44,8 @@ class DistributionList : public KolabBase {
 public:
   explicit DistributionList( const KABC::ContactGroup* contactGroup );
   DistributionList( const QString& xml );
+  // loading from the UTF-8 encoded xml, without building a DOM
+  explicit DistributionList( const QByteArray& xml );
   ~DistributionList();
 
   void saveTo( KABC::ContactGroup* contactGroup );
@@ -57,22 +59,22 @@ public:
   bool loadAttribute( QDomElement& );
 
   // Save the attributes of this class
-  bool saveAttributes( QDomElement& ) const;
+  bool saveAttributes( XmlWriter& ) const;
 
   // Load this note by reading the XML file
   bool loadXML( const QDomDocument& xml );
 
-  // Serialize this note to an XML string
-  QString saveXML() const;
-
   QString productID() const;
 
 protected:
   void setFields( const KABC::ContactGroup* );
 
+  QString topTagName() const { return "distribution-list"; }
+  void loadUnhandledAttribute( QDomElement& );
+
 private:
   void loadDistrListMember( const QDomElement& element );
-  void saveDistrListMembers( QDomElement& element ) const;
+  void saveDistrListMembers( XmlWriter& writer ) const;
 
   QString mName;
 
@@ -32,6 +32,7 @@
 */
 
 #include "event.h"
+#include "xmlwriter.h"
 
 #include <kcalcore/event.h>
 #include <kdebug.h>
@@ -48,7 +49,18 @@ KCalCore::Event::Ptr Event::fromXml( const QDomDocument& xmlDoc, const QString&
   return kcalEvent;
 }
 
-QString Event::eventToXML( const KCalCore::Event::Ptr &kcalEvent, const QString& tz  )
+KCalCore::Event::Ptr Event::fromXml( const QByteArray& xml, const QString& tz, QStringList& attachments )
+{
+  Event event( tz );
+  if ( !event.load( xml ) )
+    return KCalCore::Event::Ptr();
+  attachments += event.inlineAttachmentNames();
+  KCalCore::Event::Ptr kcalEvent( new KCalCore::Event() );
+  event.saveTo( kcalEvent );
+  return kcalEvent;
+}
+
+QByteArray Event::eventToXML( const KCalCore::Event::Ptr &kcalEvent, const QString& tz  )
 {
   Event event( tz, kcalEvent );
   return event.saveXML();
@@ -130,21 +142,21 @@ bool Event::loadAttribute( QDomElement& element )
   return true;
 }
 
-bool Event::saveAttributes( QDomElement& element ) const
+bool Event::saveAttributes( XmlWriter& writer ) const
 {
   // Save the base class elements
-  Incidence::saveAttributes( element );
+  Incidence::saveAttributes( writer );
 
   // TODO: Support tentative and outofoffice
   if ( transparency() == KCalCore::Event::Transparent )
-    writeString( element, "show-time-as", "free" );
+    writeString( writer, "show-time-as", "free" );
   else
-    writeString( element, "show-time-as", "busy" );
+    writeString( writer, "show-time-as", "busy" );
   if ( mHasEndDate ) {
     if ( mFloatingStatus == HasTime )
-      writeString( element, "end-date", dateTimeToString( endDate() ) );
+      writeString( writer, "end-date", dateTimeToString( endDate() ) );
     else
-      writeString( element, "end-date", dateToString( endDate().date() ) );
+      writeString( writer, "end-date", dateToString( endDate().date() ) );
   }
 
   return true;
@@ -174,16 +186,6 @@ bool Event::loadXML( const QDomDocument& document )
   return true;
 }
 
-QString Event::saveXML() const
-{
-  QDomDocument document = domTree();
-  QDomElement element = document.createElement( "event" );
-  element.setAttribute( "version", "1.0" );
-  saveAttributes( element );
-  document.appendChild( element );
-  return document.toString();
-}
-
 void Event::setFields( const KCalCore::Event::Ptr &event )
 {
   Incidence::setFields( event );
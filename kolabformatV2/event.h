@@ -55,8 +55,12 @@ public:
   /// The caller is responsible for deleting the returned event
   static KCalCore::Event::Ptr fromXml( const QDomDocument& xmlDoc, const QString& tz);
 
+  /// Use this to parse the raw xml in a single pass, the names of the inline
+  /// attachments are appended to @p attachments. Returns 0 on failure.
+  static KCalCore::Event::Ptr fromXml( const QByteArray& xml, const QString& tz, QStringList& attachments );
+
   /// Use this to get an xml string describing this event entry
-  static QString eventToXML( const KCalCore::Event::Ptr &, const QString& tz );
+  static QByteArray eventToXML( const KCalCore::Event::Ptr &, const QString& tz );
 
   /// Create a event object and
   explicit Event( const QString& tz,
@@ -79,18 +83,17 @@ public:
   virtual bool loadAttribute( QDomElement& );
 
   // Save the attributes of this class
-  virtual bool saveAttributes( QDomElement& ) const;
+  virtual bool saveAttributes( XmlWriter& ) const;
 
   // Load this event by reading the XML file
   virtual bool loadXML( const QDomDocument& xml );
 
-  // Serialize this event to an XML string
-  virtual QString saveXML() const;
-
 protected:
   // Read all known fields from this ical incidence
   void setFields( const KCalCore::Event::Ptr & );
 
+  virtual QString topTagName() const { return "event"; }
+
   KCalCore::Event::Transparency mShowTimeAs;
   KDateTime mEndDate;
   bool mHasEndDate;
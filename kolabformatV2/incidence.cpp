@@ -32,6 +32,7 @@
 */
 
 #include "incidence.h"
+#include "xmlwriter.h"
 #include "libkolab-version.h"
 
 #include <QList>
@@ -196,127 +197,139 @@ bool Incidence::loadAttendeeAttribute( QDomElement& element,
   return true;
 }
 
-void Incidence::saveAttendeeAttribute( QDomElement& element,
+void Incidence::saveAttendeeAttribute( XmlWriter& writer,
                                        const Attendee& attendee ) const
 {
-  QDomElement e = element.ownerDocument().createElement( "attendee" );
-  element.appendChild( e );
-  writeString( e, "display-name", attendee.displayName );
-  writeString( e, "smtp-address", attendee.smtpAddress );
-  writeString( e, "status", attendee.status );
-  writeString( e, "request-response",
+  writer.writeStartElement( "attendee" );
+  writeString( writer, "display-name", attendee.displayName );
+  writeString( writer, "smtp-address", attendee.smtpAddress );
+  writeString( writer, "status", attendee.status );
+  writeString( writer, "request-response",
                ( attendee.requestResponse ? "true" : "false" ) );
-  writeString( e, "invitation-sent",
+  writeString( writer, "invitation-sent",
                ( attendee.invitationSent ? "true" : "false" ) );
-  writeString( e, "role", attendee.role );
-  writeString( e, "delegated-to", attendee.delegate );
-  writeString( e, "delegated-from", attendee.delegator );
+  writeString( writer, "role", attendee.role );
+  writeString( writer, "delegated-to", attendee.delegate );
+  writeString( writer, "delegated-from", attendee.delegator );
+  writer.writeEndElement();
 }
 
-void Incidence::saveAttendees( QDomElement& element ) const
+void Incidence::saveAttendees( XmlWriter& writer ) const
 {
   foreach ( const Attendee& attendee, mAttendees )
-    saveAttendeeAttribute( element, attendee );
+    saveAttendeeAttribute( writer, attendee );
 }
 
-void Incidence::saveAttachments( QDomElement& element ) const
+void Incidence::saveAttachments( XmlWriter& writer ) const
 {
   foreach ( KCalCore::Attachment::Ptr a, mAttachments ) {
     if ( a->isUri() ) {
-      writeString( element, "link-attachment", a->uri() );
+      writeString( writer, "link-attachment", a->uri() );
     } else if ( a->isBinary() ) {
-      writeString( element, "inline-attachment", a->label() );
+      writeString( writer, "inline-attachment", a->label() );
     }
   }
 }
 
-void Incidence::saveAlarms( QDomElement& element ) const
+void Incidence::saveAlarms( XmlWriter& writer ) const
 {
   if ( mAlarms.isEmpty() ) return;
 
-  QDomElement list = element.ownerDocument().createElement( "advanced-alarms" );
-  element.appendChild( list );
+  writer.writeStartElement( "advanced-alarms" );
   foreach ( KCalCore::Alarm::Ptr a, mAlarms ) {
-    QDomElement e = list.ownerDocument().createElement( "alarm" );
-    list.appendChild( e );
+    writer.writeStartElement( "alarm" );
+    // The type attribute has to be written before the children
+    switch ( a->type() ) {
+    case KCalCore::Alarm::Display:
+      writer.writeAttribute( "type", "display" );
+      break;
+    case KCalCore::Alarm::Procedure:
+      writer.writeAttribute( "type", "procedure" );
+      break;
+    case KCalCore::Alarm::Email:
+      writer.writeAttribute( "type", "email" );
+      break;
+    case KCalCore::Alarm::Audio:
+      writer.writeAttribute( "type", "audio" );
+      break;
+    default:
+      break;
+    }
 
-    writeString( e, "enabled", a->enabled() ? "1" : "0" );
+    writeString( writer, "enabled", a->enabled() ? "1" : "0" );
     if ( a->hasStartOffset() ) {
-      writeString( e, "start-offset", QString::number( a->startOffset().asSeconds()/60 ) );
+      writeString( writer, "start-offset", QString::number( a->startOffset().asSeconds()/60 ) );
     }
     if ( a->hasEndOffset() ) {
-      writeString( e, "end-offset", QString::number( a->endOffset().asSeconds()/60 ) );
+      writeString( writer, "end-offset", QString::number( a->endOffset().asSeconds()/60 ) );
     }
     if ( a->repeatCount() ) {
-      writeString( e, "repeat-count", QString::number( a->repeatCount() ) );
-      writeString( e, "repeat-interval", QString::number( a->snoozeTime().asSeconds() ) );
+      writeString( writer, "repeat-count", QString::number( a->repeatCount() ) );
+      writeString( writer, "repeat-interval", QString::number( a->snoozeTime().asSeconds() ) );
     }
 
     switch ( a->type() ) {
     case KCalCore::Alarm::Invalid:
       break;
     case KCalCore::Alarm::Display:
-      e.setAttribute( "type", "display" );
-      writeString( e, "text", a->text() );
+      writeString( writer, "text", a->text() );
       break;
     case KCalCore::Alarm::Procedure:
-      e.setAttribute( "type", "procedure" );
-      writeString( e, "program", a->programFile() );
-      writeString( e, "arguments", a->programArguments() );
+      writeString( writer, "program", a->programFile() );
+      writeString( writer, "arguments", a->programArguments() );
       break;
     case KCalCore::Alarm::Email:
     {
-      e.setAttribute( "type", "email" );
-      QDomElement addresses = e.ownerDocument().createElement( "addresses" );
-      e.appendChild( addresses );
+      writer.writeStartElement( "addresses" );
       foreach ( const KCalCore::Person::Ptr &person, a->mailAddresses() ) {
-        writeString( addresses, "address", person->fullName() );
+        writeString( writer, "address", person->fullName() );
       }
-      writeString( e, "subject", a->mailSubject() );
-      writeString( e, "mail-text", a->mailText() );
-      QDomElement attachments = e.ownerDocument().createElement( "attachments" );
-      e.appendChild( attachments );
+      writer.writeEndElement();
+      writeString( writer, "subject", a->mailSubject() );
+      writeString( writer, "mail-text", a->mailText() );
+      writer.writeStartElement( "attachments" );
       foreach ( const QString &attachment, a->mailAttachments() ) {
-        writeString( attachments, "attachment", attachment );
+        writeString( writer, "attachment", attachment );
       }
+      writer.writeEndElement();
       break;
     }
     case KCalCore::Alarm::Audio:
-      e.setAttribute( "type", "audio" );
-      writeString( e, "file", a->audioFile() );
+      writeString( writer, "file", a->audioFile() );
       break;
     default:
       kWarning() << "Unhandled alarm type:" << a->type();
       break;
     }
+    writer.writeEndElement();
   }
+  writer.writeEndElement();
 }
 
-void Incidence::saveRecurrence( QDomElement& element ) const
+void Incidence::saveRecurrence( XmlWriter& writer ) const
 {
-  QDomElement e = element.ownerDocument().createElement( "recurrence" );
-  element.appendChild( e );
-  e.setAttribute( "cycle", mRecurrence.cycle );
+  writer.writeStartElement( "recurrence" );
+  writer.writeAttribute( "cycle", mRecurrence.cycle );
   if ( !mRecurrence.type.isEmpty() )
-    e.setAttribute( "type", mRecurrence.type );
-  writeString( e, "interval", QString::number( mRecurrence.interval ) );
+    writer.writeAttribute( "type", mRecurrence.type );
+  writeString( writer, "interval", QString::number( mRecurrence.interval ) );
   foreach ( const QString& recurrence, mRecurrence.days ) {
-    writeString( e, "day", recurrence );
+    writeString( writer, "day", recurrence );
   }
   if ( !mRecurrence.dayNumber.isEmpty() )
-    writeString( e, "daynumber", mRecurrence.dayNumber );
+    writeString( writer, "daynumber", mRecurrence.dayNumber );
   if ( !mRecurrence.month.isEmpty() )
-    writeString( e, "month", mRecurrence.month );
+    writeString( writer, "month", mRecurrence.month );
   if ( !mRecurrence.rangeType.isEmpty() ) {
-    QDomElement range = element.ownerDocument().createElement( "range" );
-    e.appendChild( range );
-    range.setAttribute( "type", mRecurrence.rangeType );
-    QDomText t = element.ownerDocument().createTextNode( mRecurrence.range );
-    range.appendChild( t );
+    writer.writeStartElement( "range" );
+    writer.writeAttribute( "type", mRecurrence.rangeType );
+    writer.writeCharacters( mRecurrence.range );
+    writer.writeEndElement();
   }
   foreach ( const QDate& date, mRecurrence.exclusions ) {
-    writeString( e, "exclusion", dateToString( date ) );
+    writeString( writer, "exclusion", dateToString( date ) );
   }
+  writer.writeEndElement();
 }
 
 void Incidence::loadRecurrence( const QDomElement& element )
@@ -505,8 +518,6 @@ bool Incidence::loadAttribute( QDomElement& element )
     setInternalUID( element.text() );
   else if ( tagName == "x-custom" ) {
     loadCustomAttributes( element );
-  } else if ( tagName == "inline-attachment"  ) {
-    // we handle that separately later on, so no need to create a KolabUnhandled entry for it
   } else {
     bool ok = KolabBase::loadAttribute( element );
     if ( !ok ) {
@@ -522,47 +533,50 @@ bool Incidence::loadAttribute( QDomElement& element )
   return true;
 }
 
-bool Incidence::saveAttributes( QDomElement& element ) const
+bool Incidence::saveAttributes( XmlWriter& writer ) const
 {
   // Save the base class elements
-  KolabBase::saveAttributes( element );
-
-  if ( mFloatingStatus == HasTime )
-    writeString( element, "start-date", dateTimeToString( startDate() ) );
-  else
-    writeString( element, "start-date", dateToString( startDate().date() ) );
-  writeString( element, "summary", summary() );
-  writeString( element, "location", location() );
-  saveEmailAttribute( element, organizer(), "organizer" );
+  KolabBase::saveAttributes( writer );
+
+  // Events and journals always have a start date, but tasks don't
+  if ( hasStartDate() || !startDate().isValid() ) {
+    if ( mFloatingStatus == HasTime )
+      writeString( writer, "start-date", dateTimeToString( startDate() ) );
+    else
+      writeString( writer, "start-date", dateToString( startDate().date() ) );
+  }
+  writeString( writer, "summary", summary() );
+  writeString( writer, "location", location() );
+  saveEmailAttribute( writer, organizer(), "organizer" );
   if ( !mRecurrence.cycle.isEmpty() )
-    saveRecurrence( element );
-  saveAttendees( element );
-  saveAttachments( element );
+    saveRecurrence( writer );
+  saveAttendees( writer );
+  saveAttachments( writer );
   if ( mHasAlarm ) {
     // Alarms should be minutes before. Libkcal uses event time + alarm time
     int alarmTime = qRound( -alarm() );
-    writeString( element, "alarm", QString::number( alarmTime ) );
+    writeString( writer, "alarm", QString::number( alarmTime ) );
   }
-  saveAlarms( element );
-  writeString( element, "x-kde-internaluid", internalUID() );
-  saveCustomAttributes( element );
+  saveAlarms( writer );
+  writeString( writer, "x-kde-internaluid", internalUID() );
+  saveCustomAttributes( writer );
   return true;
 }
 
-void Incidence::saveCustomAttributes( QDomElement& element ) const
+void Incidence::saveCustomAttributes( XmlWriter& writer ) const
 {
   foreach ( const Custom& custom, mCustomList ) {
     QString key( custom.key );
     Q_ASSERT( !key.isEmpty() );
     if ( key.startsWith( QLatin1String( "X-KDE-KolabUnhandled-" ) ) ) {
       key = key.mid( strlen( "X-KDE-KolabUnhandled-" ) );
-      writeString( element, key, custom.value );
+      writeString( writer, key, custom.value );
     } else {
       // Let's use attributes so that other tag-preserving-code doesn't need sub-elements
-      QDomElement e = element.ownerDocument().createElement( "x-custom" );
-      element.appendChild( e );
-      e.setAttribute( "key", key );
-      e.setAttribute( "value", custom.value );
+      writer.writeStartElement( "x-custom" );
+      writer.writeAttribute( "key", key );
+      writer.writeAttribute( "value", custom.value );
+      writer.writeEndElement();
     }
   }
 }
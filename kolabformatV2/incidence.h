@@ -116,7 +116,10 @@ public:
   virtual bool loadAttribute( QDomElement& );
 
   // Save the attributes of this class
-  virtual bool saveAttributes( QDomElement& ) const;
+  virtual bool saveAttributes( XmlWriter& ) const;
+
+  // Whether the start date is saved, events always have one
+  virtual bool hasStartDate() const { return true; }
 
 protected:
   enum FloatingStatus { Unset, AllDay, HasTime };
@@ -125,17 +128,17 @@ protected:
   void setFields( const KCalCore::Incidence::Ptr & );
 
   bool loadAttendeeAttribute( QDomElement&, Attendee& );
-  void saveAttendeeAttribute( QDomElement& element,
+  void saveAttendeeAttribute( XmlWriter& writer,
                               const Attendee& attendee ) const;
-  void saveAttendees( QDomElement& element ) const;
-  void saveAttachments( QDomElement& element ) const;
+  void saveAttendees( XmlWriter& writer ) const;
+  void saveAttachments( XmlWriter& writer ) const;
 
   void loadAlarms( const QDomElement& element );
-  void saveAlarms( QDomElement& element ) const;
+  void saveAlarms( XmlWriter& writer ) const;
 
   void loadRecurrence( const QDomElement& element );
-  void saveRecurrence( QDomElement& element ) const;
-  void saveCustomAttributes( QDomElement& element ) const;
+  void saveRecurrence( XmlWriter& writer ) const;
+  void saveCustomAttributes( XmlWriter& writer ) const;
   void loadCustomAttributes( QDomElement& element );
 
   QString productID() const;
@@ -32,6 +32,7 @@
 */
 
 #include "journal.h"
+#include "xmlwriter.h"
 #include "libkolab-version.h"
 
 #include <kdebug.h>
@@ -48,7 +49,18 @@ KCalCore::Journal::Ptr Journal::fromXml( const QDomDocument& xmlDoc, const QStri
   return kcalJournal;
 }
 
-QString Journal::journalToXML( const KCalCore::Journal::Ptr &kcalJournal, const QString& tz )
+KCalCore::Journal::Ptr Journal::fromXml( const QByteArray& xml, const QString& tz, QStringList& attachments )
+{
+  Journal journal( tz );
+  if ( !journal.load( xml ) )
+    return KCalCore::Journal::Ptr();
+  attachments += journal.inlineAttachmentNames();
+  KCalCore::Journal::Ptr kcalJournal( new KCalCore::Journal() );
+  journal.saveTo( kcalJournal );
+  return kcalJournal;
+}
+
+QByteArray Journal::journalToXML( const KCalCore::Journal::Ptr &kcalJournal, const QString& tz )
 {
   Journal journal( tz, kcalJournal );
   return journal.saveXML();
@@ -112,13 +124,13 @@ bool Journal::loadAttribute( QDomElement& element )
   return true;
 }
 
-bool Journal::saveAttributes( QDomElement& element ) const
+bool Journal::saveAttributes( XmlWriter& writer ) const
 {
   // Save the base class elements
-  KolabBase::saveAttributes( element );
+  KolabBase::saveAttributes( writer );
 
-  writeString( element, "summary", summary() );
-  writeString( element, "start-date", dateTimeToString( startDate() ) );
+  writeString( writer, "summary", summary() );
+  writeString( writer, "start-date", dateTimeToString( startDate() ) );
 
   return true;
 }
@@ -150,16 +162,6 @@ bool Journal::loadXML( const QDomDocument& document )
   return true;
 }
 
-QString Journal::saveXML() const
-{
-  QDomDocument document = domTree();
-  QDomElement element = document.createElement( "journal" );
-  element.setAttribute( "version", "1.0" );
-  saveAttributes( element );
-  document.appendChild( element );
-  return document.toString();
-}
-
 void Journal::saveTo( const KCalCore::Journal::Ptr &journal )
 {
   KolabBase::saveTo( journal );
@@ -54,8 +54,12 @@ public:
   /// The caller is responsible for deleting the returned journal
   static KCalCore::Journal::Ptr fromXml( const QDomDocument& xmlDoc, const QString& tz );
 
+  /// Use this to parse the raw xml in a single pass, the names of the inline
+  /// attachments are appended to @p attachments. Returns 0 on failure.
+  static KCalCore::Journal::Ptr fromXml( const QByteArray& xml, const QString& tz, QStringList& attachments );
+
   /// Use this to get an xml string describing this journal entry
-  static QString journalToXML( const KCalCore::Journal::Ptr &, const QString& tz );
+  static QByteArray journalToXML( const KCalCore::Journal::Ptr &, const QString& tz );
 
   explicit Journal( const QString& tz, const KCalCore::Journal::Ptr &journal = KCalCore::Journal::Ptr() );
   virtual ~Journal();
@@ -77,19 +81,17 @@ public:
   virtual bool loadAttribute( QDomElement& );
 
   // Save the attributes of this class
-  virtual bool saveAttributes( QDomElement& ) const;
+  virtual bool saveAttributes( XmlWriter& ) const;
 
   // Load this journal by reading the XML file
   virtual bool loadXML( const QDomDocument& xml );
 
-  // Serialize this journal to an XML string
-  virtual QString saveXML() const;
-
 protected:
   // Read all known fields from this ical journal
   void setFields( const KCalCore::Journal::Ptr & );
 
   QString productID() const;
+  virtual QString topTagName() const { return "journal"; }
 
   QString mSummary;
   KDateTime mStartDate;
@@ -32,6 +32,8 @@
 */
 
 #include "kolabbase.h"
+#include "xmlwriter.h"
+#include "kolabformat/errorhandler.h"
 
 #include <kabc/addressee.h>
 #include <kabc/contactgroup.h>
@@ -40,6 +42,8 @@
 #include <ksystemtimezone.h>
 #include <kdebug.h>
 
+#include <QXmlStreamReader>
+
 using namespace KolabV2;
 
 KolabBase::KolabBase( const QString& tz )
@@ -285,6 +289,11 @@ int KolabBase::pilotSyncStatus() const
   return mPilotSyncStatus;
 }
 
+QStringList KolabBase::inlineAttachmentNames() const
+{
+  return mInlineAttachmentNames;
+}
+
 bool KolabBase::loadEmailAttribute( QDomElement& element, Email& email )
 {
   for ( QDomNode n = element.firstChild(); !n.isNull(); n = n.nextSibling() ) {
@@ -308,13 +317,13 @@ bool KolabBase::loadEmailAttribute( QDomElement& element, Email& email )
   return true;
 }
 
-void KolabBase::saveEmailAttribute( QDomElement& element, const Email& email,
+void KolabBase::saveEmailAttribute( XmlWriter& writer, const Email& email,
                                     const QString& tagName ) const
 {
-  QDomElement e = element.ownerDocument().createElement( tagName );
-  element.appendChild( e );
-  writeString( e, "display-name", email.displayName );
-  writeString( e, "smtp-address", email.smtpAddress );
+  writer.writeStartElement( tagName );
+  writeString( writer, "display-name", email.displayName );
+  writeString( writer, "smtp-address", email.smtpAddress );
+  writer.writeEndElement();
 }
 
 bool KolabBase::loadAttribute( QDomElement& element )
@@ -355,6 +364,13 @@ bool KolabBase::loadAttribute( QDomElement& element )
       return true;
     }
     break;
+  case 'i':
+    if ( tagName == "inline-attachment" ) {
+      // The attachment part is read separately later on, so no need to create a KolabUnhandled entry for it
+      mInlineAttachmentNames.append( element.text() );
+      return true;
+    }
+    break;
   case 'p':
     if ( tagName == "product-id" )
       return true; // ignore this field
@@ -373,19 +389,19 @@ bool KolabBase::loadAttribute( QDomElement& element )
   return false;
 }
 
-bool KolabBase::saveAttributes( QDomElement& element ) const
+bool KolabBase::saveAttributes( XmlWriter& writer ) const
 {
-  writeString( element, "product-id", productID() );
-  writeString( element, "uid", uid() );
-  writeString( element, "body", body() );
-  writeString( element, "categories", categories() );
-  writeString( element, "creation-date", dateTimeToString( creationDate().toUtc() ) );
-  writeString( element, "last-modification-date", dateTimeToString( lastModified().toUtc() ) );
-  writeString( element, "sensitivity", sensitivityToString( sensitivity() ) );
+  writeString( writer, "product-id", productID() );
+  writeString( writer, "uid", uid() );
+  writeString( writer, "body", body() );
+  writeString( writer, "categories", categories() );
+  writeString( writer, "creation-date", dateTimeToString( creationDate().toUtc() ) );
+  writeString( writer, "last-modification-date", dateTimeToString( lastModified().toUtc() ) );
+  writeString( writer, "sensitivity", sensitivityToString( sensitivity() ) );
   if ( hasPilotSyncId() )
-    writeString( element, "pilot-sync-id", QString::number( pilotSyncId() ) );
+    writeString( writer, "pilot-sync-id", QString::number( pilotSyncId() ) );
   if ( hasPilotSyncStatus() )
-    writeString( element, "pilot-sync-status", QString::number( pilotSyncStatus() ) );
+    writeString( writer, "pilot-sync-status", QString::number( pilotSyncStatus() ) );
   return true;
 }
 
@@ -413,14 +429,95 @@ QDomDocument KolabBase::loadDocument( const QString& xmlData )
   return document;
 }
 
-QDomDocument KolabBase::domTree()
+// Reads the element at the current position of the reader, including its children
+static QDomElement readElement( QXmlStreamReader& reader, QDomDocument& document )
+{
+  QDomElement element = document.createElement( reader.name().toString() );
+  foreach ( const QXmlStreamAttribute& attribute, reader.attributes() )
+    element.setAttribute( attribute.name().toString(), attribute.value().toString() );
+
+  while ( !reader.atEnd() ) {
+    switch ( reader.readNext() ) {
+    case QXmlStreamReader::StartElement:
+      element.appendChild( readElement( reader, document ) );
+      break;
+    case QXmlStreamReader::Characters:
+      // Like QDomDocument::setContent(), drop whitespace-only text
+      if ( reader.isCDATA() )
+        element.appendChild( document.createCDATASection( reader.text().toString() ) );
+      else if ( !reader.isWhitespace() )
+        element.appendChild( document.createTextNode( reader.text().toString() ) );
+      break;
+    case QXmlStreamReader::EndElement:
+      return element;
+    default:
+      break;
+    }
+  }
+  return element;
+}
+
+bool KolabBase::load( const QByteArray& xml )
 {
+  QXmlStreamReader reader( xml );
+  if ( !reader.readNextStartElement() ) {
+    qWarning( "Error loading document: %s, line %d, column %d", qPrintable( reader.errorString() ),
+              static_cast<int>( reader.lineNumber() ), static_cast<int>( reader.columnNumber() ) );
+    return false;
+  }
+  if ( reader.name() != topTagName() ) {
+    qWarning( "XML error: Top tag was %s instead of the expected %s",
+              reader.name().toString().toAscii().data(), topTagName().toAscii().data() );
+    return false;
+  }
+
+  startLoading();
+  // The elements are created detached from the document and freed after
+  // loading, so only one attribute is in memory at a time
   QDomDocument document;
+  while ( reader.readNextStartElement() ) {
+    QDomElement e = readElement( reader, document );
+    if ( !loadAttribute( e ) )
+      loadUnhandledAttribute( e );
+  }
+  // Like loadDocument(), reject documents which aren't well-formed
+  while ( !reader.atEnd() )
+    reader.readNext();
+  if ( reader.hasError() ) {
+    qWarning( "Error loading document: %s, line %d, column %d", qPrintable( reader.errorString() ),
+              static_cast<int>( reader.lineNumber() ), static_cast<int>( reader.columnNumber() ) );
+    return false;
+  }
+  finishLoading();
+  return true;
+}
 
-  QString p = "version=\"1.0\" encoding=\"UTF-8\"";
-  document.appendChild(document.createProcessingInstruction( "xml", p ) );
+void KolabBase::startLoading()
+{
+}
 
-  return document;
+void KolabBase::finishLoading()
+{
+}
+
+void KolabBase::loadUnhandledAttribute( QDomElement& element )
+{
+  Debug() << "Unhandled tag" << element.tagName();
+}
+
+QByteArray KolabBase::saveXML() const
+{
+  XmlWriter writer;
+  saveXML( writer );
+  return writer.data();
+}
+
+void KolabBase::saveXML( XmlWriter& writer ) const
+{
+  writer.writeStartElement( topTagName() );
+  writer.writeAttribute( "version", "1.0" );
+  saveAttributes( writer );
+  writer.writeEndElement();
 }
 
 
@@ -476,15 +573,11 @@ QColor KolabBase::stringToColor( const QString& s )
   return QColor( s );
 }
 
-void KolabBase::writeString( QDomElement& element, const QString& tag,
+void KolabBase::writeString( XmlWriter& writer, const QString& tag,
                              const QString& tagString )
 {
-  if ( !tagString.isEmpty() ) {
-    QDomElement e = element.ownerDocument().createElement( tag );
-    QDomText t = element.ownerDocument().createTextNode( tagString );
-    e.appendChild( t );
-    element.appendChild( e );
-  }
+  if ( !tagString.isEmpty() )
+    writer.writeTextElement( tag, tagString );
 }
 
 KDateTime KolabBase::localToUTC( const KDateTime& time ) const
@@ -50,6 +50,8 @@ namespace KABC {
 
 namespace KolabV2 {
 
+class XmlWriter;
+
 class KolabBase {
 public:
   struct Email {
@@ -98,6 +100,10 @@ public:
   virtual bool hasPilotSyncStatus() const;
   virtual int pilotSyncStatus() const;
 
+  // The names of the attachments stored in separate parts of the message,
+  // recorded while loading
+  QStringList inlineAttachmentNames() const;
+
   // String - Date conversion methods
   static QString dateTimeToString( const KDateTime& time );
   static QString dateToString( const QDate& date );
@@ -116,11 +122,18 @@ public:
   bool load( const QString& xml );
   static QDomDocument loadDocument( const QString& xmlData );
 
+  // Load this object from the UTF-8 encoded XML in a single pass, without
+  // building a DOM of the whole document. Each child element of the top
+  // element is handed to loadAttribute() on its own.
+  bool load( const QByteArray& xml );
+
   // Load this QDomDocument
   virtual bool loadXML( const QDomDocument& xml ) = 0;
 
-  // Serialize this object to an XML string
-  virtual QString saveXML() const = 0;
+  // Serialize this object to UTF-8 encoded XML, in a single pass without a DOM
+  QByteArray saveXML() const;
+  // Serialize this object with @p writer
+  void saveXML( XmlWriter& writer ) const;
 
 protected:
   /// Read all known fields from this ical incidence
@@ -141,25 +154,32 @@ protected:
   /// Save all known fields into this contact groupd
   void saveTo( KABC::ContactGroup* ) const;
 
-  // This just makes the initial dom tree with version and doctype
-  static QDomDocument domTree();
-
   bool loadEmailAttribute( QDomElement& element, Email& email );
 
-  void saveEmailAttribute( QDomElement& element, const Email& email,
+  void saveEmailAttribute( XmlWriter& writer, const Email& email,
                            const QString& tagName = "email" ) const;
 
   // Load the attributes of this class
   virtual bool loadAttribute( QDomElement& );
 
+  // The tag name of the top element
+  virtual QString topTagName() const = 0;
+
+  // Called before and after the attributes are loaded
+  virtual void startLoading();
+  virtual void finishLoading();
+
+  // Called for the elements loadAttribute() didn't handle
+  virtual void loadUnhandledAttribute( QDomElement& );
+
   // Save the attributes of this class
-  virtual bool saveAttributes( QDomElement& ) const;
+  virtual bool saveAttributes( XmlWriter& ) const;
 
   // Return the product ID
   virtual QString productID() const = 0;
 
   // Write a string tag
-  static void writeString( QDomElement&, const QString&, const QString& );
+  static void writeString( XmlWriter&, const QString&, const QString& );
 
   KDateTime localToUTC( const KDateTime& time ) const;
   KDateTime utcToLocal( const KDateTime& time ) const;
@@ -176,6 +196,8 @@ protected:
   bool mHasPilotSyncId,  mHasPilotSyncStatus;
   unsigned long mPilotSyncId;
   int mPilotSyncStatus;
+
+  QStringList mInlineAttachmentNames;
 };
 
 }
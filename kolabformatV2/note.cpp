@@ -32,6 +32,7 @@
 */
 
 #include "note.h"
+#include "xmlwriter.h"
 #include "libkolab-version.h"
 
 #include <kcalcore/journal.h>
@@ -49,7 +50,7 @@ KCalCore::Journal::Ptr Note::xmlToJournal( const QString& xml )
   return journal;
 }
 
-QString Note::journalToXML( const KCalCore::Journal::Ptr &journal )
+QByteArray Note::journalToXML( const KCalCore::Journal::Ptr &journal )
 {
   Note note( journal );
   return note.saveXML();
@@ -123,23 +124,17 @@ bool Note::loadAttribute( QDomElement& element )
   return true;
 }
 
-bool Note::saveAttributes( QDomElement& element ) const
+bool Note::saveAttributes( XmlWriter& writer ) const
 {
   // Save the base class elements
-  KolabBase::saveAttributes( element );
+  KolabBase::saveAttributes( writer );
 
-  // Save the elements
-#if 0
-  QDomComment c = element.ownerDocument().createComment( "Note specific attributes" );
-  element.appendChild( c );
-#endif
-
-  writeString( element, "summary", summary() );
+  writeString( writer, "summary", summary() );
   if ( foregroundColor().isValid() )
-    writeString( element, "foreground-color", colorToString( foregroundColor() ) );
+    writeString( writer, "foreground-color", colorToString( foregroundColor() ) );
   if ( backgroundColor().isValid() )
-    writeString( element, "background-color", colorToString( backgroundColor() ) );
-  writeString( element, "knotes-richtext", mRichText ? "true" : "false" );
+    writeString( writer, "background-color", colorToString( backgroundColor() ) );
+  writeString( writer, "knotes-richtext", mRichText ? "true" : "false" );
 
   return true;
 }
@@ -170,16 +165,6 @@ bool Note::loadXML( const QDomDocument& document )
   return true;
 }
 
-QString Note::saveXML() const
-{
-  QDomDocument document = domTree();
-  QDomElement element = document.createElement( "note" );
-  element.setAttribute( "version", "1.0" );
-  saveAttributes( element );
-  document.appendChild( element );
-  return document.toString();
-}
-
 void Note::setFields( const KCalCore::Journal::Ptr &journal )
 {
   KolabBase::setFields( journal );
@@ -55,7 +55,7 @@ public:
     static KCalCore::Journal::Ptr xmlToJournal( const QString& xml );
 
   /// Use this to get an xml string describing this journal entry
-    static QString journalToXML( const KCalCore::Journal::Ptr & );
+    static QByteArray journalToXML( const KCalCore::Journal::Ptr & );
 
   /// Create a note object and
   explicit Note( const KCalCore::Journal::Ptr &journal = KCalCore::Journal::Ptr() );
@@ -81,14 +81,11 @@ public:
   virtual bool loadAttribute( QDomElement& );
 
   // Save the attributes of this class
-  virtual bool saveAttributes( QDomElement& ) const;
+  virtual bool saveAttributes( XmlWriter& ) const;
 
   // Load this note by reading the XML file
   virtual bool loadXML( const QDomDocument& xml );
 
-  // Serialize this note to an XML string
-  virtual QString saveXML() const;
-
 protected:
   // Read all known fields from this ical incidence
   void setFields( const KCalCore::Journal::Ptr & );
@@ -97,6 +94,7 @@ protected:
   void saveTo( const KCalCore::Incidence::Ptr & ) const;
 
   QString productID() const;
+  virtual QString topTagName() const { return "note"; }
 
   QString mSummary;
   QColor mBackgroundColor;
@@ -32,6 +32,7 @@
 */
 
 #include "task.h"
+#include "xmlwriter.h"
 
 #include <kcalcore/todo.h>
 #include <kdebug.h>
@@ -83,7 +84,18 @@ KCalCore::Todo::Ptr Task::fromXml( const QDomDocument& xmlDoc, const QString& tz
   return todo;
 }
 
-QString Task::taskToXML( const KCalCore::Todo::Ptr &todo, const QString& tz )
+KCalCore::Todo::Ptr Task::fromXml( const QByteArray& xml, const QString& tz, QStringList& attachments )
+{
+  Task task( tz );
+  if ( !task.load( xml ) )
+    return KCalCore::Todo::Ptr();
+  attachments += task.inlineAttachmentNames();
+  KCalCore::Todo::Ptr todo(  new KCalCore::Todo() );
+  task.saveTo( todo );
+  return todo;
+}
+
+QByteArray Task::taskToXML( const KCalCore::Todo::Ptr &todo, const QString& tz )
 {
   Task task( tz, todo );
   return task.saveXML();
@@ -258,33 +270,33 @@ bool Task::loadAttribute( QDomElement& element )
   return true;
 }
 
-bool Task::saveAttributes( QDomElement& element ) const
+bool Task::saveAttributes( XmlWriter& writer ) const
 {
   // Save the base class elements
-  Incidence::saveAttributes( element );
+  Incidence::saveAttributes( writer );
 
   // We need to save x-kcal-priority as well, since the Kolab priority can only save values from
   // 1 to 5, but we have values from 0 to 9, and do not want to loose them
-  writeString( element, "priority", QString::number( kcalPriorityToKolab( priority() ) ) );
-  writeString( element, "x-kcal-priority", QString::number( priority() ) );
+  writeString( writer, "priority", QString::number( kcalPriorityToKolab( priority() ) ) );
+  writeString( writer, "x-kcal-priority", QString::number( priority() ) );
 
-  writeString( element, "completed", QString::number( percentCompleted() ) );
+  writeString( writer, "completed", QString::number( percentCompleted() ) );
 
   switch( status() ) {
   case KCalCore::Incidence::StatusInProcess:
-    writeString( element, "status", "in-progress" );
+    writeString( writer, "status", "in-progress" );
     break;
   case KCalCore::Incidence::StatusCompleted:
-    writeString( element, "status", "completed" );
+    writeString( writer, "status", "completed" );
     break;
   case KCalCore::Incidence::StatusNeedsAction:
-    writeString( element, "status", "waiting-on-someone-else" );
+    writeString( writer, "status", "waiting-on-someone-else" );
     break;
   case KCalCore::Incidence::StatusCanceled:
-    writeString( element, "status", "deferred" );
+    writeString( writer, "status", "deferred" );
     break;
   case KCalCore::Incidence::StatusNone:
-    writeString( element, "status", "not-started" );
+    writeString( writer, "status", "not-started" );
     break;
   case KCalCore::Incidence::StatusTentative:
   case KCalCore::Incidence::StatusConfirmed:
@@ -292,35 +304,44 @@ bool Task::saveAttributes( QDomElement& element ) const
   case KCalCore::Incidence::StatusFinal:
   case KCalCore::Incidence::StatusX:
     // All of these are saved as StatusNone.
-    writeString( element, "status", "not-started" );
+    writeString( writer, "status", "not-started" );
     break;
   }
 
   if ( hasDueDate() ) {
     if ( mFloatingStatus == HasTime ) {
-      writeString( element, "due-date", dateTimeToString( dueDate() ) );
+      writeString( writer, "due-date", dateTimeToString( dueDate() ) );
     } else {
-      writeString( element, "due-date", dateToString( dueDate().date() ) );
+      writeString( writer, "due-date", dateToString( dueDate().date() ) );
     }
   }
 
   if ( !parent().isNull() ) {
-    writeString( element, "parent", parent() );
+    writeString( writer, "parent", parent() );
   }
 
   if ( hasCompletedDate() && percentCompleted() == 100 ) {
-    writeString( element, "x-completed-date", dateTimeToString( completedDate() ) );
+    writeString( writer, "x-completed-date", dateTimeToString( completedDate() ) );
   }
 
   return true;
 }
 
 
-bool Task::loadXML( const QDomDocument& document )
+void Task::startLoading()
 {
   mKolabPriorityFromDom = -1;
   mKCalPriorityFromDom = -1;
+  setHasStartDate( false ); // todo's don't necessarily have one
+}
+
+void Task::finishLoading()
+{
+  decideAndSetPriority();
+}
 
+bool Task::loadXML( const QDomDocument& document )
+{
   QDomElement top = document.documentElement();
 
   if ( top.tagName() != "task" ) {
@@ -328,7 +349,7 @@ bool Task::loadXML( const QDomDocument& document )
               top.tagName().toAscii().data() );
     return false;
   }
-  setHasStartDate( false ); // todo's don't necessarily have one
+  startLoading();
 
   for ( QDomNode n = top.firstChild(); !n.isNull(); n = n.nextSibling() ) {
     if ( n.isComment() )
@@ -342,28 +363,10 @@ bool Task::loadXML( const QDomDocument& document )
       kDebug() <<"Node is not a comment or an element???";
   }
 
-  decideAndSetPriority();
+  finishLoading();
   return true;
 }
 
-QString Task::saveXML() const
-{
-  QDomDocument document = domTree();
-  QDomElement element = document.createElement( "task" );
-  element.setAttribute( "version", "1.0" );
-  saveAttributes( element );
-  if ( !hasStartDate() && startDate().isValid() ) {
-    // events and journals always have a start date, but tasks don't.
-    // Remove the entry done by the inherited save above, because we
-    // don't have one.
-    QDomNodeList l = element.elementsByTagName( "start-date" );
-    Q_ASSERT( l.count() == 1 );
-    element.removeChild( l.item( 0 ) );
-  }
-  document.appendChild( element );
-  return document.toString();
-}
-
 void Task::setFields( const KCalCore::Todo::Ptr &task )
 {
   Incidence::setFields( task );
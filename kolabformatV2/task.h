@@ -60,8 +60,12 @@ public:
   static KCalCore::Todo::Ptr fromXml( const QDomDocument& xmlDoc, const QString& tz/*, KCalCore::ResourceKolab *res = 0,
                                 const QString& subResource = QString(), quint32 sernum = 0 */);
 
+  /// Use this to parse the raw xml in a single pass, the names of the inline
+  /// attachments are appended to @p attachments. Returns 0 on failure.
+  static KCalCore::Todo::Ptr fromXml( const QByteArray& xml, const QString& tz, QStringList& attachments );
+
   /// Use this to get an xml string describing this task entry
-  static QString taskToXML( const KCalCore::Todo::Ptr &, const QString& tz );
+  static QByteArray taskToXML( const KCalCore::Todo::Ptr &, const QString& tz );
 
   explicit Task( /*KCalCore::ResourceKolab *res, const QString& subResource, quint32 sernum,*/
     const QString& tz, const KCalCore::Todo::Ptr &todo = KCalCore::Todo::Ptr() );
@@ -100,14 +104,11 @@ public:
   virtual bool loadAttribute( QDomElement& );
 
   // Save the attributes of this class
-  virtual bool saveAttributes( QDomElement& ) const;
+  virtual bool saveAttributes( XmlWriter& ) const;
 
   // Load this task by reading the XML file
   virtual bool loadXML( const QDomDocument& xml );
 
-  // Serialize this task to an XML string
-  virtual QString saveXML() const;
-
 protected:
   // Read all known fields from this ical todo
   void setFields( const KCalCore::Todo::Ptr & );
@@ -116,6 +117,10 @@ protected:
   // mKCalPriorityFromDom.
   void decideAndSetPriority();
 
+  virtual QString topTagName() const { return "task"; }
+  virtual void startLoading();
+  virtual void finishLoading();
+
   // This is the KCal priority, not the Kolab priority.
   // See kcalPriorityToKolab() and kolabPrioritytoKCal().
   int mPriority;
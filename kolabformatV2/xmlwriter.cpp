@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "xmlwriter.h"
+
+using namespace KolabV2;
+
+// QDom escapes text nodes and attribute values differently
+enum EscapeMode { TextMode, AttributeMode };
+
+// Whether @p c needs escaping like QDom escapes it in @p mode. '>' only
+// needs escaping after "]]", which is checked while escaping.
+static inline bool needsEscaping( ushort c, EscapeMode mode )
+{
+  switch ( c ) {
+  case '<':
+  case '&':
+  case '>':
+  case '\r':
+    return true;
+  case '"':
+  case '\n':
+  case '\t':
+    return mode == AttributeMode;
+  default:
+    return false;
+  }
+}
+
+static void appendEscaped( QByteArray& data, const QString& str, EscapeMode mode )
+{
+  const int size = str.size();
+  const QChar* chars = str.constData();
+  int i = 0;
+  while ( i < size && !needsEscaping( chars[i].unicode(), mode ) )
+    ++i;
+  if ( i == size ) {
+    data += str.toUtf8();
+    return;
+  }
+
+  QString escaped;
+  escaped.reserve( size + 16 );
+  for ( i = 0; i < size; ++i ) {
+    const QChar c = chars[i];
+    if ( !needsEscaping( c.unicode(), mode ) )
+      escaped += c;
+    else if ( c == QLatin1Char( '<' ) )
+      escaped += QLatin1String( "&lt;" );
+    else if ( c == QLatin1Char( '&' ) )
+      escaped += QLatin1String( "&amp;" );
+    else if ( c == QLatin1Char( '>' ) )
+      escaped += escaped.endsWith( QLatin1String( "]]" ) ) ? QLatin1String( "&gt;" ) : QLatin1String( ">" );
+    else if ( c == QLatin1Char( '"' ) )
+      escaped += QLatin1String( "&quot;" );
+    else
+      // Line breaks and tabs, as character references in lower case hex like QDom writes them
+      escaped += QLatin1String( "&#x" ) + QString::number( c.unicode(), 16 ) + QLatin1Char( ';' );
+  }
+  data += escaped.toUtf8();
+}
+
+XmlWriter::XmlWriter()
+  : mData( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" ),
+    mStartTagOpen( false )
+{
+}
+
+XmlWriter::~XmlWriter()
+{
+}
+
+void XmlWriter::writeStartElement( const QString& tag )
+{
+  if ( mStartTagOpen ) {
+    mData += ">\n";
+    mStartTagOpen = false;
+  }
+  mData += QByteArray( mElements.size(), ' ' );
+  mData += '<';
+  mData += tag.toUtf8();
+  Element element;
+  element.tag = tag;
+  element.hasText = false;
+  mElements.append( element );
+  mStartTagOpen = true;
+}
+
+void XmlWriter::writeAttribute( const QString& name, const QString& value )
+{
+  Q_ASSERT( mStartTagOpen );
+  mData += ' ';
+  mData += name.toUtf8();
+  mData += "=\"";
+  appendEscaped( mData, value, AttributeMode );
+  mData += '"';
+}
+
+void XmlWriter::writeCharacters( const QString& text )
+{
+  Q_ASSERT( !mElements.isEmpty() );
+  if ( mStartTagOpen ) {
+    mData += '>';
+    mStartTagOpen = false;
+  }
+  mElements.last().hasText = true;
+  appendEscaped( mData, text, TextMode );
+}
+
+void XmlWriter::writeEndElement()
+{
+  Q_ASSERT( !mElements.isEmpty() );
+  const Element element = mElements.takeLast();
+  if ( mStartTagOpen ) {
+    mData += "/>\n";
+    mStartTagOpen = false;
+    return;
+  }
+  if ( !element.hasText )
+    mData += QByteArray( mElements.size(), ' ' );
+  mData += "</";
+  mData += element.tag.toUtf8();
+  mData += ">\n";
+}
+
+void XmlWriter::writeTextElement( const QString& tag, const QString& text )
+{
+  writeStartElement( tag );
+  writeCharacters( text );
+  writeEndElement();
+}
+
+QByteArray XmlWriter::data() const
+{
+  return mData;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KOLABV2XMLWRITER_H
+#define KOLABV2XMLWRITER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+namespace KolabV2 {
+
+/**
+ * Writes UTF-8 encoded XML in a single pass.
+ *
+ * The output is formatted and escaped like QDomDocument::toString() formats it,
+ * so documents written with it are byte-compatible with the former DOM based writer.
+ * Attributes are written in the order they are added.
+ *
+ * The methods are virtual, so the tests can build a DOM from the same calls
+ * and compare the output with QDom's serialization of it.
+ */
+class XmlWriter {
+public:
+  XmlWriter();
+  virtual ~XmlWriter();
+
+  virtual void writeStartElement( const QString& tag );
+  // Only valid directly after writeStartElement()
+  virtual void writeAttribute( const QString& name, const QString& value );
+  virtual void writeCharacters( const QString& text );
+  virtual void writeEndElement();
+  // Writes an element with @p text as its only content
+  void writeTextElement( const QString& tag, const QString& text );
+
+  QByteArray data() const;
+
+private:
+  struct Element {
+    QString tag;
+    bool hasText;
+  };
+
+  QByteArray mData;
+  QList<Element> mElements;
+  bool mStartTagOpen;
+};
+
+}
+
+#endif // KOLABV2XMLWRITER_H
@@ -0,0 +1,553 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mimecodecs.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#define KOLAB_HAVE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && defined(__i386__)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace Kolab {
+    namespace Mime {
+        namespace Codecs {
+
+//@cond PRIVATE
+static const char s_base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char s_hexChars[] = "0123456789ABCDEF";
+
+static const signed char s_base64Values[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+/**
+ * The base64 encoding of every 12 bit value, so a group of three bytes is encoded with two lookups.
+ */
+class Base64Pairs
+{
+public:
+    Base64Pairs()
+    {
+        for (int i = 0; i < 4096; i++) {
+            pairs[i * 2] = s_base64Chars[i >> 6];
+            pairs[i * 2 + 1] = s_base64Chars[i & 0x3f];
+        }
+    }
+    char pairs[4096 * 2];
+};
+
+//Initialized when the library is loaded
+static const Base64Pairs s_base64Pairs;
+
+static bool cpuHasSse2()
+{
+#ifdef KOLAB_HAVE_SSE2
+#if defined(__GNUC__) && defined(__i386__)
+    //Compiled with -msse2, which doesn't mean the CPU we run on has it
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2);
+#else
+    return true;
+#endif
+#else
+    return false;
+#endif
+}
+
+static Implementation s_implementation = cpuHasSse2() ? SSE2 : Scalar;
+
+static inline char *writeLineBreak(char *dest, bool crlf)
+{
+    if (crlf) {
+        *dest++ = '\r';
+    }
+    *dest++ = '\n';
+    return dest;
+}
+
+static inline int hexValue(unsigned char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static inline bool isLineBreak(const unsigned char *src, const unsigned char *end)
+{
+    return *src == '\n' || (*src == '\r' && src + 1 < end && src[1] == '\n');
+}
+
+#ifdef KOLAB_HAVE_SSE2
+/**
+ * Decodes the 16 base64 characters at @param src to 12 bytes at @param dest.
+ *
+ * Returns false without writing anything if one of the characters is not in the base64 alphabet (i.e. a line break or the padding).
+ * Writes 13 bytes, the last one is overwritten by the next block or by the scalar code.
+ */
+static inline bool decodeBase64Block(const unsigned char *src, char *dest)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    //Signed compares, so bytes >= 0x80 are never in range
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    const __m128i plus = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+    const __m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+    if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)))) != 0xffff) {
+        return false;
+    }
+    //Every character is in exactly one of the ranges, which determines what is added to get its 6 bit value
+    __m128i offset = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+    offset = _mm_or_si128(offset, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    offset = _mm_or_si128(offset, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    offset = _mm_or_si128(offset, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+    offset = _mm_or_si128(offset, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+    const __m128i values = _mm_add_epi8(v, offset);
+    //Each 16 bit word holds two values a and b, combine them to a << 6 | b
+    const __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00ff)), 6), _mm_srli_epi16(values, 8));
+    //Each 32 bit word holds two such pairs, combine them to the 24 bit value of the quad
+    const __m128i quads = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0x0000ffff)), 12), _mm_srli_epi32(pairs, 16));
+    //Swap the first and the third byte, so the bytes of each quad are stored in the order in which they are decoded
+    const __m128i swapped = _mm_or_si128(_mm_or_si128(_mm_and_si128(quads, _mm_set1_epi32(0x0000ff00)),
+                                                      _mm_and_si128(_mm_slli_epi32(quads, 16), _mm_set1_epi32(0x00ff0000))),
+                                         _mm_srli_epi32(quads, 16));
+    for (int i = 0; i < 4; i++) {
+        const int quad = _mm_cvtsi128_si32(i == 0 ? swapped : i == 1 ? _mm_srli_si128(swapped, 4) : i == 2 ? _mm_srli_si128(swapped, 8) : _mm_srli_si128(swapped, 12));
+        memcpy(dest + i * 3, &quad, 4);
+    }
+    return true;
+}
+
+/**
+ * Encodes the 12 bytes at @param src to 16 base64 characters at @param dest.
+ */
+static inline void encodeBase64Block(const unsigned char *src, char *dest)
+{
+    const __m128i triples = _mm_set_epi32((src[9] << 16) | (src[10] << 8) | src[11], (src[6] << 16) | (src[7] << 8) | src[8],
+                                          (src[3] << 16) | (src[4] << 8) | src[5], (src[0] << 16) | (src[1] << 8) | src[2]);
+    //Spread the four 6 bit values of each triple over the bytes of its 32 bit word, most significant first
+    __m128i values = _mm_srli_epi32(triples, 18);
+    values = _mm_or_si128(values, _mm_and_si128(_mm_srli_epi32(triples, 4), _mm_set1_epi32(0x00003f00)));
+    values = _mm_or_si128(values, _mm_and_si128(_mm_slli_epi32(triples, 10), _mm_set1_epi32(0x003f0000)));
+    values = _mm_or_si128(values, _mm_and_si128(_mm_slli_epi32(triples, 24), _mm_set1_epi32(0x3f000000)));
+    //'A' + value, corrected for the ranges of the alphabet the value falls into
+    __m128i offset = _mm_set1_epi8('A');
+    offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(25)), _mm_set1_epi8('a' - 26 - 'A')));
+    offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(51)), _mm_set1_epi8('0' - 52 - ('a' - 26))));
+    offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpeq_epi8(values, _mm_set1_epi8(62)), _mm_set1_epi8('+' - 62 - ('0' - 52))));
+    offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpeq_epi8(values, _mm_set1_epi8(63)), _mm_set1_epi8('/' - 63 - ('0' - 52))));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_add_epi8(values, offset));
+}
+
+/**
+ * Returns a mask with a bit set for each of the 16 bytes at @param src which can be written literally in quoted-printable.
+ *
+ * Spaces and tabs are left to the scalar code, because they need to be encoded at the end of a line.
+ */
+static inline int literalMask(const unsigned char *src)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(32)), _mm_cmplt_epi8(v, _mm_set1_epi8(127)));
+    return _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('=')), printable));
+}
+
+/**
+ * Returns a mask with a bit set for each of the 16 bytes at @param src which is printable ascii (including the space) but not '='.
+ */
+static inline int plainMask(const unsigned char *src)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(31)), _mm_cmplt_epi8(v, _mm_set1_epi8(127)));
+    return _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('=')), printable));
+}
+
+static inline int equalSignMask(const unsigned char *src)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+}
+
+/**
+ * The number of consecutive set bits from the lowest bit on.
+ */
+static inline int leadingRun(int mask)
+{
+    if (mask == 0xffff) {
+        return 16;
+    }
+    return __builtin_ctz(~mask);
+}
+#endif
+//@endcond
+
+Implementation implementation()
+{
+    return s_implementation;
+}
+
+bool setImplementation(Implementation implementation)
+{
+    if (implementation == SSE2 && !cpuHasSse2()) {
+        return false;
+    }
+    s_implementation = implementation;
+    return true;
+}
+
+void encodeBase64(const char *data, int size, bool crlf, QByteArray &encoded)
+{
+    if (size <= 0) {
+        return;
+    }
+    const int chars = (size + 2) / 3 * 4;
+    const int lines = (chars + 75) / 76;
+    const int start = encoded.size();
+    encoded.resize(start + chars + lines * (crlf ? 2 : 1));
+    char *dest = encoded.data() + start;
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char * const end = src + size;
+    const char *pairs = s_base64Pairs.pairs;
+#ifdef KOLAB_HAVE_SSE2
+    const bool sse2 = s_implementation == SSE2;
+#endif
+    int groups = 0;
+    while (end - src >= 3) {
+#ifdef KOLAB_HAVE_SSE2
+        //Four groups at a time, as long as they fit on the line
+        if (sse2 && end - src >= 12 && groups <= 15) {
+            encodeBase64Block(src, dest);
+            dest += 16;
+            src += 12;
+            groups += 4;
+            if (groups == 19) {
+                dest = writeLineBreak(dest, crlf);
+                groups = 0;
+            }
+            continue;
+        }
+#endif
+        const unsigned int triple = (src[0] << 16) | (src[1] << 8) | src[2];
+        memcpy(dest, pairs + (triple >> 12) * 2, 2);
+        memcpy(dest + 2, pairs + (triple & 0xfff) * 2, 2);
+        dest += 4;
+        src += 3;
+        if (++groups == 19) {
+            dest = writeLineBreak(dest, crlf);
+            groups = 0;
+        }
+    }
+    if (src != end) {
+        const unsigned int first = src[0];
+        const unsigned int second = (end - src == 2) ? src[1] : 0;
+        *dest++ = s_base64Chars[first >> 2];
+        *dest++ = s_base64Chars[((first & 0x03) << 4) | (second >> 4)];
+        *dest++ = (end - src == 2) ? s_base64Chars[(second & 0x0f) << 2] : '=';
+        *dest++ = '=';
+        groups++;
+    }
+    if (groups) {
+        dest = writeLineBreak(dest, crlf);
+    }
+    Q_ASSERT(dest == encoded.constData() + encoded.size());
+}
+
+int maxDecodedBase64Size(int size)
+{
+    return size / 4 * 3 + 3;
+}
+
+Base64Decoder::Base64Decoder()
+:   mQuad(0),
+    mCount(0),
+    mDone(false)
+{
+}
+
+int Base64Decoder::decode(const char *data, int size, char *decoded)
+{
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char * const end = src + qMax(size, 0);
+    char *dest = decoded;
+#ifdef KOLAB_HAVE_SSE2
+    const bool sse2 = s_implementation == SSE2;
+#endif
+    while (src != end && !mDone) {
+#ifdef KOLAB_HAVE_SSE2
+        //Blocks of 16 characters without line breaks or padding are decoded in one go
+        if (sse2 && mCount == 0) {
+            while (end - src >= 16 && decodeBase64Block(src, dest)) {
+                dest += 12;
+                src += 16;
+            }
+            if (src == end) {
+                break;
+            }
+        }
+#endif
+        const int value = s_base64Values[*src];
+        if (value < 0) {
+            if (*src == '=') {
+                mDone = true;
+            }
+            ++src;
+            continue;
+        }
+        mQuad = (mQuad << 6) | value;
+        if (++mCount == 4) {
+            dest[0] = static_cast<char>(mQuad >> 16);
+            dest[1] = static_cast<char>(mQuad >> 8);
+            dest[2] = static_cast<char>(mQuad);
+            dest += 3;
+            mQuad = 0;
+            mCount = 0;
+        }
+        ++src;
+    }
+    return dest - decoded;
+}
+
+int Base64Decoder::finish(char *decoded)
+{
+    char *dest = decoded;
+    if (mCount == 2) {
+        *dest++ = static_cast<char>(mQuad >> 4);
+    } else if (mCount == 3) {
+        *dest++ = static_cast<char>(mQuad >> 10);
+        *dest++ = static_cast<char>(mQuad >> 2);
+    }
+    mQuad = 0;
+    mCount = 0;
+    mDone = true;
+    return dest - decoded;
+}
+
+int decodeBase64(const char *data, int size, char *decoded)
+{
+    Base64Decoder decoder;
+    const int length = decoder.decode(data, size, decoded);
+    return length + decoder.finish(decoded + length);
+}
+
+void encodeQuotedPrintable(const char *data, int size, bool crlf, QByteArray &encoded)
+{
+    if (size <= 0) {
+        return;
+    }
+    //Every byte encoded and a soft line break every 25 bytes at worst
+    const int start = encoded.size();
+    encoded.resize(start + size * 4 + 16);
+    char *dest = encoded.data() + start;
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char * const end = src + size;
+#ifdef KOLAB_HAVE_SSE2
+    const bool sse2 = s_implementation == SSE2;
+#endif
+    //Lines are at most 76 characters long, including the '=' of a soft line break
+    const int maxLineLength = 75;
+    int lineLength = 0;
+    while (src != end) {
+#ifdef KOLAB_HAVE_SSE2
+        if (sse2) {
+            while (end - src >= 16 && lineLength < maxLineLength) {
+                const int run = qMin(leadingRun(literalMask(src)), maxLineLength - lineLength);
+                memcpy(dest, src, run);
+                dest += run;
+                src += run;
+                lineLength += run;
+                if (run < 16) {
+                    break;
+                }
+            }
+            if (src == end) {
+                break;
+            }
+        }
+#endif
+        const unsigned char c = *src;
+        if (isLineBreak(src, end)) {
+            src += (c == '\r') ? 2 : 1;
+            dest = writeLineBreak(dest, crlf);
+            lineLength = 0;
+            continue;
+        }
+        bool literal;
+        if (c == ' ' || c == '\t') {
+            //Trailing whitespace would be removed in transport
+            literal = src + 1 != end && !isLineBreak(src + 1, end);
+        } else {
+            literal = c > 32 && c < 127 && c != '=';
+        }
+        const int length = literal ? 1 : 3;
+        if (lineLength + length > maxLineLength) {
+            *dest++ = '=';
+            dest = writeLineBreak(dest, crlf);
+            lineLength = 0;
+        }
+        if (literal) {
+            *dest++ = c;
+        } else {
+            dest[0] = '=';
+            dest[1] = s_hexChars[c >> 4];
+            dest[2] = s_hexChars[c & 0x0f];
+            dest += 3;
+        }
+        lineLength += length;
+        ++src;
+    }
+    dest = writeLineBreak(dest, crlf);
+    encoded.resize(dest - encoded.constData());
+}
+
+int decodeQuotedPrintable(const char *data, int size, char *decoded)
+{
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char * const end = src + qMax(size, 0);
+    char *dest = decoded;
+#ifdef KOLAB_HAVE_SSE2
+    const bool sse2 = s_implementation == SSE2;
+#endif
+    while (src != end) {
+#ifdef KOLAB_HAVE_SSE2
+        //Copy everything up to the next '='
+        if (sse2) {
+            while (end - src >= 16) {
+                const int run = leadingRun(~equalSignMask(src) & 0xffff);
+                memcpy(dest, src, run);
+                dest += run;
+                src += run;
+                if (run < 16) {
+                    break;
+                }
+            }
+            if (src == end) {
+                break;
+            }
+        }
+#endif
+        if (*src != '=') {
+            *dest++ = *src++;
+            continue;
+        }
+        int high, low;
+        if (end - src >= 3 && (high = hexValue(src[1])) >= 0 && (low = hexValue(src[2])) >= 0) {
+            *dest++ = static_cast<char>((high << 4) | low);
+            src += 3;
+        } else if (end - src >= 2 && src[1] == '\n') { //Soft line break
+            src += 2;
+        } else if (end - src >= 3 && src[1] == '\r' && src[2] == '\n') {
+            src += 3;
+        } else { //Malformed, keep it as it is
+            *dest++ = *src++;
+        }
+    }
+    return dest - decoded;
+}
+
+Statistics analyze(const char *data, int size)
+{
+    Statistics statistics;
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char * const end = src + qMax(size, 0);
+#ifdef KOLAB_HAVE_SSE2
+    const bool sse2 = s_implementation == SSE2;
+#endif
+    int lineLength = 0;
+    while (src != end) {
+#ifdef KOLAB_HAVE_SSE2
+        //Skip over printable ascii, which doesn't affect anything but the line length
+        if (sse2) {
+            while (end - src >= 16) {
+                const int run = leadingRun(plainMask(src));
+                src += run;
+                lineLength += run;
+                if (run < 16) {
+                    break;
+                }
+            }
+            if (src == end) {
+                break;
+            }
+        }
+#endif
+        const unsigned char c = *src;
+        if (c == '\n' || (c == '\r' && src + 1 < end && src[1] == '\n')) {
+            const unsigned char *last = src - 1;
+            if (lineLength > 0 && (*last == ' ' || *last == '\t')) {
+                statistics.hasTrailingWhitespace = true;
+            }
+            statistics.maxLineLength = qMax(statistics.maxLineLength, lineLength);
+            statistics.lines++;
+            lineLength = 0;
+            src += (c == '\r') ? 2 : 1;
+            continue;
+        }
+        if (c >= 0x80) {
+            statistics.nonAscii++;
+            statistics.escaped++;
+        } else if (c == 0) {
+            statistics.hasNul = true;
+            statistics.escaped++;
+        } else if (c == '\r') {
+            statistics.hasBareCr = true;
+            statistics.escaped++;
+        } else if ((c < 32 && c != '\t') || c == '=' || c == 127) {
+            statistics.escaped++;
+        }
+        lineLength++;
+        ++src;
+    }
+    if (lineLength > 0) {
+        const unsigned char last = *(end - 1);
+        if (last == ' ' || last == '\t') {
+            statistics.hasTrailingWhitespace = true;
+        }
+        statistics.maxLineLength = qMax(statistics.maxLineLength, lineLength);
+        statistics.lines++;
+    }
+    return statistics;
+}
+
+        }
+    }
+}
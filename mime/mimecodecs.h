@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KOLABMIMECODECS_H
+#define KOLABMIMECODECS_H
+
+#include <QByteArray>
+
+namespace Kolab {
+    namespace Mime {
+
+/**
+ * Base64 and quoted-printable codecs for the kolab and attachment parts.
+ *
+ * These replace the KMime codecs on the hot paths of the mime layer. Base64 is encoded and decoded 12 bytes at a time with SSE2,
+ * quoted-printable uses SSE2 to skip over the characters that need no encoding, everything else is table driven scalar code.
+ * SSE2 is part of x86-64, so the runtime check of the CPU only matters for 32 bit x86 builds.
+ *
+ * The encoders terminate every line, including the last one, with a line break.
+ */
+namespace Codecs {
+
+enum Implementation {
+    Scalar,
+    SSE2
+};
+
+Implementation implementation();
+/**
+ * Selects the implementation, returns false if it's not supported by the CPU.
+ *
+ * Meant for tests and benchmarks, not thread-safe.
+ */
+bool setImplementation(Implementation);
+
+/**
+ * Appends the base64 encoding of @param data to @param encoded, in lines of 76 characters.
+ *
+ * When encoding in chunks, all chunks but the last one should be a multiple of 57 bytes long, so the lines are filled.
+ */
+void encodeBase64(const char *data, int size, bool crlf, QByteArray &encoded);
+/**
+ * Decodes base64 in one go, @param decoded needs room for maxDecodedBase64Size(size) bytes.
+ *
+ * Returns the number of decoded bytes.
+ */
+int decodeBase64(const char *data, int size, char *decoded);
+int maxDecodedBase64Size(int size);
+
+/**
+ * Decodes base64 in chunks.
+ *
+ * Characters outside of the base64 alphabet (i.e. line breaks) are skipped, decoding stops at the padding.
+ */
+class Base64Decoder
+{
+public:
+    Base64Decoder();
+    /**
+     * @param decoded needs room for maxDecodedBase64Size(size) bytes. Returns the number of decoded bytes.
+     */
+    int decode(const char *data, int size, char *decoded);
+    /**
+     * Decodes the remaining bits, @param decoded needs room for 2 bytes.
+     */
+    int finish(char *decoded);
+
+private:
+    unsigned int mQuad;
+    int mCount;
+    bool mDone;
+};
+
+/**
+ * Appends the quoted-printable encoding of the text @param data to @param encoded.
+ *
+ * Line breaks in @param data (LF or CRLF) are kept as hard line breaks.
+ */
+void encodeQuotedPrintable(const char *data, int size, bool crlf, QByteArray &encoded);
+/**
+ * @param decoded needs room for @param size bytes. Returns the number of decoded bytes.
+ */
+int decodeQuotedPrintable(const char *data, int size, char *decoded);
+
+/**
+ * What the choice of a transfer encoding depends on.
+ */
+struct Statistics {
+    Statistics(): nonAscii(0), escaped(0), lines(0), maxLineLength(0), hasNul(false), hasBareCr(false), hasTrailingWhitespace(false) {}
+    /**
+     * Bytes >= 0x80
+     */
+    int nonAscii;
+    /**
+     * Bytes quoted-printable has to escape
+     */
+    int escaped;
+    int lines;
+    int maxLineLength;
+    bool hasNul;
+    bool hasBareCr;
+    bool hasTrailingWhitespace;
+};
+
+Statistics analyze(const char *data, int size);
+
+}
+
+    }
+}
+
+#endif
@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mimescanner.h"
+#include "mimeutils.h"
+
+#include <QByteArrayMatcher>
+#include <kmime/kmime_util.h>
+#include <string.h>
+#include "kolabformat/errorhandler.h"
+
+namespace Kolab {
+    namespace Mime {
+
+typedef QList<QPair<QByteArray, QByteArray> > HeaderList;
+
+/**
+ * Parses the header block between @param pos and @param end.
+ *
+ * Returns the position after the empty line terminating the block, or -1 if there is none.
+ */
+static int parseHeaders(const char *data, int pos, int end, HeaderList &headers)
+{
+    while (pos < end) {
+        const char *lf = static_cast<const char*>(memchr(data + pos, '\n', end - pos));
+        const int lineEnd = lf ? lf - data : end;
+        int contentEnd = lineEnd;
+        if (contentEnd > pos && data[contentEnd - 1] == '\r') {
+            contentEnd--;
+        }
+        if (contentEnd == pos) { //The empty line terminates the header block
+            return lf ? lineEnd + 1 : end;
+        }
+        if (data[pos] == ' ' || data[pos] == '\t') {
+            if (headers.isEmpty()) {
+                return -1;
+            }
+            headers.last().second.append(data + pos, contentEnd - pos);
+        } else {
+            const char *colon = static_cast<const char*>(memchr(data + pos, ':', contentEnd - pos));
+            if (!colon) {
+                return -1;
+            }
+            headers.append(qMakePair(QByteArray(data + pos, colon - (data + pos)).trimmed().toLower(), QByteArray(colon + 1, contentEnd - (colon + 1 - data))));
+        }
+        if (!lf) {
+            return -1;
+        }
+        pos = lineEnd + 1;
+    }
+    return -1;
+}
+
+static QByteArray findHeader(const HeaderList &headers, const QByteArray &name)
+{
+    const QByteArray &lowerName = name.toLower();
+    for (HeaderList::const_iterator it = headers.constBegin(); it != headers.constEnd(); ++it) {
+        if (it->first == lowerName) {
+            const QByteArray &value = it->second.trimmed();
+            //Distinguish empty from missing headers
+            return value.isNull() ? QByteArray("", 0) : value;
+        }
+    }
+    return QByteArray();
+}
+
+static QByteArray mimeType(const QByteArray &contentType)
+{
+    return contentType.left(contentType.indexOf(';')).trimmed().toLower();
+}
+
+/**
+ * Returns the value of the parameter @param name of a structured header, and sets @param irregular for values we don't handle.
+ */
+static QByteArray parameter(const QByteArray &value, const QByteArray &name, bool &irregular)
+{
+    const QList<QByteArray> segments = value.split(';');
+    for (int i = 1; i < segments.size(); i++) {
+        const QByteArray &segment = segments.at(i);
+        const int eq = segment.indexOf('=');
+        if (eq < 0) {
+            continue;
+        }
+        const QByteArray &key = segment.left(eq).trimmed().toLower();
+        if (key.startsWith(name + '*')) { //RFC 2231
+            irregular = true;
+            return QByteArray();
+        }
+        if (key != name) {
+            continue;
+        }
+        QByteArray v = segment.mid(eq + 1).trimmed();
+        if (v.startsWith('"')) {
+            if (v.size() < 2 || !v.endsWith('"') || v.contains('\\')) {
+                irregular = true;
+                return QByteArray();
+            }
+            v = v.mid(1, v.size() - 2);
+        }
+        return v;
+    }
+    return QByteArray();
+}
+
+Scanner::Scanner(const QByteArray &rawMessage)
+:   mData(rawMessage),
+    mValid(false)
+{
+    mValid = scan();
+}
+
+bool Scanner::scan()
+{
+    const char *data = mData.constData();
+    const int size = mData.size();
+    const int bodyStart = parseHeaders(data, 0, size, mHeaders);
+    if (bodyStart < 0) {
+        return false;
+    }
+    const QByteArray &contentType = header("Content-Type");
+    if (mimeType(contentType) != "multipart/mixed") {
+        return false;
+    }
+    bool irregular = false;
+    const QByteArray &boundary = parameter(contentType, "boundary", irregular);
+    if (irregular || boundary.isEmpty()) {
+        return false;
+    }
+    const QByteArray delimiter = "--" + boundary;
+    const QByteArrayMatcher matcher(delimiter);
+
+    int partStart = -1;
+    int from = bodyStart;
+    while (true) {
+        const int found = matcher.indexIn(mData, from);
+        if (found < 0) { //No closing delimiter
+            return false;
+        }
+        from = found + delimiter.size();
+        if (found == 0 || data[found - 1] != '\n') { //Delimiters start at the beginning of a line
+            continue;
+        }
+        const bool close = from + 1 < size && data[from] == '-' && data[from + 1] == '-';
+        const char *lf = static_cast<const char*>(memchr(data + from, '\n', size - from));
+        const int lineEnd = lf ? lf - data : size;
+        bool isDelimiter = true;
+        for (int i = close ? from + 2 : from; i < lineEnd; i++) {
+            if (data[i] != ' ' && data[i] != '\t' && data[i] != '\r') { //Only transport padding is allowed after the delimiter
+                isDelimiter = false;
+                break;
+            }
+        }
+        if (!isDelimiter) {
+            continue;
+        }
+
+        if (partStart >= 0) {
+            //The line break before the delimiter belongs to the delimiter
+            int partEnd = found - 1;
+            if (partEnd > partStart && data[partEnd - 1] == '\r') {
+                partEnd--;
+            }
+            HeaderList headers;
+            const int partBodyStart = parseHeaders(data, partStart, partEnd, headers);
+            if (partBodyStart < 0) {
+                return false;
+            }
+            Part part;
+            const QByteArray &partContentType = findHeader(headers, "Content-Type");
+            part.type = partContentType.isNull() ? QByteArray("text/plain") : mimeType(partContentType);
+            if (part.type.startsWith("multipart/")) {
+                return false;
+            }
+            const QByteArray &name = parameter(partContentType, "name", irregular);
+            if (irregular) {
+                return false;
+            }
+            QByteArray usedCharset;
+            part.name = KMime::decodeRFC2047String(name, usedCharset);
+            part.contentId = findHeader(headers, "Content-ID");
+            if (part.contentId.startsWith('<') && part.contentId.endsWith('>')) {
+                part.contentId = part.contentId.mid(1, part.contentId.size() - 2);
+            }
+            part.encoding = findHeader(headers, "Content-Transfer-Encoding").toLower();
+            if (!part.encoding.isEmpty() && part.encoding != "7bit" && part.encoding != "8bit" && part.encoding != "binary"
+                && part.encoding != "base64" && part.encoding != "quoted-printable") {
+                return false;
+            }
+            part.offset = partBodyStart;
+            part.size = qMax(partEnd - partBodyStart, 0);
+            mParts.append(part);
+        }
+        if (close) {
+            return true;
+        }
+        if (!lf) {
+            return false;
+        }
+        partStart = lineEnd + 1;
+        from = partStart;
+    }
+    return false;
+}
+
+bool Scanner::isValid() const
+{
+    return mValid;
+}
+
+QByteArray Scanner::header(const QByteArray &name) const
+{
+    return findHeader(mHeaders, name);
+}
+
+const QList<Scanner::Part> &Scanner::parts() const
+{
+    return mParts;
+}
+
+const Scanner::Part *Scanner::findByType(const QByteArray &type) const
+{
+    for (QList<Part>::const_iterator it = mParts.constBegin(); it != mParts.constEnd(); ++it) {
+        if (it->type == type) {
+            return &(*it);
+        }
+    }
+    return 0;
+}
+
+const Scanner::Part *Scanner::findById(const QByteArray &cid) const
+{
+    if (cid.isEmpty()) {
+        return 0;
+    }
+    for (QList<Part>::const_iterator it = mParts.constBegin(); it != mParts.constEnd(); ++it) {
+        if (it->contentId == cid) {
+            return &(*it);
+        }
+    }
+    return 0;
+}
+
+const Scanner::Part *Scanner::findByName(const QString &name) const
+{
+    if (name.isEmpty()) {
+        return 0;
+    }
+    for (QList<Part>::const_iterator it = mParts.constBegin(); it != mParts.constEnd(); ++it) {
+        if (it->name == name) {
+            return &(*it);
+        }
+    }
+    return 0;
+}
+
+const char *Scanner::body(const Part &part) const
+{
+    return mData.constData() + part.offset;
+}
+
+void Scanner::decode(const Part &part, std::string &decoded) const
+{
+    decodeBody(body(part), part.size, part.encoding, decoded);
+}
+
+QByteArray Scanner::decodedContent(const Part &part) const
+{
+    std::string decoded;
+    decode(part, decoded);
+    return QByteArray(decoded.data(), decoded.size());
+}
+
+QByteArray Scanner::base64Content(const Part &part) const
+{
+    if (part.encoding != "base64") {
+        return decodedContent(part).toBase64();
+    }
+    return base64Body(body(part), part.size);
+}
+
+std::vector<Kolab::Attachment> getAttachmentsById(const std::vector<Kolab::Attachment> &attachments, const Scanner &scanner, AttachmentSpill *spill)
+{
+    std::vector<Kolab::Attachment> result;
+    result.reserve(attachments.size());
+    foreach (const Kolab::Attachment &attachment, attachments) {
+        const std::string &uri = attachment.uri();
+        if (uri.compare(0, 4, "cid:") != 0) {
+            result.push_back(attachment);
+            continue;
+        }
+        //It's a referenced attachmant, extract it
+        const Scanner::Part *part = scanner.findById(QByteArray(uri.data() + 4, uri.size() - 4));
+        if (!part) { // guard against malformed events with non-existent attachments
+            ReportError(Error, AttachmentNotFound, QString::fromUtf8(uri.c_str()));
+            result.push_back(attachment);
+            continue;
+        }
+        Kolab::Attachment a;
+        if (spill && spill->spill(scanner.body(*part), part->size, part->encoding, part->type, part->name, a)) {
+            result.push_back(a);
+            continue;
+        }
+        std::string data;
+        scanner.decode(*part, data);
+        a.setData(data, std::string(part->type.constData(), part->type.size()));
+        a.setLabel(std::string(part->name.toUtf8().constData()));
+        result.push_back(a);
+    }
+    return result;
+}
+
+Kolab::ObjectType getObjectType(const Scanner &scanner)
+{
+    const QByteArray &type = scanner.header(X_KOLAB_TYPE_HEADER);
+    if (!type.isNull()) {
+        return getObjectType(QString::fromUtf8(type));
+    }
+    Warning() << "could not find the X-Kolab-Type Header, trying autodetection" ;
+    //This works only for v2 messages atm.
+    foreach (const Scanner::Part &part, scanner.parts()) {
+        const Kolab::ObjectType t = getObjectType(QString::fromLatin1(part.type)); //works for v2 types
+        if (t != InvalidObject) {
+            return t;
+        }
+    }
+    return InvalidObject;
+}
+
+Kolab::Version getVersion(const Scanner &scanner)
+{
+    QByteArray version = scanner.header(X_KOLAB_MIME_VERSION_HEADER);
+    if (version.isNull()) {
+        //For backwards compatibility to development versions, can be removed in future versions
+        version = scanner.header(X_KOLAB_MIME_VERSION_HEADER_COMPAT);
+    }
+    if (version.isNull()) {
+        return KolabV2;
+    }
+    if (version != KOLAB_VERSION_V3) { //TODO version compatibility check?
+        ReportError(Warning, UnsupportedVersion, QString::fromLatin1(version));
+    }
+    return KolabV3;
+}
+
+void getAttachments(KCalCore::Incidence::Ptr incidence, const QStringList &attachments, const Scanner &scanner)
+{
+    if (!incidence) {
+        Error() << "Invalid incidence";
+        return;
+    }
+    foreach (const QString &name, attachments) {
+        const Scanner::Part *part = scanner.findByName(name);
+        if (!part) { // guard against malformed events with non-existent attachments
+            ReportError(Warning, AttachmentNotFound, name);
+            continue;
+        }
+        KCalCore::Attachment::Ptr attachment(new KCalCore::Attachment(scanner.base64Content(*part), QString::fromLatin1(part->type)));
+        attachment->setLabel(name);
+        incidence->addAttachment(attachment);
+    }
+}
+
+void getAttachmentsById(KCalCore::Incidence::Ptr incidence, const Scanner &scanner)
+{
+    if (!incidence) {
+        Error() << "Invalid incidence";
+        return;
+    }
+    foreach (KCalCore::Attachment::Ptr attachment, incidence->attachments()) {
+        if (!attachment->uri().contains("cid:")) {
+            continue;
+        }
+        //It's a referenced attachmant, extract it
+        const Scanner::Part *part = scanner.findById(fromCid(attachment->uri()).toLatin1());
+        if (!part) { // guard against malformed events with non-existent attachments
+            ReportError(Error, AttachmentNotFound, attachment->uri());
+            continue;
+        }
+        attachment->setUri(QString());
+        attachment->setData(scanner.base64Content(*part));
+        attachment->setMimeType(part->type);
+        attachment->setLabel(part->name);
+    }
+}
+
+    }
+}
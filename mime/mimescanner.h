@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KOLABMIMESCANNER_H
+#define KOLABMIMESCANNER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QPair>
+#include <string>
+#include <vector>
+#include <kolabcontainers.h>
+#include <kcalcore/incidence.h>
+#include "kolabformat/kolabdefinitions.h"
+
+namespace Kolab {
+    namespace Mime {
+
+class AttachmentSpill;
+
+/**
+ * Locates the headers and parts of a raw kolab message, without building a KMime::Message.
+ *
+ * Kolab messages have a very regular shape: a multipart/mixed message with the explanation part, the kolab part and the attachment parts.
+ * The scanner only searches the boundaries and parses the part headers, the bodies are decoded on request directly from the raw message.
+ *
+ * Anything irregular (nested multiparts, RFC 2231 parameters, a missing closing boundary, ...) makes the scanner invalid,
+ * callers are expected to fall back to KMime in that case.
+ *
+ * The raw message is not copied, it has to outlive the scanner.
+ */
+class Scanner
+{
+public:
+    struct Part {
+        /**
+         * The lower case mimetype
+         */
+        QByteArray type;
+        QString name;
+        QByteArray contentId;
+        /**
+         * The lower case content transfer encoding
+         */
+        QByteArray encoding;
+        int offset;
+        int size;
+    };
+
+    explicit Scanner(const QByteArray &rawMessage);
+
+    bool isValid() const;
+
+    /**
+     * Returns the unfolded and trimmed raw value of the top level header @param name (case-insensitive), or a null QByteArray.
+     */
+    QByteArray header(const QByteArray &name) const;
+
+    const QList<Part> &parts() const;
+    const Part *findByType(const QByteArray &type) const;
+    const Part *findById(const QByteArray &cid) const;
+    const Part *findByName(const QString &name) const;
+
+    /**
+     * Decodes the body of @param part, equivalent to Mime::decodeContent() for the corresponding KMime::Content.
+     */
+    void decode(const Part &part, std::string &decoded) const;
+    /**
+     * Equivalent to KMime::Content::decodedContent() for the corresponding KMime::Content.
+     */
+    QByteArray decodedContent(const Part &part) const;
+    /**
+     * Equivalent to Mime::base64Content() for the corresponding KMime::Content.
+     */
+    QByteArray base64Content(const Part &part) const;
+    const char *body(const Part &part) const;
+
+private:
+    bool scan();
+
+    QByteArray mData;
+    bool mValid;
+    QList<QPair<QByteArray, QByteArray> > mHeaders;
+    QList<Part> mParts;
+};
+
+/**
+ * Returns @param attachments with the attachments referenced by cid: replaced by the data of the corresponding attachment part.
+ *
+ * Attachments exceeding the threshold of @param spill are kept in a temporary file instead of memory.
+ */
+std::vector<Kolab::Attachment> getAttachmentsById(const std::vector<Kolab::Attachment> &attachments, const Scanner &scanner, AttachmentSpill *spill = 0);
+
+/**
+ * Same as the KMime::Message based functions in mimeutils.h, for a scanned message.
+ */
+Kolab::ObjectType getObjectType(const Scanner &scanner);
+Kolab::Version getVersion(const Scanner &scanner);
+void getAttachments(KCalCore::Incidence::Ptr incidence, const QStringList &attachments, const Scanner &scanner);
+void getAttachmentsById(KCalCore::Incidence::Ptr incidence, const Scanner &scanner);
+
+    }
+}
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mimestreamwriter.h"
+#include "mimeutils.h"
+#include "mimecodecs.h"
+
+#include <QIODevice>
+#include <QFile>
+#include <kmime/kmime_message.h>
+#include <kmime/kmime_util.h>
+#include "kolabformat/errorhandler.h"
+
+namespace Kolab {
+    namespace Mime {
+
+//@cond PRIVATE
+class StreamWriter::Private
+{
+public:
+    Private(QIODevice *device, bool crlf)
+    :   mDevice(device),
+        mCrLf(crlf),
+        mError(false)
+    {
+    }
+
+    bool write(const char *data, qint64 size);
+    bool write(const QByteArray &data);
+    bool writeLine(const QByteArray &line);
+    bool writeBase64(const char *data, qint64 size);
+    bool writeBase64(QIODevice *source);
+    bool writeEncoded(const char *data, qint64 size, KMime::Headers::contentEncoding encoding);
+    bool writePartHeader(KMime::Content *part);
+
+    QIODevice *mDevice;
+    bool mCrLf;
+    bool mError;
+    QByteArray mBoundary;
+    QByteArray mBuffer;
+};
+
+bool StreamWriter::Private::write(const char *data, qint64 size)
+{
+    if (mError) {
+        return false;
+    }
+    if (!mDevice || mDevice->write(data, size) != size) {
+        Error() << "failed to write to the device";
+        mError = true;
+    }
+    return !mError;
+}
+
+bool StreamWriter::Private::write(const QByteArray &data)
+{
+    if (mCrLf) {
+        //LFtoCRLF would turn lines that already end with CRLF into CRCRLF
+        const QByteArray &converted = KMime::LFtoCRLF(KMime::CRLFtoLF(data));
+        return write(converted.constData(), converted.size());
+    }
+    return write(data.constData(), data.size());
+}
+
+bool StreamWriter::Private::writeLine(const QByteArray &line)
+{
+    return write(line) && write(mCrLf ? "\r\n" : "\n", mCrLf ? 2 : 1);
+}
+
+bool StreamWriter::Private::writeBase64(const char *data, qint64 size)
+{
+    //Encode in chunks through a fixed buffer, full lines of 57 bytes each
+    const qint64 chunkSize = 57 * 128;
+    for (qint64 pos = 0; pos < size && !mError; pos += chunkSize) {
+        mBuffer.clear();
+        Codecs::encodeBase64(data + pos, static_cast<int>(qMin(chunkSize, size - pos)), mCrLf, mBuffer);
+        write(mBuffer.constData(), mBuffer.size());
+    }
+    return !mError;
+}
+
+bool StreamWriter::Private::writeBase64(QIODevice *source)
+{
+    QFile *file = qobject_cast<QFile*>(source);
+    if (file && file->size() > 0) {
+        if (uchar *mapped = file->map(0, file->size())) {
+            writeBase64(reinterpret_cast<const char*>(mapped), file->size());
+            file->unmap(mapped);
+            return !mError;
+        }
+    }
+
+    QByteArray chunk;
+    chunk.resize(57 * 1024);
+    while (!mError && source && !source->atEnd()) {
+        //Fill the chunk, so all but the last line are full
+        qint64 size = 0;
+        while (size < chunk.size() && !source->atEnd()) {
+            const qint64 read = source->read(chunk.data() + size, chunk.size() - size);
+            if (read < 0) {
+                Error() << "failed to read the attachment";
+                mError = true;
+                return false;
+            }
+            if (read == 0) {
+                break;
+            }
+            size += read;
+        }
+        writeBase64(chunk.constData(), size);
+    }
+    return !mError;
+}
+
+bool StreamWriter::Private::writeEncoded(const char *data, qint64 size, KMime::Headers::contentEncoding encoding)
+{
+    mBuffer.clear();
+    encodeBody(data, static_cast<int>(size), encoding, mCrLf, mBuffer);
+    return write(mBuffer.constData(), mBuffer.size());
+}
+
+bool StreamWriter::Private::writePartHeader(KMime::Content *part)
+{
+    part->assemble();
+    writeLine(QByteArray());
+    writeLine("--" + mBoundary);
+    write(part->head());
+    writeLine(QByteArray());
+    delete part;
+    return !mError;
+}
+//@endcond
+
+StreamWriter::StreamWriter(QIODevice *device, bool crlf)
+: d( new StreamWriter::Private(device, crlf) )
+{
+}
+
+StreamWriter::~StreamWriter()
+{
+    delete d;
+}
+
+bool StreamWriter::writeHeader(const QString &subject, const QString &fromEmail, const QString &fromName, const QString &xKolabType, const QString &prodid)
+{
+    d->mBoundary = KMime::multiPartBoundary();
+    d->write(encodedMessageHeader(subject, fromEmail, fromName, xKolabType, prodid, d->mBoundary));
+    d->writeLine(QByteArray());
+    d->writeLine(QByteArray());
+    d->writeLine("--" + d->mBoundary);
+    return d->write(encodedExplanationPart());
+}
+
+bool StreamWriter::writeMainPart(const QString &mimeType, const std::string &xml)
+{
+    const KMime::Headers::contentEncoding encoding = chooseMainPartEncoding(xml.data(), static_cast<int>(xml.size()));
+    KMime::Content *part = createMainPart( mimeType, QByteArray() );
+    part->contentTransferEncoding()->setEncoding(encoding);
+    d->writePartHeader(part);
+    return d->writeEncoded(xml.data(), xml.size(), encoding);
+}
+
+bool StreamWriter::writeAttachmentPart(const QByteArray &cid, const QString &mimeType, const QString &fileName, const std::string &decodedContent)
+{
+    d->writePartHeader(createAttachmentPart( cid, mimeType, fileName, QByteArray() ));
+    return d->writeBase64(decodedContent.data(), decodedContent.size());
+}
+
+bool StreamWriter::writeAttachmentPart(const QByteArray &cid, const QString &mimeType, const QString &fileName, QIODevice *source)
+{
+    d->writePartHeader(createAttachmentPart( cid, mimeType, fileName, QByteArray() ));
+    return d->writeBase64(source);
+}
+
+bool StreamWriter::finish()
+{
+    d->writeLine(QByteArray());
+    return d->writeLine("--" + d->mBoundary + "--");
+}
+
+bool StreamWriter::hasError() const
+{
+    return d->mError;
+}
+
+    }
+}
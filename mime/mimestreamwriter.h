@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KOLABMIMESTREAMWRITER_H
+#define KOLABMIMESTREAMWRITER_H
+
+#include <QString>
+#include <QByteArray>
+#include <string>
+
+class QIODevice;
+
+namespace Kolab {
+    namespace Mime {
+
+/**
+ * Writes a v3 Kolab mime message part by part to a QIODevice.
+ *
+ * The parts are encoded while they are written, so no KMime::Message and no encoded copy of the message is built in memory.
+ * To write to a file descriptor, open a QFile on it with QFile::open(int fd, QIODevice::OpenMode).
+ *
+ * Usage:
+ * writeHeader(), writeMainPart(), writeAttachmentPart() for every attachment and finish().
+ */
+class StreamWriter
+{
+public:
+    /**
+     * @param crlf write CRLF line endings (as required for IMAP APPEND) instead of LF.
+     */
+    explicit StreamWriter(QIODevice *device, bool crlf = false);
+    ~StreamWriter();
+
+    /**
+     * Writes the message headers and the explanation part.
+     */
+    bool writeHeader(const QString &subject, const QString &fromEmail, const QString &fromName, const QString &xKolabType, const QString &prodid);
+    /**
+     * Writes the kolab part, in the transfer encoding chosen by Mime::chooseMainPartEncoding().
+     */
+    bool writeMainPart(const QString &mimeType, const std::string &xml);
+    /**
+     * Writes a base64 encoded attachment part.
+     */
+    bool writeAttachmentPart(const QByteArray &cid, const QString &mimeType, const QString &fileName, const std::string &decodedContent);
+    /**
+     * Writes a base64 encoded attachment part with the content of @param source, which must be open for reading.
+     *
+     * A QFile is memory mapped if possible, other devices are read in chunks, so the attachment is never held in memory as a whole.
+     */
+    bool writeAttachmentPart(const QByteArray &cid, const QString &mimeType, const QString &fileName, QIODevice *source);
+    /**
+     * Writes the closing boundary.
+     */
+    bool finish();
+
+    /**
+     * Returns true if writing to the device failed.
+     */
+    bool hasError() const;
+
+private:
+    class Private;
+    Private *const d;
+};
+
+    }
+}
+
+#endif
@@ -16,11 +16,20 @@
  */
 
 #include "mimeutils.h"
+#include "mimecodecs.h"
 #include <quuid.h>
 #include <QtCore/qfile.h>
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+#include <QUrl>
 #include <qdom.h>
 #include <kdebug.h>
 #include <kabc/addressee.h>
+#include <kmime/kmime_util.h>
+#include <stdlib.h>
+#include <string.h>
 #include "kolabformat/kolabdefinitions.h"
 #include "kolabformat/errorhandler.h"
 #include "libkolab-version.h"
@@ -86,6 +95,105 @@ QList<QByteArray> getContentMimeTypeList(const KMime::Message::Ptr& data)
 }
 
 
+Kolab::ObjectType getObjectType(const QString &type)
+{
+    if (type == QLatin1String(KOLAB_TYPE_EVENT)) {
+        return EventObject;
+    } else if (type == QLatin1String(KOLAB_TYPE_TASK)) {
+        return TodoObject;
+    } else if (type == QLatin1String(KOLAB_TYPE_JOURNAL)) {
+        return JournalObject;
+    } else if (type == QLatin1String(KOLAB_TYPE_CONTACT)) {
+        return ContactObject;
+    } else if (type == QLatin1String(KOLAB_TYPE_DISTLIST) || type == QLatin1String(KOLAB_TYPE_DISTLIST_COMPAT)) {
+        return DistlistObject;
+    } else if (type == QLatin1String(KOLAB_TYPE_NOTE)) {
+        return NoteObject;
+    } else if (type == QLatin1String(KOLAB_TYPE_FREEBUSY)) {
+        return FreebusyObject;
+    } else if (type.contains(QLatin1String(KOLAB_TYPE_DICT))) { //Previous versions appended the language to the type
+        return DictionaryConfigurationObject;
+    }
+    Warning() << "Unknown object type: " << type;
+    return Kolab::InvalidObject;
+}
+
+QByteArray getTypeString(Kolab::ObjectType type)
+{
+    switch (type) {
+        case EventObject:
+            return KOLAB_TYPE_EVENT;
+        case TodoObject:
+            return KOLAB_TYPE_TASK;
+        case JournalObject:
+            return KOLAB_TYPE_JOURNAL;
+        case FreebusyObject:
+            return KOLAB_TYPE_FREEBUSY;
+        case ContactObject:
+            return KOLAB_TYPE_CONTACT;
+        case DistlistObject:
+            return KOLAB_TYPE_DISTLIST;
+        case NoteObject:
+            return KOLAB_TYPE_NOTE;
+        case DictionaryConfigurationObject:
+            return KOLAB_TYPE_CONFIGURATION;
+        default:
+            Critical() << "unknown type "<< type;
+    }
+    return QByteArray();
+}
+
+QByteArray getMimeType(Kolab::ObjectType type)
+{
+    switch (type) {
+        case EventObject:
+        case TodoObject:
+        case JournalObject:
+        case FreebusyObject:
+            return MIME_TYPE_XCAL;
+        case ContactObject:
+        case DistlistObject:
+            return MIME_TYPE_XCARD;
+        case NoteObject:
+        case DictionaryConfigurationObject:
+            return MIME_TYPE_KOLAB;
+        default:
+            Critical() << "unknown type "<< type;
+    }
+    return QByteArray();
+}
+
+Kolab::ObjectType getObjectType(const KMime::Message::Ptr &data)
+{
+    if (KMime::Headers::Base *xKolabHeader = data->getHeaderByType(X_KOLAB_TYPE_HEADER)) {
+        return getObjectType(xKolabHeader->asUnicodeString().trimmed());
+    }
+    Warning() << "could not find the X-Kolab-Type Header, trying autodetection" ;
+    //This works only for v2 messages atm.
+    Q_FOREACH(const QByteArray &type, getContentMimeTypeList(data)) {
+        Kolab::ObjectType t = getObjectType(QString::fromLatin1(type)); //works for v2 types
+        if (t != InvalidObject) {
+            return t;
+        }
+    }
+    return InvalidObject;
+}
+
+Kolab::Version getVersion(const KMime::Message::Ptr &data)
+{
+    KMime::Headers::Base *xKolabVersion = data->getHeaderByType(X_KOLAB_MIME_VERSION_HEADER);
+    if (!xKolabVersion) {
+        //For backwards compatibility to development versions, can be removed in future versions
+        xKolabVersion = data->getHeaderByType(X_KOLAB_MIME_VERSION_HEADER_COMPAT);
+    }
+    if (!xKolabVersion) {
+        return KolabV2;
+    }
+    if (xKolabVersion->asUnicodeString() != KOLAB_VERSION_V3) { //TODO version compatibility check?
+        Warning() << "Kolab Version Header available but not on the same version as the implementation: " << xKolabVersion->asUnicodeString();
+    }
+    return KolabV3;
+}
 
 QByteArray getXmlDocument(const KMime::Message::Ptr &data, const QByteArray &mimetype)
 {
@@ -96,6 +204,178 @@ QByteArray getXmlDocument(const KMime::Message::Ptr &data, const QByteArray &mim
     return QByteArray();
 }
 
+static QByteArray encodingName(KMime::Content *content)
+{
+    KMime::Headers::ContentTransferEncoding *cte = content->contentTransferEncoding();
+    if (cte->decoded()) {
+        return QByteArray();
+    }
+    switch (cte->encoding()) {
+        case KMime::Headers::CEbase64:
+            return "base64";
+        case KMime::Headers::CEquPr:
+            return "quoted-printable";
+        case KMime::Headers::CEuuenc:
+            return "x-uuencode";
+        case KMime::Headers::CEbinary:
+            return "binary";
+        default:
+            break;
+    }
+    return QByteArray();
+}
+
+void decodeBody(const char *data, int size, const QByteArray &encoding, std::string &decoded)
+{
+    decoded.clear();
+    if (size <= 0) {
+        return;
+    }
+    if (encoding != "base64" && memchr(data, '\r', size)) {
+        //Text bodies are decoded as if the message had been converted with KMime::CRLFtoLF
+        const QByteArray converted = KMime::CRLFtoLF(QByteArray::fromRawData(data, size));
+        decodeBody(converted.constData(), converted.size(), encoding, decoded);
+        return;
+    }
+    bool removeTrailingNewline = true;
+    if (encoding == "base64") {
+        decoded.resize(Codecs::maxDecodedBase64Size(size));
+        decoded.resize(Codecs::decodeBase64(data, size, &decoded[0]));
+        removeTrailingNewline = false;
+    } else if (encoding == "quoted-printable") {
+        decoded.resize(size);
+        decoded.resize(Codecs::decodeQuotedPrintable(data, size, &decoded[0]));
+    } else {
+        decoded.assign(data, size);
+        removeTrailingNewline = encoding != "binary";
+    }
+    if (removeTrailingNewline && !decoded.empty() && decoded[decoded.size() - 1] == '\n') {
+        decoded.resize(decoded.size() - 1);
+    }
+}
+
+bool decodeBody(const char *data, int size, const QByteArray &encoding, QIODevice *device)
+{
+    if (encoding != "base64") {
+        //Only base64 is used for attachments, so we don't bother with the other encodings
+        std::string decoded;
+        decodeBody(data, size, encoding, decoded);
+        return device->write(decoded.data(), decoded.size()) == static_cast<qint64>(decoded.size());
+    }
+    //Decode in chunks through a fixed buffer
+    Codecs::Base64Decoder decoder;
+    const int chunkSize = 8192;
+    char buffer[chunkSize];
+    bool ok = true;
+    for (int pos = 0; ok && pos < size; pos += chunkSize) {
+        const int length = decoder.decode(data + pos, qMin(chunkSize, size - pos), buffer);
+        ok = device->write(buffer, length) == length;
+    }
+    const int length = decoder.finish(buffer);
+    return ok && device->write(buffer, length) == length;
+}
+
+void decodeContent(KMime::Content *content, std::string &decoded)
+{
+    const QByteArray &encoding = encodingName(content);
+    if (encoding == "x-uuencode") {
+        //Not used by kolab objects, so we don't bother
+        const QByteArray &d = content->decodedContent();
+        decoded.assign(d.constData(), d.size());
+        return;
+    }
+    const QByteArray body = content->body();
+    decodeBody(body.constData(), body.size(), encoding, decoded);
+}
+
+bool decodeContent(KMime::Content *content, QIODevice *device)
+{
+    const QByteArray body = content->body();
+    return decodeBody(body.constData(), body.size(), encodingName(content), device);
+}
+
+static inline bool isBase64Char(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/' || c == '=';
+}
+
+QByteArray base64Content(KMime::Content *content)
+{
+    KMime::Headers::ContentTransferEncoding *cte = content->contentTransferEncoding();
+    if (cte->decoded() || cte->encoding() != KMime::Headers::CEbase64) {
+        return content->decodedContent().toBase64();
+    }
+    const QByteArray body = content->body();
+    return base64Body(body.constData(), body.size());
+}
+
+QByteArray base64Body(const char *data, int size)
+{
+    QByteArray encoded;
+    encoded.resize(size);
+    const char *src = data;
+    const char * const end = src + size;
+    char *dest = encoded.data();
+    for (; src != end; ++src) {
+        //Drops the line breaks and everything else the decoder would skip
+        if (isBase64Char(*src)) {
+            *dest++ = *src;
+        }
+    }
+    encoded.resize(dest - encoded.constData());
+    return encoded;
+}
+
+QList<QByteArray> peekHeaders(const QByteArray &rawMessage, const QList<QByteArray> &names)
+{
+    QList<QByteArray> values;
+    for (int i = 0; i < names.size(); i++) {
+        values.append(QByteArray());
+    }
+    const char *data = rawMessage.constData();
+    const int size = rawMessage.size();
+    int current = -1; //The header the current line belongs to (for folded headers)
+    int pos = 0;
+    while (pos < size) {
+        int end = rawMessage.indexOf('\n', pos);
+        if (end < 0) {
+            end = size;
+        }
+        int lineEnd = end;
+        if (lineEnd > pos && data[lineEnd - 1] == '\r') {
+            lineEnd--;
+        }
+        if (lineEnd == pos) { //The empty line terminates the header block
+            break;
+        }
+        if (data[pos] == ' ' || data[pos] == '\t') {
+            if (current >= 0) {
+                values[current].append(data + pos, lineEnd - pos);
+            }
+        } else {
+            current = -1;
+            const char *colon = static_cast<const char*>(memchr(data + pos, ':', lineEnd - pos));
+            if (colon) {
+                const int nameLength = colon - (data + pos);
+                for (int i = 0; i < names.size(); i++) {
+                    const QByteArray &name = names.at(i);
+                    if (values.at(i).isNull() && name.size() == nameLength && !qstrnicmp(name.constData(), data + pos, nameLength)) {
+                        current = i;
+                        values[i] = QByteArray(colon + 1, lineEnd - nameLength - 1 - pos);
+                        break;
+                    }
+                }
+            }
+        }
+        pos = end + 1;
+    }
+    for (int i = 0; i < values.size(); i++) {
+        if (!values.at(i).isNull()) {
+            values[i] = values.at(i).trimmed();
+        }
+    }
+    return values;
+}
 
 QString fromCid(const QString &cid)
 {
@@ -105,6 +385,142 @@ QString fromCid(const QString &cid)
     return cid.right(cid.size()-4);
 }
 
+//@cond PRIVATE
+/**
+ * The per-process spill directory, removed on exit if it is empty.
+ */
+struct SpillDirectory {
+    ~SpillDirectory()
+    {
+        if (!path.isEmpty()) {
+            QDir().rmdir(path);
+        }
+    }
+    QString path;
+};
+//@endcond
+
+static QMutex s_spillMutex;
+static SpillDirectory s_spillDirectory;
+//The uris of the files of all live AttachmentSpills, and the files they reference
+static QHash<QByteArray, QString> s_spilledFiles;
+
+AttachmentSpill::AttachmentSpill(qint64 threshold)
+:   mThreshold(threshold)
+{
+}
+
+AttachmentSpill::~AttachmentSpill()
+{
+    clear();
+}
+
+void AttachmentSpill::setThreshold(qint64 bytes)
+{
+    mThreshold = bytes;
+}
+
+qint64 AttachmentSpill::threshold() const
+{
+    return mThreshold;
+}
+
+bool AttachmentSpill::spill(KMime::Content *content, const QByteArray &mimeType, const QString &name, Kolab::Attachment &attachment)
+{
+    const QByteArray body = content->body();
+    return spill(body.constData(), body.size(), encodingName(content), mimeType, name, attachment);
+}
+
+bool AttachmentSpill::spill(const char *data, int size, const QByteArray &encoding, const QByteArray &mimeType, const QString &name, Kolab::Attachment &attachment)
+{
+    if (mThreshold <= 0 || size <= mThreshold) {
+        return false;
+    }
+    const QString &dir = spillDirectory();
+    if (dir.isNull()) {
+        return false;
+    }
+    QTemporaryFile *file = new QTemporaryFile(dir + QLatin1String("/attachment-XXXXXX"));
+    if (!file->open() || !decodeBody(data, size, encoding, file) || !file->flush()) {
+        Warning() << "failed to spill the attachment " << name << " to " << dir;
+        delete file;
+        return false;
+    }
+    const QByteArray uri = QUrl::fromLocalFile(file->fileName()).toEncoded();
+    {
+        QMutexLocker locker(&s_spillMutex);
+        s_spilledFiles.insert(uri, file->fileName());
+    }
+    mFiles.append(file);
+    attachment.setUri(uri.constData(), std::string(mimeType.constData(), mimeType.size()));
+    attachment.setLabel(std::string(name.toUtf8().constData()));
+    return true;
+}
+
+void AttachmentSpill::clear()
+{
+    {
+        QMutexLocker locker(&s_spillMutex);
+        foreach (QTemporaryFile *file, mFiles) {
+            s_spilledFiles.remove(QUrl::fromLocalFile(file->fileName()).toEncoded());
+        }
+    }
+    qDeleteAll(mFiles);
+    mFiles.clear();
+}
+
+QString AttachmentSpill::spillDirectory()
+{
+    QMutexLocker locker(&s_spillMutex);
+    if (s_spillDirectory.path.isEmpty()) {
+        //Not predictable and only accessible by us, unlike a fixed directory in the shared temp directory
+        QByteArray dir = QFile::encodeName(QDir::tempPath() + QLatin1String("/libkolab-XXXXXX"));
+        if (!mkdtemp(dir.data())) {
+            Warning() << "failed to create a directory for spilled attachments in " << QDir::tempPath();
+            return QString();
+        }
+        s_spillDirectory.path = QFile::decodeName(dir);
+    }
+    return s_spillDirectory.path;
+}
+
+bool AttachmentSpill::isSpilledUri(const std::string &uri)
+{
+    QString dir;
+    {
+        QMutexLocker locker(&s_spillMutex);
+        dir = s_spillDirectory.path;
+    }
+    if (dir.isEmpty()) {
+        return false;
+    }
+    //Only compares the strings, the uri is never resolved
+    const QByteArray prefix = QUrl::fromLocalFile(dir + QLatin1Char('/')).toEncoded();
+    return uri.compare(0, prefix.size(), prefix.constData()) == 0;
+}
+
+bool AttachmentSpill::openSpilledFile(const std::string &uri, QFile &file)
+{
+    QString path;
+    {
+        QMutexLocker locker(&s_spillMutex);
+        path = s_spilledFiles.value(QByteArray(uri.data(), uri.size()));
+    }
+    if (path.isNull()) {
+        return false;
+    }
+    file.setFileName(path);
+    return file.open(QIODevice::ReadOnly);
+}
+
+bool isEmbeddedAttachment(const Kolab::Attachment &attachment)
+{
+    if (attachment.uri().empty()) {
+        return !attachment.data().empty();
+    }
+    return AttachmentSpill::isSpilledUri(attachment.uri());
+}
+
 KMime::Message::Ptr createMessage(const KCalCore::Incidence::Ptr &incidencePtr, const QString &mimetype, const QString &xKolabType, const QByteArray &xml, bool v3, const QString &productId)
 {
     KMime::Message::Ptr message = createMessage( xKolabType, v3, productId );
@@ -189,55 +605,220 @@ KMime::Message::Ptr createMessage(const QString &subject, const QString &mimetyp
     return message;
 }
 
+KMime::Message::Ptr createMessage(const QString &subject, const QString &fromEmail, const QString &fromName, const QString &mimetype, const QString &xKolabType, const QByteArray &xml, const QList<KMime::Content*> &attachmentParts, const QString &prodid)
+{
+    KMime::Message::Ptr message = createMessage( xKolabType, true, prodid );
+    if (!fromEmail.isEmpty()) {
+        message->from()->addAddress( fromEmail.toUtf8(), fromName );
+    }
+    if (!subject.isEmpty()) {
+        message->subject()->fromUnicodeString( subject, "utf-8" );
+    }
+
+    KMime::Content *content = createMainPart( mimetype, xml );
+    message->addContent( content );
+
+    foreach (KMime::Content *part, attachmentParts) {
+        message->addContent( part );
+    }
+
+    message->assemble();
+    return message;
+}
+
+bool createAttachmentParts(const std::vector<Kolab::Attachment> &attachments, std::vector<Kolab::Attachment> &references, QList<KMime::Content*> &parts)
+{
+    QList<KMime::Content*> created;
+    references.clear();
+    references.reserve(attachments.size());
+    for (std::vector<Kolab::Attachment>::const_iterator it = attachments.begin(); it != attachments.end(); ++it) {
+        if (!isEmbeddedAttachment(*it)) {
+            //only by url, keep
+            references.push_back(*it);
+            continue;
+        }
+        const QByteArray cid = KMime::uniqueString() + '@' + "kolab.resource.akonadi";
+        const QString &mimetype = QString::fromUtf8(it->mimetype().c_str());
+        const QString &label = QString::fromUtf8(it->label().c_str());
+        if (it->uri().empty()) {
+            //createAttachmentPart only encodes the data, so it is read in place
+            const std::string &payload = it->data();
+            created.append(createAttachmentPart(cid, mimetype, label, QByteArray::fromRawData(payload.data(), payload.size())));
+        } else {
+            QFile file;
+            if (!AttachmentSpill::openSpilledFile(it->uri(), file)) {
+                Critical() << "the spilled attachment " << QString::fromUtf8(it->uri().c_str()) << " has been removed already";
+                qDeleteAll(created);
+                return false;
+            }
+            created.append(createAttachmentPart(cid, mimetype, label, file.readAll()));
+        }
+        //Serialize the attachment as attachment with uri, referencing the created mime-part
+        Kolab::Attachment reference;
+        reference.setUri(std::string("cid:") + cid.constData(), it->mimetype());
+        reference.setLabel(it->label());
+        references.push_back(reference);
+    }
+    parts += created;
+    return true;
+}
+
+//The explanation part is the same for every message, so it is kept pre-encoded and spliced into the messages
+#define KOLAB_EXPLANATION_HEAD "Content-Type: text/plain; charset=\"us-ascii\"\nContent-Transfer-Encoding: 7Bit\n"
+#define KOLAB_EXPLANATION_BODY "This is a Kolab Groupware object.\n" \
+    "To view this object you will need an email client that can understand the Kolab Groupware format.\n" \
+    "For a list of such email clients please visit\n" \
+    "http://www.kolab.org/get-kolab\n"
+
+static const char s_explanationHead[] = KOLAB_EXPLANATION_HEAD;
+static const char s_explanationBody[] = KOLAB_EXPLANATION_BODY;
+static const char s_explanationPart[] = KOLAB_EXPLANATION_HEAD "\n" KOLAB_EXPLANATION_BODY;
+
+QByteArray encodedExplanationPart()
+{
+    return QByteArray::fromRawData(s_explanationPart, sizeof(s_explanationPart) - 1);
+}
+
 KMime::Content* createExplanationPart(bool v3)
 {
+    Q_UNUSED(v3); //The explanation is the same for v2 and v3
     KMime::Content *content = new KMime::Content();
+    //The headers are only set for readers of the message, the frozen content is assembled from the pre-encoded head and body
     content->contentType()->setMimeType( "text/plain" );
     content->contentType()->setCharset( "us-ascii" );
     content->contentTransferEncoding()->setEncoding( KMime::Headers::CE7Bit );
-    if (v3) {
-        content->setBody( "This is a Kolab Groupware object.\n"
-        "To view this object you will need an email client that can understand the Kolab Groupware format.\n"
-        "For a list of such email clients please visit\n"
-        "http://www.kolab.org/get-kolab\n" );
-    } else {
-        content->setBody( "This is a Kolab Groupware object.\n"
-        "To view this object you will need an email client that can understand the Kolab Groupware format.\n"
-        "For a list of such email clients please visit\n"
-        "http://www.kolab.org/get-kolab\n" );
-    }
+    content->setHead( QByteArray::fromRawData(s_explanationHead, sizeof(s_explanationHead) - 1) );
+    content->setBody( QByteArray::fromRawData(s_explanationBody, sizeof(s_explanationBody) - 1) );
+    content->setFrozen( true );
     return content;
 }
 
+QByteArray encodedMessageHeader(const QString &subject, const QString &fromEmail, const QString &fromName, const QString &xKolabType, const QString &prodid, const QByteArray &boundary)
+{
+    KMime::Headers::Date date;
+    date.setDateTime( KDateTime::currentUtcDateTime() );
+    QByteArray head = date.as7BitString();
+    //The fixed headers are plain ascii, so they are spliced in without going through the header encoding
+    head += "\n" X_KOLAB_TYPE_HEADER ": ";
+    head += xKolabType.toLatin1();
+    head += "\n" X_KOLAB_MIME_VERSION_HEADER ": " KOLAB_VERSION_V3 "\n";
+    if (!prodid.isEmpty()) {
+        head += "User-Agent: ";
+        head += prodid.toLatin1();
+        head += '\n';
+    }
+    head += "Content-Type: multipart/mixed; boundary=\"";
+    head += boundary;
+    head += "\"\n";
+    if (!fromEmail.isEmpty()) {
+        KMime::Headers::From from;
+        from.addAddress( fromEmail.toUtf8(), fromName );
+        head += from.as7BitString();
+        head += '\n';
+    }
+    if (!subject.isEmpty()) {
+        KMime::Headers::Subject s;
+        s.fromUnicodeString( subject, "utf-8" );
+        head += s.as7BitString();
+        head += '\n';
+    }
+    head += "MIME-Version: 1.0\n";
+    return head;
+}
 
 KMime::Message::Ptr createMessage(const QString& xKolabType, bool v3, const QString &prodid)
 {
     KMime::Message::Ptr message( new KMime::Message );
     message->date()->setDateTime( KDateTime::currentUtcDateTime() );
-    KMime::Headers::Generic *h = new KMime::Headers::Generic( X_KOLAB_TYPE_HEADER, message.get(), xKolabType, "utf-8" );
+    //The types are plain ascii, which avoids the charset lookup of the unicode constructor
+    KMime::Headers::Generic *h = new KMime::Headers::Generic( X_KOLAB_TYPE_HEADER, message.get(), xKolabType.toLatin1() );
     message->appendHeader( h );
     if (v3) {
-        KMime::Headers::Generic *vh = new KMime::Headers::Generic( X_KOLAB_MIME_VERSION_HEADER, message.get(), KOLAB_VERSION_V3, "utf-8" );
+        KMime::Headers::Generic *vh = new KMime::Headers::Generic( X_KOLAB_MIME_VERSION_HEADER, message.get(), QByteArray(KOLAB_VERSION_V3) );
         message->appendHeader( vh );
     }
     message->userAgent()->from7BitString( prodid.toLatin1() );
     message->contentType()->setMimeType( "multipart/mixed" );
     message->contentType()->setBoundary( KMime::multiPartBoundary() );
-    
+
     message->addContent( createExplanationPart(v3) );
     return message;
 }
 
 
+static PartEncoding s_mainPartEncoding = AutomaticEncoding;
+
+void setMainPartEncoding(PartEncoding encoding)
+{
+    s_mainPartEncoding = encoding;
+}
+
+PartEncoding mainPartEncoding()
+{
+    return s_mainPartEncoding;
+}
+
+KMime::Headers::contentEncoding chooseMainPartEncoding(const char *data, int size)
+{
+    if (s_mainPartEncoding == QuotedPrintableEncoding) {
+        return KMime::Headers::CEquPr;
+    }
+    if (s_mainPartEncoding == Base64Encoding) {
+        return KMime::Headers::CEbase64;
+    }
+    const Codecs::Statistics statistics = Codecs::analyze(data, size);
+    const bool unencodedSafe = !statistics.hasNul && !statistics.hasBareCr && !statistics.hasTrailingWhitespace && statistics.maxLineLength <= 998;
+    if (unencodedSafe && !statistics.nonAscii) {
+        return KMime::Headers::CE7Bit;
+    }
+    if (unencodedSafe && s_mainPartEncoding == EightBitEncoding) {
+        return KMime::Headers::CE8Bit;
+    }
+    //Escapes take three bytes, plus a soft line break every 75 characters
+    const qint64 escapedSize = static_cast<qint64>(size) + 2 * statistics.escaped;
+    const qint64 quotedPrintableSize = escapedSize + escapedSize / 75 * 2;
+    const qint64 base64Size = (static_cast<qint64>(size) + 2) / 3 * 4 + size / 57 + 1;
+    return quotedPrintableSize <= base64Size ? KMime::Headers::CEquPr : KMime::Headers::CEbase64;
+}
+
+void encodeBody(const char *data, int size, KMime::Headers::contentEncoding encoding, bool crlf, QByteArray &encoded)
+{
+    switch (encoding) {
+        case KMime::Headers::CEquPr:
+            Codecs::encodeQuotedPrintable(data, size, crlf, encoded);
+            break;
+        case KMime::Headers::CEbase64:
+            Codecs::encodeBase64(data, size, crlf, encoded);
+            break;
+        case KMime::Headers::CE7Bit:
+        case KMime::Headers::CE8Bit: {
+            //Normalized first, so lines that already end with CRLF don't end up with CRCRLF
+            const QByteArray raw = KMime::CRLFtoLF(QByteArray::fromRawData(data, size));
+            encoded += crlf ? KMime::LFtoCRLF(raw) : raw;
+            if (size > 0) {
+                encoded += crlf ? "\r\n" : "\n";
+            }
+            break;
+        }
+        default:
+            Error() << "unsupported content transfer encoding " << encoding;
+    }
+}
+
 KMime::Content* createMainPart(const QString& mimeType, const QByteArray& decodedContent)
 {
     KMime::Content* content = new KMime::Content();
     content->contentType()->setMimeType( mimeType.toLatin1() );
     content->contentType()->setName( KOLAB_OBJECT_FILENAME, "us-ascii" );
-    content->contentTransferEncoding()->setEncoding( KMime::Headers::CEquPr );
     content->contentDisposition()->setDisposition( KMime::Headers::CDattachment );
     content->contentDisposition()->setFilename( KOLAB_OBJECT_FILENAME );
-    content->setBody( decodedContent );
+    //Encoded with our codec, so KMime doesn't have to when assembling
+    const KMime::Headers::contentEncoding encoding = chooseMainPartEncoding( decodedContent.constData(), decodedContent.size() );
+    QByteArray encoded;
+    encodeBody( decodedContent.constData(), decodedContent.size(), encoding, false, encoded );
+    content->setBody( encoded );
+    content->contentTransferEncoding()->setEncoding( encoding );
+    content->contentTransferEncoding()->setDecoded( false );
     return content;
 }
 
@@ -249,64 +830,167 @@ KMime::Content* createAttachmentPart(const QByteArray& cid, const QString& mimeT
     }
     content->contentType()->setMimeType( mimeType.toLatin1() );
     content->contentType()->setName( fileName, "utf-8" );
-    content->contentTransferEncoding()->setEncoding( KMime::Headers::CEbase64 );
     content->contentDisposition()->setDisposition( KMime::Headers::CDattachment );
     content->contentDisposition()->setFilename( fileName );
-    content->setBody( decodedContent );
+    QByteArray encoded;
+    Codecs::encodeBase64( decodedContent.constData(), decodedContent.size(), false, encoded );
+    content->setBody( encoded );
+    content->contentTransferEncoding()->setEncoding( KMime::Headers::CEbase64 );
+    content->contentTransferEncoding()->setDecoded( false );
     return content;
 }
 
+PartIndex::PartIndex(const KMime::Message::Ptr &message)
+{
+    if (!message) {
+        return;
+    }
+    foreach (KMime::Content *c, message->contents()) {
+        Part part;
+        part.content = c;
+        part.type = c->contentType()->mimeType();
+        part.name = c->contentType()->name();
+        const int index = mParts.size();
+        mParts.append(part);
+        if (KMime::Headers::ContentID *id = c->contentID(false)) {
+            const QByteArray &identifier = id->identifier();
+            if (!identifier.isEmpty() && !mIds.contains(identifier)) {
+                mIds.insert(identifier, index);
+            }
+        }
+        if (!part.name.isEmpty() && !mNames.contains(part.name)) {
+            mNames.insert(part.name, index);
+        }
+        if (!mTypes.contains(part.type)) {
+            mTypes.insert(part.type, index);
+        }
+    }
+}
+
+const PartIndex::Part *PartIndex::findById(const QByteArray &cid) const
+{
+    const QHash<QByteArray, int>::const_iterator it = mIds.constFind(cid);
+    if (it == mIds.constEnd()) {
+        return 0;
+    }
+    return &mParts.at(it.value());
+}
+
+const PartIndex::Part *PartIndex::findByName(const QString &name) const
+{
+    const QHash<QString, int>::const_iterator it = mNames.constFind(name);
+    if (it == mNames.constEnd()) {
+        return 0;
+    }
+    return &mParts.at(it.value());
+}
+
+const PartIndex::Part *PartIndex::findByType(const QByteArray &type) const
+{
+    const QHash<QByteArray, int>::const_iterator it = mTypes.constFind(type);
+    if (it == mTypes.constEnd()) {
+        return 0;
+    }
+    return &mParts.at(it.value());
+}
+
+void PartIndex::decode(const Part &part, std::string &decoded) const
+{
+    decodeContent(part.content, decoded);
+}
+
+QByteArray PartIndex::decodedContent(const Part &part) const
+{
+    return part.content->decodedContent();
+}
+
 void getAttachments(KCalCore::Incidence::Ptr incidence, const QStringList &attachments, const KMime::Message::Ptr &mimeData)
+{
+    getAttachments(incidence, attachments, PartIndex(mimeData));
+}
+
+void getAttachments(KCalCore::Incidence::Ptr incidence, const QStringList &attachments, const PartIndex &index)
 {
     if (!incidence) {
         Error() << "Invalid incidence";
         return;
     }
-//     kDebug() << "getting " << attachments.size() << "attachments";
-//     kDebug() << mimeData->encodedContent();
     foreach (const QString &name, attachments) {
-        QByteArray type;
-        KMime::Content *content = findContentByName(mimeData, name, type);
-        if (!content) { // guard against malformed events with non-existent attachments
-            Warning() << "could not find attachment: "<< name.toUtf8() << type;
+        const PartIndex::Part *part = index.findByName(name);
+        if (!part) { // guard against malformed events with non-existent attachments
+            ReportError(Warning, AttachmentNotFound, name);
             continue;
         }
-        const QByteArray c = content->decodedContent().toBase64();
-//         Debug() << c;
-        KCalCore::Attachment::Ptr attachment( new KCalCore::Attachment( c, QString::fromLatin1( type ) ) );
+        KCalCore::Attachment::Ptr attachment( new KCalCore::Attachment( base64Content(part->content), QString::fromLatin1( part->type ) ) );
         attachment->setLabel( name );
         incidence->addAttachment(attachment);
-        Debug() << "ATTACHMENT NAME" << name << type;
+        Debug() << "ATTACHMENT NAME" << name << part->type;
     }
 }
 
 void getAttachmentsById(KCalCore::Incidence::Ptr incidence, const KMime::Message::Ptr &mimeData)
+{
+    getAttachmentsById(incidence, PartIndex(mimeData));
+}
+
+void getAttachmentsById(KCalCore::Incidence::Ptr incidence, const PartIndex &index)
 {
     if (!incidence) {
         Error() << "Invalid incidence";
         return;
     }
-//     kDebug() << "getting " << attachments.size() << "attachments";
-//     kDebug() << mimeData->encodedContent();
-
     foreach(KCalCore::Attachment::Ptr attachment, incidence->attachments()) {
         Debug() << attachment->uri();
         if (!attachment->uri().contains("cid:")) {
             continue;
         }
         //It's a referenced attachmant, extract it
-        QByteArray type;
-        QString name;
-        KMime::Content *content = findContentById(mimeData, fromCid(attachment->uri()).toLatin1(), type, name);
-        if (!content) { // guard against malformed events with non-existent attachments
-            Error() << "could not find attachment: "<< name << type;
+        const PartIndex::Part *part = index.findById(fromCid(attachment->uri()).toLatin1());
+        if (!part) { // guard against malformed events with non-existent attachments
+            ReportError(Error, AttachmentNotFound, attachment->uri());
             continue;
         }
         attachment->setUri(QString());
-        attachment->setData(content->decodedContent().toBase64());
-        attachment->setMimeType(type);
-        attachment->setLabel(name);
+        attachment->setData(base64Content(part->content));
+        attachment->setMimeType(part->type);
+        attachment->setLabel(part->name);
+    }
+}
+
+std::vector<Kolab::Attachment> getAttachmentsById(const std::vector<Kolab::Attachment> &attachments, const KMime::Message::Ptr &mimeData)
+{
+    return getAttachmentsById(attachments, PartIndex(mimeData));
+}
+
+std::vector<Kolab::Attachment> getAttachmentsById(const std::vector<Kolab::Attachment> &attachments, const PartIndex &index, AttachmentSpill *spill)
+{
+    std::vector<Kolab::Attachment> result;
+    result.reserve(attachments.size());
+    foreach (const Kolab::Attachment &attachment, attachments) {
+        const QString uri = QString::fromUtf8(attachment.uri().c_str());
+        if (!uri.contains("cid:")) {
+            result.push_back(attachment);
+            continue;
+        }
+        //It's a referenced attachmant, extract it
+        const PartIndex::Part *part = index.findById(fromCid(uri).toLatin1());
+        if (!part) { // guard against malformed events with non-existent attachments
+            ReportError(Error, AttachmentNotFound, uri);
+            result.push_back(attachment);
+            continue;
+        }
+        Kolab::Attachment a;
+        if (spill && spill->spill(part->content, part->type, part->name, a)) {
+            result.push_back(a);
+            continue;
+        }
+        std::string data;
+        decodeContent(part->content, data);
+        a.setData(data, std::string(part->type.constData(), part->type.size()));
+        a.setLabel(std::string(part->name.toUtf8().constData()));
+        result.push_back(a);
     }
+    return result;
 }
 
 
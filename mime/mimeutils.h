@@ -24,7 +24,14 @@
 #include <kcalcore/event.h>
 #include <kmime/kmime_message.h>
 #include <kabc/addressee.h>
+#include <string>
+#include <QHash>
+#include <kolabcontainers.h>
+#include "kolabformat/kolabdefinitions.h"
 class QDomDocument;
+class QFile;
+class QIODevice;
+class QTemporaryFile;
 
 namespace Kolab {
     namespace Mime {
@@ -35,6 +42,175 @@ QList<QByteArray> getContentMimeTypeList(const KMime::Message::Ptr &data);
 
 QByteArray getXmlDocument(const KMime::Message::Ptr &data, const QByteArray &mimetype);
 
+/**
+ * Returns the object type for a X-Kolab-Type header value (or the mimetype of a v2 kolab part)
+ */
+Kolab::ObjectType getObjectType(const QString &xKolabType);
+/**
+ * Returns the X-Kolab-Type (and v2 kolab part mimetype) for an object type
+ */
+QByteArray getTypeString(Kolab::ObjectType type);
+/**
+ * Returns the mimetype of the v3 kolab part for an object type
+ */
+QByteArray getMimeType(Kolab::ObjectType type);
+
+/**
+ * Returns the object type from the X-Kolab-Type header, or tries to detect it from the parts if the header is missing
+ */
+Kolab::ObjectType getObjectType(const KMime::Message::Ptr &data);
+/**
+ * Returns the kolab format version from the X-Kolab-Mime-Version header
+ */
+Kolab::Version getVersion(const KMime::Message::Ptr &data);
+
+/**
+ * Decodes the body of @param content directly into @param decoded.
+ *
+ * Equivalent to KMime::Content::decodedContent(), but the content is decoded exactly once and without intermediate buffers,
+ * so the result can be handed to libkolabxml without further copies.
+ */
+void decodeContent(KMime::Content *content, std::string &decoded);
+/**
+ * Decodes the body of @param content chunk by chunk into @param device.
+ */
+bool decodeContent(KMime::Content *content, QIODevice *device);
+
+/**
+ * Decodes the @param size bytes at @param data, encoded with the content transfer encoding @param encoding (e.g. "base64"), into @param decoded.
+ *
+ * As with KMime::Content::decodedContent() a trailing newline is removed, unless the encoding is base64 or binary.
+ * An empty @param encoding means the data is not encoded.
+ */
+void decodeBody(const char *data, int size, const QByteArray &encoding, std::string &decoded);
+bool decodeBody(const char *data, int size, const QByteArray &encoding, QIODevice *device);
+
+/**
+ * Returns the body of @param content base64 encoded and without line breaks, as expected by KCalCore::Attachment.
+ *
+ * A base64 encoded body is passed through with only the line breaks removed, so the attachment is not decoded
+ * until a consumer asks for the decoded data. Other bodies are decoded and encoded to base64.
+ */
+QByteArray base64Content(KMime::Content *content);
+/**
+ * Returns the @param size bytes of the base64 encoded body at @param data without line breaks.
+ */
+QByteArray base64Body(const char *data, int size);
+
+/**
+ * Returns the content id referenced by the cid: uri @param cid, or a null QString for other uris.
+ */
+QString fromCid(const QString &cid);
+
+/**
+ * Scans the header block of a raw mime message for the headers in @param names (case-insensitive) without parsing the message.
+ *
+ * Returns the unfolded and trimmed raw values in the order of @param names, a null QByteArray for missing headers.
+ */
+QList<QByteArray> peekHeaders(const QByteArray &rawMessage, const QList<QByteArray> &names);
+
+/**
+ * Index of the parts of a message by content id, name and mimetype.
+ *
+ * The headers of every part are parsed once while building the index, lookups are then constant time.
+ * As with the findContentBy* functions, the first part wins if several parts share an id, name or mimetype.
+ */
+class PartIndex
+{
+public:
+    struct Part {
+        KMime::Content *content;
+        QByteArray type;
+        QString name;
+    };
+
+    explicit PartIndex(const KMime::Message::Ptr &message);
+
+    const Part *findById(const QByteArray &cid) const;
+    const Part *findByName(const QString &name) const;
+    const Part *findByType(const QByteArray &type) const;
+
+    /**
+     * Same as Scanner::decode() and Scanner::decodedContent(), so the readers can be written once for both.
+     */
+    void decode(const Part &part, std::string &decoded) const;
+    QByteArray decodedContent(const Part &part) const;
+
+private:
+    QList<Part> mParts;
+    QHash<QByteArray, int> mIds;
+    QHash<QString, int> mNames;
+    QHash<QByteArray, int> mTypes;
+};
+
+/**
+ * Keeps large attachments in temporary files instead of memory.
+ *
+ * Attachments with an encoded part larger than the threshold are decoded to a file in spillDirectory(), and referenced by a file: uri.
+ * The files are removed by clear() or when the AttachmentSpill is destroyed.
+ * The writers embed such attachments as attachment parts again, the streaming writer encodes them directly from the mapped file.
+ *
+ * Only files that have been created by an AttachmentSpill and not been removed yet are ever read back, they are looked up by their uri
+ * in a registry. A file: uri of any other origin is never opened, even if it points into spillDirectory().
+ */
+class AttachmentSpill
+{
+public:
+    /**
+     * A threshold of 0 disables spilling.
+     */
+    explicit AttachmentSpill(qint64 threshold = 0);
+    ~AttachmentSpill();
+
+    void setThreshold(qint64 bytes);
+    qint64 threshold() const;
+
+    /**
+     * Decodes @param content to a temporary file and sets the file: uri on @param attachment.
+     *
+     * Returns false if the part doesn't exceed the threshold or could not be written, @param attachment is left untouched in that case.
+     */
+    bool spill(KMime::Content *content, const QByteArray &mimeType, const QString &name, Kolab::Attachment &attachment);
+    /**
+     * Spills the @param size bytes at @param data, encoded with @param encoding.
+     */
+    bool spill(const char *data, int size, const QByteArray &encoding, const QByteArray &mimeType, const QString &name, Kolab::Attachment &attachment);
+    /**
+     * Removes all spilled files.
+     */
+    void clear();
+
+    /**
+     * The directory of this process for spilled files, created with mode 0700 on first use.
+     *
+     * Returns a null QString if the directory could not be created.
+     */
+    static QString spillDirectory();
+    /**
+     * Returns true if @param uri is a file: uri in spillDirectory(), whether or not the file still exists.
+     */
+    static bool isSpilledUri(const std::string &uri);
+    /**
+     * Opens the file that has been spilled to @param uri for reading.
+     *
+     * Returns false if @param uri doesn't reference a file created by an AttachmentSpill, or if that file has been removed already.
+     */
+    static bool openSpilledFile(const std::string &uri, QFile &file);
+
+private:
+    AttachmentSpill(const AttachmentSpill &);
+    AttachmentSpill &operator=(const AttachmentSpill &);
+    qint64 mThreshold;
+    QList<QTemporaryFile*> mFiles;
+};
+
+/**
+ * Returns true if @param attachment is written as an attachment part, because it has inline data or is backed by a spilled file.
+ *
+ * Attachments that reference a spilled file which has been removed already are embedded as well, so writing them fails.
+ */
+bool isEmbeddedAttachment(const Kolab::Attachment &attachment);
+
 /**
 * Get Attachments from a Mime message
 * 
@@ -42,15 +218,83 @@ QByteArray getXmlDocument(const KMime::Message::Ptr &data, const QByteArray &mim
 */
 //v2
 void getAttachments(KCalCore::Incidence::Ptr incidence, const QStringList &attachments, const KMime::Message::Ptr &mimeData);
+void getAttachments(KCalCore::Incidence::Ptr incidence, const QStringList &attachments, const PartIndex &index);
 //v3
 void getAttachmentsById(KCalCore::Incidence::Ptr incidence, const KMime::Message::Ptr &mimeData);
+void getAttachmentsById(KCalCore::Incidence::Ptr incidence, const PartIndex &index);
+/**
+ * Returns @param attachments with the attachments referenced by cid: replaced by the data of the corresponding attachment part.
+ */
+std::vector<Kolab::Attachment> getAttachmentsById(const std::vector<Kolab::Attachment> &attachments, const KMime::Message::Ptr &mimeData);
+/**
+ * Attachments exceeding the threshold of @param spill are kept in a temporary file instead of memory.
+ */
+std::vector<Kolab::Attachment> getAttachmentsById(const std::vector<Kolab::Attachment> &attachments, const PartIndex &index, AttachmentSpill *spill = 0);
 
 ///Generic serializing functions
 KMime::Message::Ptr createMessage(const KCalCore::Incidence::Ptr &incidencePtr, const QString &mimetype, const QString &xKolabType, const QByteArray &xml, bool v3, const QString &prodid);
 KMime::Message::Ptr createMessage(const KABC::Addressee &contact, const QString &mimetype, const QString &xKolabType, const QByteArray &xml, bool v3, const QString &prodid);
 KMime::Message::Ptr createMessage(const QString &subject, const QString &mimetype, const QString &xKolabType, const QByteArray &xml, bool v3, const QString &prodid);
 
-KMime::Content* createExplanationPart();
+/**
+ * Creates a v3 message for a libkolabxml container, the @param attachmentParts are added to the message.
+ */
+KMime::Message::Ptr createMessage(const QString &subject, const QString &fromEmail, const QString &fromName, const QString &mimetype, const QString &xKolabType, const QByteArray &xml, const QList<KMime::Content*> &attachmentParts, const QString &prodid);
+
+/**
+ * Appends the attachment parts for the inline attachments in @param attachments to @param parts,
+ * and fills @param references with the attachments, the inline ones replaced by cid: references to their part.
+ *
+ * The payloads are encoded straight from @param attachments, spilled attachments are read back from their file.
+ * Returns false, with no parts appended, if a spilled file has been removed already.
+ */
+bool createAttachmentParts(const std::vector<Kolab::Attachment> &attachments, std::vector<Kolab::Attachment> &references, QList<KMime::Content*> &parts);
+
+/**
+ * The content transfer encoding of the kolab part.
+ */
+enum PartEncoding {
+    /**
+     * 7bit for ascii text, otherwise the smaller one of quoted-printable and base64
+     */
+    AutomaticEncoding,
+    SevenBitEncoding,
+    EightBitEncoding,
+    QuotedPrintableEncoding,
+    Base64Encoding
+};
+
+/**
+ * Sets the transfer encoding of the kolab part for all writers, the default is AutomaticEncoding.
+ *
+ * 7bit and 8bit are only used if the content allows it (no NUL or bare CR, no trailing whitespace and lines of at most 998 characters),
+ * otherwise the encoding is chosen automatically. Not thread-safe, meant to be set once on startup.
+ */
+void setMainPartEncoding(PartEncoding);
+PartEncoding mainPartEncoding();
+/**
+ * Returns the transfer encoding for a kolab part with the content @param data.
+ */
+KMime::Headers::contentEncoding chooseMainPartEncoding(const char *data, int size);
+/**
+ * Appends @param data encoded with @param encoding to @param encoded, terminated by a line break.
+ */
+void encodeBody(const char *data, int size, KMime::Headers::contentEncoding encoding, bool crlf, QByteArray &encoded);
+
+/**
+ * Returns the explanation part, with headers and body, as it is written in every kolab message.
+ */
+QByteArray encodedExplanationPart();
+/**
+ * The returned part is frozen and assembled from the pre-encoded explanation part.
+ */
+KMime::Content* createExplanationPart(bool v3);
+/**
+ * Returns the encoded top level header of a v3 message, terminated by a line break but without the empty line ending the header.
+ *
+ * Only the date, @param subject and the from address are encoded per message, the remaining headers are spliced in as they are.
+ */
+QByteArray encodedMessageHeader(const QString &subject, const QString &fromEmail, const QString &fromName, const QString &xKolabType, const QString &prodid, const QByteArray &boundary);
 KMime::Message::Ptr createMessage(const QString& mimeType, bool v3, const QString &prodid);
 KMime::Content* createMainPart(const QString& mimeType, const QByteArray& decodedContent);
 KMime::Content* createAttachmentPart(const QByteArray &cid, const QString& mimeType, const QString& fileName, const QByteArray& decodedContent);
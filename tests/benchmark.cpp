@@ -16,13 +16,52 @@
  */
 
 #include "benchmark.h"
+#include <QBuffer>
+#include <QDirIterator>
+#include <cstdlib>
 #include "kolabformatV2/event.h"
 #include "conversion/kcalconversion.h"
+#include "conversion/commonconversion.h"
+#include "conversion/timezoneconverter.h"
+#include "mime/mimeutils.h"
+#include "mime/mimecodecs.h"
+#include "kolabformat/kolabobject.h"
+#include "kolabformat/mimeobject.h"
 #include <kmime/kmime_message.h>
+#include <kmime/kmime_util.h>
+#include <kmime/kmime_codecs.h>
 #include <kolabformat.h>
 #include <kdebug.h>
 #include "testutils.h"
 
+#ifdef __GLIBC__
+//Counts the heap allocations of this process, QByteArray and std::string both end up in malloc/realloc
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static bool s_countAllocations = false;
+static qint64 s_allocations = 0;
+static qint64 s_allocatedBytes = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    if (s_countAllocations) {
+        s_allocations++;
+        s_allocatedBytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    if (s_countAllocations) {
+        s_allocations++;
+        s_allocatedBytes += size;
+    }
+    return __libc_realloc(ptr, size);
+}
+#endif
+
 KMime::Message::Ptr readMimeFile( const QString &fileName )
 {
     QFile file( fileName );
@@ -50,8 +89,10 @@ KMime::Content* findContentByType(const KMime::Message::Ptr &data, const QByteAr
 void BenchmarkTests::parsingBenchmarkComparison_data()
 {
     QTest::addColumn<bool>("v2Parser");
-    QTest::newRow("v2") << true;
-    QTest::newRow("v3") << false;
+    QTest::addColumn<bool>("stream");
+    QTest::newRow("v2") << true << false;
+    QTest::newRow("v2stream") << true << true;
+    QTest::newRow("v3") << false << false;
 }
 
 void BenchmarkTests::parsingBenchmarkComparison()
@@ -69,12 +110,18 @@ void BenchmarkTests::parsingBenchmarkComparison()
     const std::string &v3String = Kolab::writeEvent(event);
     
     QFETCH(bool, v2Parser);
+    QFETCH(bool, stream);
     
     //     Kolab::readEvent(v3String, false); //init parser (doesn't really change the results it seems)
     //     qDebug() << QString::fromUtf8(xmlData);
     //     qDebug() << "------------------------------------------------------------------------------------";
     //     qDebug() << QString::fromStdString(v3String);
-    if (v2Parser) {
+    if (v2Parser && stream) {
+        QStringList attachments;
+        QBENCHMARK {
+            KolabV2::Event::fromXml( xmlData, QString::fromLatin1("Europe/Berlin"), attachments );
+        }
+    } else if (v2Parser) {
         QBENCHMARK {
             KolabV2::Event::fromXml( KolabV2::Event::loadDocument( QString::fromUtf8(xmlData) ), QString::fromLatin1("Europe/Berlin") );
         }
@@ -85,6 +132,488 @@ void BenchmarkTests::parsingBenchmarkComparison()
     }
 }
 
+void BenchmarkTests::decodingBenchmark_data()
+{
+    QTest::addColumn<bool>("singleDecode");
+    QTest::newRow("decodedContent") << false;
+    QTest::newRow("decodeContent") << true;
+}
+
+void BenchmarkTests::decodingBenchmark()
+{
+    const KMime::Message::Ptr kolabItem = readMimeFile( TESTFILEDIR+QString::fromLatin1("/v3/event/complex.ics.mime") );
+    KMime::Content *xmlContent = findContentByType( kolabItem, "application/calendar+xml" );
+    QVERIFY ( xmlContent );
+
+    std::string decoded;
+    Kolab::Mime::decodeContent(xmlContent, decoded);
+    QCOMPARE(QByteArray(decoded.data(), decoded.size()), xmlContent->decodedContent());
+
+    QFETCH(bool, singleDecode);
+#ifdef __GLIBC__
+    //The benchmark runs single threaded, so the counters are only touched by this thread
+    s_allocations = 0;
+    s_allocatedBytes = 0;
+    s_countAllocations = true;
+    if (singleDecode) {
+        std::string xml;
+        Kolab::Mime::decodeContent(xmlContent, xml);
+    } else {
+        const std::string xml(xmlContent->decodedContent().data(), xmlContent->decodedContent().size());
+    }
+    s_countAllocations = false;
+    qDebug() << "per object:" << s_allocations << "allocations," << s_allocatedBytes << "bytes allocated for" << decoded.size() << "decoded bytes";
+#endif
+    if (singleDecode) {
+        //One decoding pass straight into the string that is passed to libkolabxml
+        QBENCHMARK {
+            std::string xml;
+            Kolab::Mime::decodeContent(xmlContent, xml);
+        }
+    } else {
+        //Two decoding passes into temporary buffers and a copy into the string
+        QBENCHMARK {
+            const std::string xml(xmlContent->decodedContent().data(), xmlContent->decodedContent().size());
+        }
+    }
+}
+
+/**
+ * Reads a size field in kB from /proc/self/status (linux only), -1 if unavailable.
+ */
+static qint64 statusField(const QByteArray &field)
+{
+    QFile file( QString::fromLatin1("/proc/self/status") );
+    if (!file.open( QFile::ReadOnly )) {
+        return -1;
+    }
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    foreach (const QByteArray &line, lines) {
+        if (line.startsWith(field + ':')) {
+            return line.mid(field.size() + 1).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return -1;
+}
+
+/**
+ * Resets the peak resident set size to the current one (linux >= 4.0).
+ *
+ * Returns false if the kernel didn't reset it, in which case the peak still reflects the earlier tests.
+ */
+static bool resetPeakMemory()
+{
+    QFile file( QString::fromLatin1("/proc/self/clear_refs") );
+    if (!file.open( QFile::WriteOnly ) || file.write("5") != 1) {
+        return false;
+    }
+    file.close();
+    const qint64 peak = statusField("VmHWM");
+    return peak >= 0 && peak == statusField("VmRSS");
+}
+
+void BenchmarkTests::attachmentWritingBenchmark_data()
+{
+    QTest::addColumn<bool>("native");
+    QTest::newRow("kcalcore") << false;
+    QTest::newRow("native") << true;
+}
+
+void BenchmarkTests::attachmentWritingBenchmark()
+{
+    const int attachmentSize = 20 * 1024 * 1024;
+    QByteArray data(attachmentSize, 'a');
+    for (int i = 0; i < data.size(); i += 61) {
+        data[i] = static_cast<char>(i);
+    }
+
+    KCalCore::Event::Ptr event(new KCalCore::Event());
+    event->setUid(QLatin1String("uid"));
+    event->setSummary(QLatin1String("summary"));
+    event->setDtStart(KDateTime(QDate(2012,11,11), QTime(1,1), KDateTime::Spec(KDateTime::UTC)));
+    event->addAttachment(KCalCore::Attachment::Ptr(new KCalCore::Attachment(data.toBase64(), QLatin1String("application/octet-stream"))));
+    const Kolab::Event kolabEvent = Kolab::Conversion::fromKCalCore(*event);
+    data.clear();
+
+    QFETCH(bool, native);
+    const bool measured = resetPeakMemory();
+    const qint64 before = statusField("VmHWM");
+    KMime::Message::Ptr msg = native ? Kolab::KolabObjectWriter::writeEvent(kolabEvent) : Kolab::KolabObjectWriter::writeEvent(event);
+    QVERIFY(msg);
+    msg->encodedContent();
+    const qint64 after = statusField("VmHWM");
+    msg.reset();
+    if (measured) {
+        qDebug() << "peak memory growth per write:" << (after - before) / 1024 << "MB for a" << attachmentSize / (1024 * 1024) << "MB attachment";
+    } else {
+        qDebug() << "peak memory growth not measured, the kernel doesn't support resetting VmHWM";
+    }
+
+    QBENCHMARK {
+        if (native) {
+            Kolab::KolabObjectWriter::writeEvent(kolabEvent)->encodedContent();
+        } else {
+            Kolab::KolabObjectWriter::writeEvent(event)->encodedContent();
+        }
+    }
+}
+
+void BenchmarkTests::loggingBenchmark_data()
+{
+    QTest::addColumn<int>("threshold");
+    QTest::addColumn<bool>("output");
+    QTest::newRow("printEverything") << static_cast<int>(Kolab::ErrorHandler::Debug) << true;
+    QTest::newRow("warningThreshold") << static_cast<int>(Kolab::ErrorHandler::Warning) << true;
+    QTest::newRow("outputDisabled") << static_cast<int>(Kolab::ErrorHandler::Debug) << false;
+}
+
+void BenchmarkTests::loggingBenchmark()
+{
+    const KMime::Message::Ptr kolabItem = readMimeFile( TESTFILEDIR+QString::fromLatin1("/v3/event/complex.ics.mime") );
+
+    QFETCH(int, threshold);
+    QFETCH(bool, output);
+    Kolab::ErrorHandler::setLogThreshold(static_cast<Kolab::ErrorHandler::Severity>(threshold));
+    Kolab::ErrorHandler::setOutputEnabled(output);
+    QBENCHMARK {
+        Kolab::KolabObjectReader reader;
+        reader.parseMimeMessage(kolabItem);
+    }
+    Kolab::ErrorHandler::setLogThreshold(Kolab::ErrorHandler::Debug);
+    Kolab::ErrorHandler::setOutputEnabled(true);
+}
+
+void BenchmarkTests::attachmentReadingBenchmark()
+{
+    Kolab::Event event;
+    event.setUid("uid");
+    event.setStart(Kolab::cDateTime(2012,11,11,1,1,0,true));
+    std::vector<Kolab::Attachment> attachments;
+    for (int i = 0; i < 500; i++) {
+        Kolab::Attachment attachment;
+        attachment.setData(std::string(1024, 'a' + i % 26), "application/octet-stream");
+        attachment.setLabel(QString::number(i).toStdString());
+        attachments.push_back(attachment);
+    }
+    event.setAttachments(attachments);
+    const KMime::Message::Ptr msg = Kolab::KolabObjectWriter::writeEvent(event);
+    KMime::Message::Ptr parsed(new KMime::Message);
+    parsed->setContent(msg->encodedContent());
+    parsed->parse();
+
+    Kolab::ErrorHandler::setOutputEnabled(false);
+    QBENCHMARK {
+        Kolab::KolabObjectReader reader;
+        reader.parseMimeMessage(parsed);
+    }
+    Kolab::ErrorHandler::setOutputEnabled(true);
+}
+
+void BenchmarkTests::rawReadingBenchmark_data()
+{
+    QTest::addColumn<bool>("mimeObject");
+    QTest::addColumn<bool>("scanner");
+    QTest::newRow("KolabObjectReader kmime") << false << false;
+    QTest::newRow("KolabObjectReader scanner") << false << true;
+    QTest::newRow("MIMEObject kmime") << true << false;
+    QTest::newRow("MIMEObject scanner") << true << true;
+}
+
+/**
+ * Reads every message of the v2 and v3 test corpus, either parsed by KMime or read from the raw message.
+ */
+void BenchmarkTests::rawReadingBenchmark()
+{
+    QList<QByteArray> corpus;
+    foreach (const QString &version, QStringList() << QLatin1String("v2") << QLatin1String("v3")) {
+        QDirIterator it(TESTFILEDIR+version, QStringList() << QLatin1String("*.mime"), QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            QFile file(it.next());
+            QVERIFY(file.open(QFile::ReadOnly));
+            corpus << file.readAll();
+        }
+    }
+    QVERIFY(!corpus.isEmpty());
+
+    QFETCH(bool, mimeObject);
+    QFETCH(bool, scanner);
+    Kolab::ErrorHandler::setOutputEnabled(false);
+    QBENCHMARK {
+        foreach (const QByteArray &data, corpus) {
+            if (scanner) {
+                if (mimeObject) {
+                    Kolab::MIMEObject object;
+                    object.parseMessage(std::string(data.constData(), data.size()));
+                } else {
+                    Kolab::KolabObjectReader reader;
+                    reader.parseMessage(data);
+                }
+                continue;
+            }
+            KMime::Message::Ptr msg(new KMime::Message);
+            msg->setContent(KMime::CRLFtoLF(data));
+            msg->parse();
+            if (mimeObject) {
+                Kolab::MIMEObject object;
+                object.parseMimeMessage(msg);
+            } else {
+                Kolab::KolabObjectReader reader;
+                reader.parseMimeMessage(msg);
+            }
+        }
+    }
+    Kolab::ErrorHandler::setOutputEnabled(true);
+}
+
+void BenchmarkTests::codecBenchmark_data()
+{
+    QTest::addColumn<QByteArray>("codec");
+    QTest::addColumn<int>("implementation");
+    QTest::newRow("base64 kmime") << QByteArray("base64") << -1;
+    QTest::newRow("base64 scalar") << QByteArray("base64") << static_cast<int>(Kolab::Mime::Codecs::Scalar);
+    QTest::newRow("base64 sse2") << QByteArray("base64") << static_cast<int>(Kolab::Mime::Codecs::SSE2);
+    QTest::newRow("quoted-printable kmime") << QByteArray("quoted-printable") << -1;
+    QTest::newRow("quoted-printable scalar") << QByteArray("quoted-printable") << static_cast<int>(Kolab::Mime::Codecs::Scalar);
+    QTest::newRow("quoted-printable sse2") << QByteArray("quoted-printable") << static_cast<int>(Kolab::Mime::Codecs::SSE2);
+}
+
+/**
+ * Encodes and decodes the kolab parts of the v3 test corpus (quoted-printable) or a 1 MB binary attachment (base64).
+ */
+void BenchmarkTests::codecBenchmark()
+{
+    QFETCH(QByteArray, codec);
+    QFETCH(int, implementation);
+
+    QByteArray data;
+    if (codec == "base64") {
+        for (int i = 0; i < 1024 * 1024; i++) {
+            data.append(static_cast<char>((i * 7) % 256));
+        }
+    } else {
+        QStringList files;
+        files << "v3/event/complex.ics" << "v3/task/complex.ics" << "v3/journal/complex.ics" << "v3/contacts/complex.vcf" << "v3/contacts/distlist.vcf";
+        foreach (const QString &fileName, files) {
+            QFile file(TESTFILEDIR + fileName);
+            QVERIFY(file.open(QFile::ReadOnly));
+            data += file.readAll();
+        }
+    }
+
+    const Kolab::Mime::Codecs::Implementation initial = Kolab::Mime::Codecs::implementation();
+    if (implementation < 0) {
+        KMime::Codec *kmimeCodec = KMime::Codec::codecForName(codec);
+        QBENCHMARK {
+            kmimeCodec->decode(kmimeCodec->encode(data));
+        }
+        return;
+    }
+    if (!Kolab::Mime::Codecs::setImplementation(static_cast<Kolab::Mime::Codecs::Implementation>(implementation))) {
+        QSKIP("not supported by the CPU", SkipSingle);
+    }
+    QByteArray encoded;
+    QByteArray decoded;
+    QBENCHMARK {
+        encoded.clear();
+        if (codec == "base64") {
+            Kolab::Mime::Codecs::encodeBase64(data.constData(), data.size(), false, encoded);
+            decoded.resize(Kolab::Mime::Codecs::maxDecodedBase64Size(encoded.size()));
+            decoded.resize(Kolab::Mime::Codecs::decodeBase64(encoded.constData(), encoded.size(), decoded.data()));
+        } else {
+            Kolab::Mime::Codecs::encodeQuotedPrintable(data.constData(), data.size(), false, encoded);
+            decoded.resize(encoded.size());
+            decoded.resize(Kolab::Mime::Codecs::decodeQuotedPrintable(encoded.constData(), encoded.size(), decoded.data()));
+        }
+    }
+    Kolab::Mime::Codecs::setImplementation(initial);
+}
+
+/**
+ * Compares the size of the kolab part of the v3 test corpus with the automatically chosen transfer encoding to quoted-printable.
+ */
+void BenchmarkTests::transferEncodingSizes()
+{
+    QStringList files;
+    files << "v3/event/complex.ics.mime" << "v3/event/utf8base64.ics.mime" << "v3/task/complex.ics.mime" << "v3/journal/complex.ics.mime"
+          << "v3/contacts/complex.vcf.mime" << "v3/contacts/distlist.vcf.mime" << "v3/note/note.mime.mime";
+    QList<QByteArray> parts;
+    foreach (const QString &fileName, files) {
+        const KMime::Message::Ptr msg = readMimeFile(TESTFILEDIR + fileName);
+        const Kolab::Mime::PartIndex index(msg);
+        const Kolab::Mime::PartIndex::Part *part = index.findByName(QLatin1String(KOLAB_OBJECT_FILENAME));
+        QVERIFY(part);
+        parts << part->content->decodedContent();
+    }
+    //Non-latin content
+    QByteArray cyrillic("<text>");
+    for (int i = 0; i < 500; i++) {
+        cyrillic += "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \xe4\xbd\xa0\xe5\xa5\xbd\n";
+    }
+    cyrillic += "</text>\n";
+    files << "cyrillic/cjk";
+    parts << cyrillic;
+
+    qint64 totalQuotedPrintable = 0;
+    qint64 totalBase64 = 0;
+    qint64 totalChosen = 0;
+    for (int i = 0; i < parts.size(); i++) {
+        const QByteArray &part = parts.at(i);
+        QByteArray quotedPrintable;
+        Kolab::Mime::encodeBody(part.constData(), part.size(), KMime::Headers::CEquPr, false, quotedPrintable);
+        QByteArray base64;
+        Kolab::Mime::encodeBody(part.constData(), part.size(), KMime::Headers::CEbase64, false, base64);
+        const KMime::Headers::contentEncoding encoding = Kolab::Mime::chooseMainPartEncoding(part.constData(), part.size());
+        QByteArray chosen;
+        Kolab::Mime::encodeBody(part.constData(), part.size(), encoding, false, chosen);
+        KMime::Headers::ContentTransferEncoding cte;
+        cte.setEncoding(encoding);
+        qDebug() << files.at(i) << ":" << chosen.size() << "bytes" << cte.as7BitString(false) << "/" << quotedPrintable.size() << "quoted-printable /" << base64.size() << "base64";
+        totalQuotedPrintable += quotedPrintable.size();
+        totalBase64 += base64.size();
+        totalChosen += chosen.size();
+    }
+    qDebug() << "total:" << totalChosen << "bytes chosen /" << totalQuotedPrintable << "quoted-printable /" << totalBase64 << "base64";
+    QVERIFY(totalChosen < totalQuotedPrintable);
+
+    const QByteArray &largest = parts.last();
+    QBENCHMARK {
+        Kolab::Mime::chooseMainPartEncoding(largest.constData(), largest.size());
+    }
+}
+
+void BenchmarkTests::smallObjectWritingBenchmark_data()
+{
+    QTest::addColumn<bool>("stream");
+    QTest::newRow("kmime") << false;
+    QTest::newRow("stream") << true;
+}
+
+void BenchmarkTests::smallObjectWritingBenchmark()
+{
+    //For small objects the message boilerplate dominates the cost of a write
+    Kolab::Contact contact;
+    contact.setUid("uid");
+    contact.setName("name");
+    contact.setEmailAddresses(std::vector<std::string>() << std::string("contact@example.com"), 0);
+
+    QFETCH(bool, stream);
+    QBENCHMARK {
+        for (int i = 0; i < 100; i++) {
+            if (stream) {
+                QByteArray data;
+                QBuffer buffer(&data);
+                buffer.open(QIODevice::WriteOnly);
+                Kolab::KolabObjectWriter::writeContact(contact, &buffer);
+            } else {
+                Kolab::KolabObjectWriter::writeContact(contact)->encodedContent();
+            }
+        }
+    }
+}
+
+void BenchmarkTests::v2AttachmentReadingBenchmark_data()
+{
+    QTest::addColumn<QString>("reader");
+    QTest::newRow("domTwoPass") << QString::fromLatin1("dom");
+    QTest::newRow("streamSinglePass") << QString::fromLatin1("stream");
+    QTest::newRow("message") << QString::fromLatin1("message");
+}
+
+void BenchmarkTests::v2AttachmentReadingBenchmark()
+{
+    const int count = 500;
+    KCalCore::Event::Ptr event(new KCalCore::Event());
+    event->setUid(QLatin1String("uid"));
+    event->setSummary(QLatin1String("summary"));
+    event->setDtStart(KDateTime(QDate(2012,11,11), QTime(1,1), KDateTime::Spec(KDateTime::UTC)));
+    for (int i = 0; i < count; i++) {
+        KCalCore::Attachment::Ptr attachment(new KCalCore::Attachment(QByteArray("YXR0YWNobWVudA=="), QLatin1String("text/plain")));
+        attachment->setLabel(QString::fromLatin1("attachment%1").arg(i));
+        event->addAttachment(attachment);
+    }
+    const QByteArray xml = KolabV2::Event::eventToXML(event, QString());
+    const KMime::Message::Ptr msg = Kolab::KolabObjectWriter::writeEvent(event, Kolab::KolabV2);
+    QVERIFY(msg);
+
+    QFETCH(QString, reader);
+    if (reader == QLatin1String("dom")) {
+        //The former approach: a DOM, and a second traversal of it for the attachment names
+        QBENCHMARK {
+            const QDomDocument xmlDoc = KolabV2::KolabBase::loadDocument(QString::fromUtf8(xml));
+            KolabV2::Event::fromXml(xmlDoc, QString());
+            QStringList attachments;
+            const QDomNodeList nodes = xmlDoc.elementsByTagName("inline-attachment");
+            for (int i = 0; i < nodes.size(); i++) {
+                attachments.append(nodes.at(i).toElement().text());
+            }
+            QCOMPARE(attachments.size(), count);
+        }
+    } else if (reader == QLatin1String("stream")) {
+        QBENCHMARK {
+            QStringList attachments;
+            KolabV2::Event::fromXml(xml, QString(), attachments);
+            QCOMPARE(attachments.size(), count);
+        }
+    } else {
+        QBENCHMARK {
+            Kolab::KolabObjectReader objectReader(msg);
+            QCOMPARE(objectReader.getIncidence()->attachments().size(), count);
+        }
+    }
+}
+
+void BenchmarkTests::timeSpecBenchmark_data()
+{
+    QTest::addColumn<QString>("timezone");
+    QTest::newRow("olson") << QString::fromLatin1("Europe/Zurich");
+    QTest::newRow("windows") << QString::fromLatin1("W. Europe Standard Time");
+}
+
+void BenchmarkTests::timeSpecBenchmark()
+{
+    //An event with attendees, alarms, exceptions and recurrence dates converts many timestamps in the same timezone
+    QFETCH(QString, timezone);
+    const int count = 100000;
+    const Kolab::cDateTime dt(Kolab::Conversion::toStdString(timezone), 2012, 11, 11, 1, 1, 1);
+    Kolab::Conversion::clearTimeSpecCache();
+    QBENCHMARK {
+        for (int i = 0; i < count; i++) {
+            Kolab::Conversion::toDate(dt);
+        }
+    }
+}
+
+void BenchmarkTests::timezoneNormalizationBenchmark_data()
+{
+    //The cases of TimezoneTest
+    QTest::addColumn<QString>("timezone");
+    QTest::newRow("olson") << QString::fromLatin1("Europe/Zurich");
+    QTest::newRow("city") << QString::fromLatin1("(GMT+01.00) Sarajevo/Warsaw/Zagreb");
+    QTest::newRow("1") << QString::fromLatin1("(GMT+01:00) West Central Africa");
+    QTest::newRow("2") << QString::fromLatin1("(GMT-04:00) Atlantic Time (Canada)");
+    QTest::newRow("3") << QString::fromLatin1("(GMT-06:00) Saskatchewan");
+    QTest::newRow("4") << QString::fromLatin1("(GMT-01:00) Cape Verde Islands");
+    QTest::newRow("5") << QString::fromLatin1("(GMT-06:00) Central America");
+    QTest::newRow("6") << QString::fromLatin1("(GMT-06:00) Central Time (US and Canada)");
+    QTest::newRow("8") << QString::fromLatin1("(GMT-05:00) Eastern Time (US and Canada)");
+    QTest::newRow("10") << QString::fromLatin1("(GMT-07:00) Mountain Time (US and Canada)");
+    QTest::newRow("11") << QString::fromLatin1("(GMT-03:30) Newfoundland and Labrador");
+    QTest::newRow("12") << QString::fromLatin1("(GMT-08:00) Pacific Time (US and Canada); Tijuana");
+    QTest::newRow("13") << QString::fromLatin1("(GMT-11:00) Midway Island, Samoa");
+    QTest::newRow("14") << QString::fromLatin1("W. Europe Standard Time");
+}
+
+void BenchmarkTests::timezoneNormalizationBenchmark()
+{
+    QFETCH(QString, timezone);
+    //Builds the index outside of the measurement
+    QVERIFY(!TimezoneConverter::normalizeTimezone(timezone).isEmpty());
+    QBENCHMARK {
+        for (int i = 0; i < 1000; i++) {
+            TimezoneConverter::normalizeTimezone(timezone);
+        }
+    }
+}
 
 QTEST_MAIN( BenchmarkTests )
 
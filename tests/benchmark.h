@@ -29,6 +29,37 @@ private slots:
     
     void parsingBenchmarkComparison_data();
     void parsingBenchmarkComparison();
+
+    void decodingBenchmark_data();
+    void decodingBenchmark();
+
+    void attachmentWritingBenchmark_data();
+    void attachmentWritingBenchmark();
+
+    void loggingBenchmark_data();
+    void loggingBenchmark();
+
+    void attachmentReadingBenchmark();
+
+    void rawReadingBenchmark_data();
+    void rawReadingBenchmark();
+
+    void codecBenchmark_data();
+    void codecBenchmark();
+
+    void transferEncodingSizes();
+
+    void smallObjectWritingBenchmark_data();
+    void smallObjectWritingBenchmark();
+
+    void v2AttachmentReadingBenchmark_data();
+    void v2AttachmentReadingBenchmark();
+
+    void timeSpecBenchmark_data();
+    void timeSpecBenchmark();
+
+    void timezoneNormalizationBenchmark_data();
+    void timezoneNormalizationBenchmark();
     
 };
 
@@ -20,6 +20,7 @@
 
 #include <QtCore/QObject>
 #include <QtTest/QtTest>
+#include <QBuffer>
 #include <ksystemtimezone.h>
 #include <kolabcontact.h>
 #include <kcalcore/recurrence.h>
@@ -28,6 +29,7 @@
 #include "conversion/kcalconversion.h"
 #include "conversion/kcalconversion.cpp"
 #include "conversion/kabcconversion.h"
+#include "conversion/picturecache.h"
 #include "testhelpers.h"
 
 using namespace Kolab::Conversion;
@@ -524,6 +526,55 @@ void KCalConversionTest::testContactConversion()
     QCOMPARE(b.name(), kolab.name());
 }
 
+void KCalConversionTest::testPictureCache()
+{
+    QImage image(16, 16, QImage::Format_RGB32);
+    image.fill(qRgb(255, 0, 0));
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(image.save(&buffer, "PNG"));
+
+    Kolab::Contact kolab;
+    kolab.setUid("uid");
+    kolab.setName("name");
+    kolab.setPhoto(std::string(png.constData(), png.size()), "image/png");
+
+    //Without a batch nothing is cached
+    QVERIFY(toKABC(kolab).photo().data().cacheKey() != toKABC(kolab).photo().data().cacheKey());
+
+    const PictureCacheBatch batch;
+
+    //Identical pictures share the decoded image
+    const KABC::Addressee &first = toKABC(kolab);
+    const KABC::Addressee &second = toKABC(kolab);
+    QVERIFY(!first.photo().data().isNull());
+    QCOMPARE(first.photo().data().cacheKey(), second.photo().data().cacheKey());
+
+    //and are written with their original data, also if the image is not shared
+    const Kolab::Contact &written = fromKABC(first);
+    QCOMPARE(written.photo(), kolab.photo());
+    QCOMPARE(written.photoMimetype(), kolab.photoMimetype());
+    KABC::Addressee copy(first);
+    copy.setPhoto(KABC::Picture(first.photo().data().copy()));
+    QCOMPARE(fromKABC(copy).photo(), kolab.photo());
+
+    //The padding of the scanlines is not part of the image
+    const QImage &decoded = first.photo().data();
+    const int bytesPerLine = decoded.bytesPerLine() + 4;
+    QByteArray padded(bytesPerLine * decoded.height(), 'x');
+    for (int y = 0; y < decoded.height(); ++y) {
+        memcpy(padded.data() + y * bytesPerLine, decoded.scanLine(y), decoded.bytesPerLine());
+    }
+    const QImage paddedImage(reinterpret_cast<const uchar*>(padded.constData()), decoded.width(), decoded.height(), bytesPerLine, decoded.format());
+    std::string mimetype;
+    QCOMPARE(PictureCache::instance().encode(paddedImage, mimetype), kolab.photo());
+
+    //The mimetype is taken from the data
+    kolab.setPhoto(kolab.photo(), "image/jpeg");
+    QCOMPARE(fromKABC(toKABC(kolab)).photoMimetype(), std::string("image/png"));
+}
+
 
 // void KCalConversionTest::BenchmarkRoundtripKCAL()
 // {
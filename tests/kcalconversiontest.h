@@ -43,6 +43,8 @@ class KCalConversionTest : public QObject
     
     void testContactConversion_data();
     void testContactConversion();
+
+    void testPictureCache();
     
     void testDateTZ_data();
     void testDateTZ();
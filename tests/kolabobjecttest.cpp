@@ -18,10 +18,34 @@
 #include "kolabobjecttest.h"
 
 #include <QTest>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QtConcurrentRun>
+#include <QDomDocument>
+#include <QImage>
 
 #include "kolabformat/kolabobject.h"
+#include "kolabformat/mimeobject.h"
+#include "conversion/kcalconversion.h"
+#include "conversion/commonconversion.h"
+#include "kolabformatV2/event.h"
+#include "kolabformatV2/task.h"
+#include "kolabformatV2/journal.h"
+#include "kolabformatV2/contact.h"
+#include "kolabformatV2/distributionlist.h"
+#include "kolabformatV2/note.h"
+#include "kolabformatV2/xmlwriter.h"
+#include "kolabformat/v2helpers.h"
 #include <kdebug.h>
+#include <kmime/kmime_util.h>
+#include <kmime/kmime_codecs.h>
 #include <kolabformat/errorhandler.h>
+#include "testutils.h"
+#include "mime/mimeutils.h"
+#include "mime/mimescanner.h"
+#include "mime/mimecodecs.h"
 
 void KolabObjectTest::preserveLatin1()
 {
@@ -80,8 +104,1068 @@ void KolabObjectTest::dontCrashWithEmptyIncidence()
     QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Critical);
 }
 
+void KolabObjectTest::batchReader()
+{
+    QStringList files;
+    files << TESTFILEDIR+QString::fromLatin1("v3/event/simple.ics.mime");
+    files << TESTFILEDIR+QString::fromLatin1("v2/contacts/simple.vcf.mime");
+    files << TESTFILEDIR+QString::fromLatin1("v3/task/simple.ics.mime");
+    files << TESTFILEDIR+QString::fromLatin1("v2/event/simple.ics.mime");
+    QList<QByteArray> rawMessages;
+    foreach (const QString &fileName, files) {
+        QFile file(fileName);
+        QVERIFY(file.open(QFile::ReadOnly));
+        rawMessages << file.readAll();
+    }
+    rawMessages << QByteArray("invalid");
+
+    Kolab::KolabObjectBatchReader reader;
+    const QList<Kolab::KolabObjectBatchReader::Result> results = reader.read(rawMessages);
+    QCOMPARE(results.size(), rawMessages.size());
+
+    QCOMPARE(results.at(0).type, Kolab::EventObject);
+    QCOMPARE(results.at(0).version, Kolab::KolabV3);
+    QVERIFY(results.at(0).incidence);
+    QCOMPARE(results.at(0).errorSeverity, Kolab::ErrorHandler::Debug);
+
+    QCOMPARE(results.at(1).type, Kolab::ContactObject);
+    QCOMPARE(results.at(1).version, Kolab::KolabV2);
+    QVERIFY(!results.at(1).contact.isEmpty());
+    QVERIFY(!results.at(1).incidence);
+
+    QCOMPARE(results.at(2).type, Kolab::TodoObject);
+    QVERIFY(results.at(2).incidence.dynamicCast<KCalCore::Todo>());
+
+    QCOMPARE(results.at(3).type, Kolab::EventObject);
+    QCOMPARE(results.at(3).version, Kolab::KolabV2);
+    //The previous item must not leak into this one
+    QVERIFY(results.at(3).incidence.dynamicCast<KCalCore::Event>());
+
+    QCOMPARE(results.at(4).type, Kolab::InvalidObject);
+    //and neither does its version
+    QCOMPARE(results.at(4).version, Kolab::KolabV3);
+    QCOMPARE(results.at(4).errorSeverity, Kolab::ErrorHandler::Critical);
+    QVERIFY(!results.at(4).incidence);
+}
+
+void KolabObjectTest::peekObjectHeaders_data()
+{
+    QTest::addColumn<QString>( "filename" );
+    QTest::newRow( "v3event" ) << TESTFILEDIR+QString::fromLatin1("v3/event/simple.ics.mime");
+    QTest::newRow( "v3contact" ) << TESTFILEDIR+QString::fromLatin1("v3/contacts/complex.vcf.mime");
+    QTest::newRow( "v3note" ) << TESTFILEDIR+QString::fromLatin1("v3/note/note.mime.mime");
+    QTest::newRow( "v2event" ) << TESTFILEDIR+QString::fromLatin1("v2/event/complex.ics.mime");
+    QTest::newRow( "v2contact" ) << TESTFILEDIR+QString::fromLatin1("v2/contacts/simple.vcf.mime");
+    QTest::newRow( "v2task" ) << TESTFILEDIR+QString::fromLatin1("v2/task/simple.ics.mime");
+}
+
+void KolabObjectTest::peekObjectHeaders()
+{
+    QFETCH(QString, filename);
+    QFile file(filename);
+    QVERIFY(file.open(QFile::ReadOnly));
+    const QByteArray data = file.readAll();
+
+    Kolab::Version version;
+    QString uid;
+    const Kolab::ObjectType type = Kolab::peekObjectHeaders(data, version, uid);
+
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent(data);
+    msg->parse();
+    Kolab::KolabObjectReader reader;
+    QCOMPARE(type, reader.parseMimeMessage(msg));
+    QCOMPARE(version, reader.getVersion());
+    QCOMPARE(uid, msg->subject()->asUnicodeString());
+}
+
+void KolabObjectTest::mimeObjectReader()
+{
+    KCalCore::Event::Ptr event(new KCalCore::Event());
+    event->setSummary(QLatin1String("summary"));
+    event->setDtStart(KDateTime(QDate(2012,11,11), QTime(1,1), KDateTime::Spec(KDateTime::UTC)));
+    const QByteArray data("attachment data");
+    KCalCore::Attachment::Ptr attachment(new KCalCore::Attachment(data.toBase64(), QLatin1String("text/plain")));
+    attachment->setLabel(QLatin1String("label"));
+    event->addAttachment(attachment);
+    const KMime::Message::Ptr msg = Kolab::KolabObjectWriter::writeEvent(event);
+
+    Kolab::MIMEObject mimeObject;
+    QCOMPARE(mimeObject.parseMimeMessage(msg), Kolab::EventObject);
+    QCOMPARE(mimeObject.getVersion(), Kolab::KolabV3);
+    const Kolab::Event result = mimeObject.getEvent();
+    QCOMPARE(result.uid(), Kolab::Conversion::toStdString(event->uid()));
+    QCOMPARE(result.summary(), std::string("summary"));
+    QCOMPARE(result.attachments().size(), std::size_t(1));
+    QCOMPARE(result.attachments().front().data(), std::string(data.constData()));
+    QCOMPARE(result.attachments().front().mimetype(), std::string("text/plain"));
+    QCOMPARE(result.attachments().front().label(), std::string("label"));
+
+    //The same from the raw message, and a v2 object through the conversion
+    QCOMPARE(mimeObject.parseMessage(std::string(msg->encodedContent().constData())), Kolab::EventObject);
+    QCOMPARE(mimeObject.getEvent().attachments().size(), std::size_t(1));
+    bool ok = false;
+    const KMime::Message::Ptr v2msg = readMimeFile(TESTFILEDIR+QString::fromLatin1("v2/event/attachment.ics.mime"), ok);
+    QVERIFY(ok);
+    QCOMPARE(mimeObject.parseMimeMessage(v2msg), Kolab::EventObject);
+    QCOMPARE(mimeObject.getVersion(), Kolab::KolabV2);
+    QVERIFY(!mimeObject.getEvent().attachments().empty());
+}
+
+void KolabObjectTest::nativeWriter()
+{
+    Kolab::Event event;
+    event.setUid("uid");
+    event.setSummary("summary");
+    event.setStart(Kolab::cDateTime(2012,11,11,1,1,0,true));
+    Kolab::Attachment attachment;
+    attachment.setData("attachment data", "text/plain");
+    attachment.setLabel("label");
+    Kolab::Attachment url;
+    url.setUri("http://example.com/file", "text/plain");
+    std::vector<Kolab::Attachment> attachments;
+    attachments.push_back(attachment);
+    attachments.push_back(url);
+    event.setAttachments(attachments);
+
+    const KMime::Message::Ptr msg = Kolab::KolabObjectWriter::writeEvent(event);
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Debug);
+    QCOMPARE(msg->subject()->asUnicodeString(), QString::fromLatin1("uid"));
+    QCOMPARE(msg->contents().size(), 3);
+    //The written container is not modified
+    QVERIFY(event.attachments().front().uri().empty());
+
+    Kolab::MIMEObject mimeObject;
+    QCOMPARE(mimeObject.parseMimeMessage(msg), Kolab::EventObject);
+    const Kolab::Event result = mimeObject.getEvent();
+    QCOMPARE(result.uid(), std::string("uid"));
+    QCOMPARE(result.attachments().size(), std::size_t(2));
+    QCOMPARE(result.attachments().at(0).data(), std::string("attachment data"));
+    QCOMPARE(result.attachments().at(0).label(), std::string("label"));
+    QCOMPARE(result.attachments().at(1).uri(), std::string("http://example.com/file"));
+
+    //v2 goes through the conversion
+    const KMime::Message::Ptr v2msg = Kolab::KolabObjectWriter::writeEvent(event, Kolab::KolabV2);
+    Kolab::KolabObjectReader reader(v2msg);
+    QCOMPARE(reader.getType(), Kolab::EventObject);
+    QCOMPARE(reader.getVersion(), Kolab::KolabV2);
+    QCOMPARE(reader.getEvent()->uid(), QString::fromLatin1("uid"));
+}
+
+void KolabObjectTest::streamWriter()
+{
+    Kolab::Event event;
+    event.setUid("uid");
+    event.setSummary(std::string("summary \xc3\xa4"));
+    event.setStart(Kolab::cDateTime(2012,11,11,1,1,0,true));
+    event.setOrganizer(Kolab::ContactReference("organizer@example.com", "Organizer"));
+    Kolab::Attachment attachment;
+    attachment.setData(std::string("attachment\0data", 15), "application/octet-stream");
+    attachment.setLabel("label");
+    event.setAttachments(std::vector<Kolab::Attachment>() << attachment);
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(Kolab::KolabObjectWriter::writeEvent(event, &buffer));
+    buffer.close();
+
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent(data);
+    msg->parse();
+    QCOMPARE(msg->subject()->asUnicodeString(), QString::fromLatin1("uid"));
+    QCOMPARE(msg->from()->asUnicodeString(), QString::fromLatin1("Organizer <organizer@example.com>"));
+    QCOMPARE(msg->contents().size(), 3);
+
+    Kolab::MIMEObject mimeObject;
+    QCOMPARE(mimeObject.parseMimeMessage(msg), Kolab::EventObject);
+    QCOMPARE(mimeObject.getVersion(), Kolab::KolabV3);
+    const Kolab::Event result = mimeObject.getEvent();
+    QCOMPARE(result.summary(), event.summary());
+    QCOMPARE(result.attachments().size(), std::size_t(1));
+    QCOMPARE(result.attachments().front().data(), attachment.data());
+    QCOMPARE(result.attachments().front().label(), std::string("label"));
+
+    //CRLF for IMAP APPEND
+    QByteArray crlfData;
+    QBuffer crlfBuffer(&crlfData);
+    crlfBuffer.open(QIODevice::WriteOnly);
+    QVERIFY(Kolab::KolabObjectWriter::writeEvent(event, &crlfBuffer, QString(), true));
+    QVERIFY(!crlfData.contains("\r\r"));
+    QVERIFY(!crlfData.replace("\r\n", "").contains('\n'));
+
+    //Writing to a closed device fails
+    QBuffer closed;
+    QVERIFY(!Kolab::KolabObjectWriter::writeEvent(event, &closed));
+}
+
+static bool parseRepeatedly(const KMime::Message::Ptr &msg)
+{
+    for (int i = 0; i < 200; i++) {
+        Kolab::KolabObjectReader reader;
+        if (reader.parseMimeMessage(msg) != Kolab::EventObject || Kolab::ErrorHandler::instance().error() != Kolab::ErrorHandler::Debug) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool reportErrors()
+{
+    for (int i = 0; i < 200; i++) {
+        Kolab::ErrorHandler::clearErrors();
+        Error() << "error" << i;
+        if (Kolab::ErrorHandler::instance().error() != Kolab::ErrorHandler::Error || Kolab::ErrorHandler::instance().getErrors().size() != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void KolabObjectTest::threadLocalErrors()
+{
+    Kolab::Event event;
+    event.setUid("uid");
+    event.setStart(Kolab::cDateTime(2012,11,11,1,1,0,true));
+    const KMime::Message::Ptr msg = Kolab::KolabObjectWriter::writeEvent(event);
+    const QByteArray data = msg->encodedContent();
+    KMime::Message::Ptr msg2(new KMime::Message);
+    msg2->setContent(data);
+    msg2->parse();
+
+    Kolab::ErrorHandler::clearErrors();
+    QFuture<bool> parser1 = QtConcurrent::run(parseRepeatedly, msg);
+    QFuture<bool> parser2 = QtConcurrent::run(parseRepeatedly, msg2);
+    QFuture<bool> reporter = QtConcurrent::run(reportErrors);
+    QVERIFY(parser1.result());
+    QVERIFY(parser2.result());
+    QVERIFY(reporter.result());
+    //Nothing leaked into this thread
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Debug);
+    QVERIFY(Kolab::ErrorHandler::instance().getErrors().isEmpty());
+}
+
+static int evaluated = 0;
+
+static QString evaluate()
+{
+    evaluated++;
+    return QString::fromLatin1("evaluated");
+}
+
+void KolabObjectTest::logThreshold()
+{
+    Kolab::ErrorHandler::setLogThreshold(Kolab::ErrorHandler::Critical);
+    Kolab::ErrorHandler::clearErrors();
+    evaluated = 0;
+    Debug() << evaluate();
+    QCOMPARE(evaluated, 0);
+    //Warnings below the threshold are recorded without formatting them
+    Warning() << "warning" << 1 << evaluate();
+    ReportError(Warning, UnknownTimeZone, evaluate());
+    QCOMPARE(evaluated, 0);
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Warning);
+    QCOMPARE(Kolab::ErrorHandler::instance().errorMessage(), QString());
+    QCOMPARE(Kolab::ErrorHandler::instance().getErrors().size(), 2);
+    QCOMPARE(Kolab::ErrorHandler::instance().getErrors().last().code, Kolab::ErrorHandler::UnknownTimeZone);
+    //At the threshold they are
+    Critical() << "critical" << evaluate();
+    QCOMPARE(evaluated, 1);
+    QCOMPARE(Kolab::ErrorHandler::instance().errorMessage(), QString::fromLatin1("critical evaluated"));
+
+    Kolab::ErrorHandler::setLogThreshold(Kolab::ErrorHandler::Debug);
+    Debug() << evaluate();
+#ifdef KOLAB_NO_DEBUG_LOGGING
+    QCOMPARE(evaluated, 1);
+#else
+    QCOMPARE(evaluated, 2);
+#endif
+    Kolab::ErrorHandler::clearErrors();
+}
+
+void KolabObjectTest::errorBuffer()
+{
+    Kolab::ErrorHandler::setOutputEnabled(false);
+    Kolab::ErrorHandler::clearErrors();
+    Critical() << "critical";
+    ReportError(Warning, NoMailtoAddress, QString::fromLatin1("foo"));
+    for (int i = 0; i < Kolab::ErrorHandler::Capacity; i++) {
+        Warning() << "warning" << i;
+    }
+    Kolab::ErrorHandler::setOutputEnabled(true);
+
+    const Kolab::ErrorHandler &handler = Kolab::ErrorHandler::instance();
+    QCOMPARE(handler.getErrors().size(), static_cast<int>(Kolab::ErrorHandler::Capacity));
+    QCOMPARE(handler.droppedErrors(), 2);
+    QCOMPARE(handler.getErrors().first().message, QString::fromLatin1("warning 0"));
+    QCOMPARE(handler.getErrors().last().message, QString::fromLatin1("warning %1").arg(Kolab::ErrorHandler::Capacity - 1));
+    QVERIFY(handler.getErrors().first().location.contains(QLatin1String("kolabobjecttest.cpp")));
+    //The worst error survives
+    QCOMPARE(handler.error(), Kolab::ErrorHandler::Critical);
+    QCOMPARE(handler.errorCode(), Kolab::ErrorHandler::Message);
+    QCOMPARE(handler.errorMessage(), QString::fromLatin1("critical"));
+
+    Kolab::ErrorHandler::clearErrors();
+    ReportError(Warning, NoMailtoAddress, QString::fromLatin1("foo"));
+    QCOMPARE(handler.errorCode(), Kolab::ErrorHandler::NoMailtoAddress);
+    QCOMPARE(handler.errorMessage(), QString::fromLatin1("no mailto address: foo"));
+    QCOMPARE(handler.getErrors().size(), 1);
+    QCOMPARE(handler.getErrors().first().code, Kolab::ErrorHandler::NoMailtoAddress);
+
+    //Conditions of the parsers are reported as codes
+    Kolab::ErrorHandler::clearErrors();
+    Kolab::Version version;
+    QString uid;
+    Kolab::ErrorHandler::setOutputEnabled(false);
+    QCOMPARE(Kolab::peekObjectHeaders("Subject: not a kolab object\n\nbody\n", version, uid), Kolab::InvalidObject);
+    Kolab::ErrorHandler::setOutputEnabled(true);
+    QCOMPARE(handler.errorCode(), Kolab::ErrorHandler::NoKolabTypeHeader);
+    QCOMPARE(handler.errorMessage(), QString::fromLatin1("could not find the X-Kolab-Type Header"));
+    Kolab::ErrorHandler::clearErrors();
+    QVERIFY(handler.getErrors().isEmpty());
+    QCOMPARE(handler.droppedErrors(), 0);
+}
+
+void KolabObjectTest::partIndex()
+{
+    QList<KMime::Content*> parts;
+    parts << Kolab::Mime::createAttachmentPart("cid1@kolab.resource.akonadi", QLatin1String("text/plain"), QLatin1String("first"), "1");
+    parts << Kolab::Mime::createAttachmentPart("cid2@kolab.resource.akonadi", QLatin1String("image/png"), QLatin1String("second"), "2");
+    parts << Kolab::Mime::createAttachmentPart("cid3@kolab.resource.akonadi", QLatin1String("text/plain"), QLatin1String("first"), "3");
+    const KMime::Message::Ptr msg = Kolab::Mime::createMessage(QLatin1String("uid"), QString(), QString(), QLatin1String(MIME_TYPE_XCAL), QLatin1String(KOLAB_TYPE_EVENT), "<xml/>", parts, QString());
+
+    const Kolab::Mime::PartIndex index(msg);
+    QVERIFY(index.findById("cid2@kolab.resource.akonadi"));
+    QCOMPARE(index.findById("cid2@kolab.resource.akonadi")->content->decodedContent(), QByteArray("2"));
+    QCOMPARE(index.findById("cid2@kolab.resource.akonadi")->type, QByteArray("image/png"));
+    QCOMPARE(index.findById("cid2@kolab.resource.akonadi")->name, QString::fromLatin1("second"));
+    QVERIFY(!index.findById("missing"));
+    //The first part wins
+    QCOMPARE(index.findByName(QLatin1String("first"))->content->decodedContent(), QByteArray("1"));
+    QCOMPARE(index.findByType("text/plain")->content, Kolab::Mime::findContentByType(msg, "text/plain"));
+    QCOMPARE(index.findByType(MIME_TYPE_XCAL)->content, Kolab::Mime::findContentByType(msg, MIME_TYPE_XCAL));
+    QVERIFY(!index.findByType("image/jpeg"));
+}
+
+void KolabObjectTest::base64PassThrough()
+{
+    QByteArray data;
+    for (int i = 0; i < 1000; i++) {
+        data.append(static_cast<char>(i % 256));
+    }
+    QList<KMime::Content*> parts;
+    parts << Kolab::Mime::createAttachmentPart("cid1@kolab.resource.akonadi", QLatin1String("application/octet-stream"), QLatin1String("binary"), data);
+    const KMime::Message::Ptr msg = Kolab::Mime::createMessage(QLatin1String("uid"), QString(), QString(), QLatin1String(MIME_TYPE_XCAL), QLatin1String(KOLAB_TYPE_EVENT), "<xml/>", parts, QString());
+    //Not parsed yet
+    QCOMPARE(Kolab::Mime::base64Content(parts.first()), data.toBase64());
+
+    KMime::Message::Ptr parsed(new KMime::Message);
+    parsed->setContent(KMime::LFtoCRLF(msg->encodedContent()));
+    parsed->parse();
+    const Kolab::Mime::PartIndex index(parsed);
+    const QByteArray &base64 = Kolab::Mime::base64Content(index.findById("cid1@kolab.resource.akonadi")->content);
+    QCOMPARE(base64, data.toBase64());
+    QCOMPARE(QByteArray::fromBase64(base64), data);
+    //The quoted-printable main part is reencoded
+    KMime::Content *mainPart = index.findByType(MIME_TYPE_XCAL)->content;
+    QCOMPARE(Kolab::Mime::base64Content(mainPart), mainPart->decodedContent().toBase64());
+}
+
+void KolabObjectTest::spilledAttachments()
+{
+    std::string payload;
+    for (int i = 0; i < 100000; i++) {
+        payload.push_back(static_cast<char>(i % 251));
+    }
+    Kolab::Event event;
+    event.setUid("uid");
+    event.setStart(Kolab::cDateTime(2012,11,11,1,1,0,true));
+    Kolab::Attachment attachment;
+    attachment.setData(payload, "application/octet-stream");
+    attachment.setLabel("large");
+    Kolab::Attachment small;
+    small.setData("small", "text/plain");
+    small.setLabel("small");
+    event.setAttachments(std::vector<Kolab::Attachment>() << attachment << small);
+    const KMime::Message::Ptr msg = Kolab::KolabObjectWriter::writeEvent(event);
+
+    QString path;
+    Kolab::Event result;
+    {
+        Kolab::MIMEObject mimeObject;
+        mimeObject.setAttachmentSpillThreshold(1000);
+        QCOMPARE(mimeObject.parseMimeMessage(msg), Kolab::EventObject);
+        result = mimeObject.getEvent();
+        QCOMPARE(result.attachments().size(), std::size_t(2));
+        const Kolab::Attachment &spilled = result.attachments().front();
+        QVERIFY(spilled.data().empty());
+        QCOMPARE(spilled.label(), std::string("large"));
+        QCOMPARE(spilled.mimetype(), std::string("application/octet-stream"));
+        QVERIFY(Kolab::Mime::AttachmentSpill::isSpilledUri(spilled.uri()));
+        QFile file;
+        QVERIFY(Kolab::Mime::AttachmentSpill::openSpilledFile(spilled.uri(), file));
+        path = file.fileName();
+        QVERIFY(path.startsWith(Kolab::Mime::AttachmentSpill::spillDirectory() + QLatin1Char('/')));
+        QVERIFY(!(QFileInfo(Kolab::Mime::AttachmentSpill::spillDirectory()).permissions() & (QFile::ReadGroup | QFile::ReadOther)));
+        QCOMPARE(file.readAll(), QByteArray(payload.data(), payload.size()));
+        //Below the threshold
+        QCOMPARE(result.attachments().back().data(), std::string("small"));
+
+        //Both writers embed the spilled attachment again
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(Kolab::KolabObjectWriter::writeEvent(result, &buffer));
+        Kolab::MIMEObject streamed;
+        QCOMPARE(streamed.parseMessage(std::string(data.constData(), data.size())), Kolab::EventObject);
+        QCOMPARE(streamed.getEvent().attachments().front().data(), payload);
+        QVERIFY(streamed.getEvent().attachments().front().uri().empty());
+
+        Kolab::MIMEObject written;
+        QCOMPARE(written.parseMimeMessage(Kolab::KolabObjectWriter::writeEvent(result)), Kolab::EventObject);
+        QCOMPARE(written.getEvent().attachments().front().data(), payload);
+    }
+    //The files are removed with the MIMEObject
+    QVERIFY(!QFile::exists(path));
+    //Writing an attachment whose file has been removed fails
+    Kolab::ErrorHandler::setOutputEnabled(false);
+    QVERIFY(!Kolab::KolabObjectWriter::writeEvent(result));
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(!Kolab::KolabObjectWriter::writeEvent(result, &buffer));
+    QVERIFY(data.isEmpty());
+
+    //Files that have not been spilled are never read, even if the uri points into the spill directory
+    QFile secret(Kolab::Mime::AttachmentSpill::spillDirectory() + QLatin1String("/secret"));
+    QVERIFY(secret.open(QIODevice::WriteOnly));
+    secret.write("secret");
+    secret.close();
+    Kolab::Attachment traversal;
+    traversal.setUri(std::string("file://") + QFile::encodeName(Kolab::Mime::AttachmentSpill::spillDirectory()).constData() + "/sub/../secret", "text/plain");
+    event.setAttachments(std::vector<Kolab::Attachment>() << traversal);
+    QVERIFY(!Kolab::KolabObjectWriter::writeEvent(event));
+    QVERIFY(!Kolab::KolabObjectWriter::writeEvent(event, &buffer));
+    Kolab::ErrorHandler::setOutputEnabled(true);
+    //Other file: uris remain references
+    Kolab::Attachment reference;
+    reference.setUri("file:///etc/hostname", "text/plain");
+    QVERIFY(!Kolab::Mime::isEmbeddedAttachment(reference));
+    event.setAttachments(std::vector<Kolab::Attachment>() << reference);
+    Kolab::MIMEObject referenced;
+    QCOMPARE(referenced.parseMimeMessage(Kolab::KolabObjectWriter::writeEvent(event)), Kolab::EventObject);
+    QCOMPARE(referenced.getEvent().attachments().front().uri(), reference.uri());
+    QVERIFY(secret.remove());
+}
+
+void KolabObjectTest::rawScanner_data()
+{
+    QTest::addColumn<QString>( "filename" );
+    QTest::newRow( "event" ) << TESTFILEDIR+QString::fromLatin1("v3/event/complex.ics.mime");
+    QTest::newRow( "eventBase64" ) << TESTFILEDIR+QString::fromLatin1("v3/event/utf8base64.ics.mime");
+    QTest::newRow( "eventQuotedPrintable" ) << TESTFILEDIR+QString::fromLatin1("v3/event/utf8quotedPrintable.ics.mime");
+    QTest::newRow( "task" ) << TESTFILEDIR+QString::fromLatin1("v3/task/complex.ics.mime");
+    QTest::newRow( "journal" ) << TESTFILEDIR+QString::fromLatin1("v3/journal/complex.ics.mime");
+    QTest::newRow( "contact" ) << TESTFILEDIR+QString::fromLatin1("v3/contacts/complex.vcf.mime");
+    QTest::newRow( "distlist" ) << TESTFILEDIR+QString::fromLatin1("v3/contacts/distlist.vcf.mime");
+    QTest::newRow( "note" ) << TESTFILEDIR+QString::fromLatin1("v3/note/note.mime.mime");
+}
+
+static bool sameObject(const Kolab::MIMEObject &a, const Kolab::MIMEObject &b)
+{
+    if (a.getType() != b.getType() || a.getVersion() != b.getVersion()) {
+        return false;
+    }
+    switch (a.getType()) {
+        case Kolab::EventObject:
+            return a.getEvent() == b.getEvent();
+        case Kolab::TodoObject:
+            return a.getTodo() == b.getTodo();
+        case Kolab::JournalObject:
+            return a.getJournal() == b.getJournal();
+        case Kolab::ContactObject:
+            return a.getContact() == b.getContact();
+        case Kolab::DistlistObject:
+            return a.getDistlist() == b.getDistlist();
+        case Kolab::NoteObject:
+            return a.getNote() == b.getNote();
+        default:
+            break;
+    }
+    return false;
+}
+
+void KolabObjectTest::rawScanner()
+{
+    QFETCH(QString, filename);
+    QFile file(filename);
+    QVERIFY(file.open(QFile::ReadOnly));
+    const QByteArray data = file.readAll();
+
+    const Kolab::Mime::Scanner scanner(data);
+    QVERIFY(scanner.isValid());
+    QCOMPARE(scanner.parts().size(), 2);
+    QCOMPARE(scanner.parts().first().type, QByteArray("text/plain"));
+    QCOMPARE(scanner.header("x-kolab-mime-version"), QByteArray(KOLAB_VERSION_V3));
+
+    //The scanner and KMime read the same object
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent(data);
+    msg->parse();
+    Kolab::MIMEObject kmimeObject;
+    QVERIFY(kmimeObject.parseMimeMessage(msg) != Kolab::InvalidObject);
+    Kolab::MIMEObject scannedObject;
+    QCOMPARE(scannedObject.parseMessage(std::string(data.constData(), data.size())), kmimeObject.getType());
+    QVERIFY(sameObject(scannedObject, kmimeObject));
+
+    const QByteArray crlf = KMime::LFtoCRLF(data);
+    QVERIFY(Kolab::Mime::Scanner(crlf).isValid());
+    Kolab::MIMEObject crlfObject;
+    QCOMPARE(crlfObject.parseMessage(std::string(crlf.constData(), crlf.size())), kmimeObject.getType());
+    QVERIFY(sameObject(crlfObject, kmimeObject));
+}
+
+void KolabObjectTest::rawScannerFallback()
+{
+    Kolab::Event event;
+    event.setUid("uid");
+    event.setStart(Kolab::cDateTime(2012,11,11,1,1,0,true));
+    Kolab::Attachment attachment;
+    attachment.setData(std::string("attachment\0data", 15), "application/octet-stream");
+    attachment.setLabel("label");
+    event.setAttachments(std::vector<Kolab::Attachment>() << attachment);
+    const QByteArray data = Kolab::KolabObjectWriter::writeEvent(event)->encodedContent();
+
+    const Kolab::Mime::Scanner scanner(data);
+    QVERIFY(scanner.isValid());
+    QCOMPARE(scanner.parts().size(), 3);
+    const Kolab::Mime::Scanner::Part &attachmentPart = scanner.parts().last();
+    QVERIFY(scanner.findById(attachmentPart.contentId));
+    QCOMPARE(attachmentPart.encoding, QByteArray("base64"));
+    QCOMPARE(attachmentPart.name, QString::fromLatin1("label"));
+    std::string decoded;
+    scanner.decode(attachmentPart, decoded);
+    QCOMPARE(decoded, attachment.data());
+
+    //Without the closing boundary the message is parsed by KMime
+    const QByteArray truncated = data.left(data.lastIndexOf("--"));
+    QVERIFY(!Kolab::Mime::Scanner(truncated).isValid());
+    //Nested multiparts are not supported by the scanner
+    QByteArray nested = data;
+    nested.replace("Content-Type: application/octet-stream", "Content-Type: multipart/alternative");
+    QVERIFY(!Kolab::Mime::Scanner(nested).isValid());
+    QVERIFY(!Kolab::Mime::Scanner("Subject: no multipart\n\nbody").isValid());
+
+    //v2 messages are read with KMime
+    QFile file(TESTFILEDIR+QString::fromLatin1("v2/event/complex.ics.mime"));
+    QVERIFY(file.open(QFile::ReadOnly));
+    const QByteArray v2 = file.readAll();
+    Kolab::MIMEObject mimeObject;
+    QCOMPARE(mimeObject.parseMessage(std::string(v2.constData(), v2.size())), Kolab::EventObject);
+    QCOMPARE(mimeObject.getVersion(), Kolab::KolabV2);
+
+    //A document that can't be read is reported as with KMime
+    QFile v3File(TESTFILEDIR+QString::fromLatin1("v3/event/simple.ics.mime"));
+    QVERIFY(v3File.open(QFile::ReadOnly));
+    QByteArray broken = v3File.readAll();
+    broken.replace("<vcalendar>", "<vcalendar><broken");
+    QVERIFY(Kolab::Mime::Scanner(broken).isValid());
+    Kolab::MIMEObject brokenObject;
+    QCOMPARE(brokenObject.parseMessage(std::string(broken.constData(), broken.size())), Kolab::InvalidObject);
+    QCOMPARE(brokenObject.getType(), Kolab::InvalidObject);
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Critical);
+}
+
+void KolabObjectTest::rawReader_data()
+{
+    QTest::addColumn<QString>("filename");
+    foreach (const QString &version, QStringList() << QLatin1String("v2") << QLatin1String("v3")) {
+        QDirIterator it(TESTFILEDIR+version, QStringList() << QLatin1String("*.mime"), QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString filename = it.next();
+            QTest::newRow(filename.mid(TESTFILEDIR.size()).toLatin1()) << filename;
+        }
+    }
+}
+
+void KolabObjectTest::rawReader()
+{
+    QFETCH(QString, filename);
+    QFile file(filename);
+    QVERIFY(file.open(QFile::ReadOnly));
+    const QByteArray data = file.readAll();
+
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent(KMime::CRLFtoLF(data));
+    msg->parse();
+    Kolab::KolabObjectReader kmimeReader;
+    const Kolab::ObjectType type = kmimeReader.parseMimeMessage(msg);
+    const Kolab::ErrorHandler::Severity severity = Kolab::ErrorHandler::instance().error();
+
+    //Regular messages are read from the raw message, the result is the same
+    Kolab::KolabObjectReader rawReader;
+    QCOMPARE(rawReader.parseMessage(data), type);
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), severity);
+    QCOMPARE(rawReader.getVersion(), kmimeReader.getVersion());
+    switch (type) {
+        case Kolab::EventObject:
+        case Kolab::TodoObject:
+        case Kolab::JournalObject:
+            QVERIFY(rawReader.getIncidence());
+            QVERIFY(*rawReader.getIncidence() == *kmimeReader.getIncidence());
+            break;
+        case Kolab::ContactObject:
+            QVERIFY(rawReader.getContact() == kmimeReader.getContact());
+            break;
+        case Kolab::DistlistObject:
+            QVERIFY(rawReader.getDistlist() == kmimeReader.getDistlist());
+            break;
+        case Kolab::NoteObject:
+            QVERIFY(rawReader.getNote());
+            QCOMPARE(rawReader.getNote()->subject()->asUnicodeString(), kmimeReader.getNote()->subject()->asUnicodeString());
+            QCOMPARE(rawReader.getNote()->date()->dateTime(), kmimeReader.getNote()->date()->dateTime());
+            QCOMPARE(rawReader.getNote()->decodedContent(), kmimeReader.getNote()->decodedContent());
+            break;
+        default:
+            break;
+    }
+}
+
+void KolabObjectTest::codecs()
+{
+    QByteArray binary;
+    for (int i = 0; i < 10000; i++) {
+        binary.append(static_cast<char>((i * 7) % 256));
+    }
+    QByteArray text("<xml attr=\"value\">trailing space \nline\r\n");
+    text += QByteArray(200, 'x') + "\ttab\t\n=equals= \xc3\xa4 end ";
+    const QByteArray expectedText = KMime::CRLFtoLF(text) + '\n';
+    KMime::Codec *base64Codec = KMime::Codec::codecForName("base64");
+    KMime::Codec *qpCodec = KMime::Codec::codecForName("quoted-printable");
+
+    const Kolab::Mime::Codecs::Implementation initial = Kolab::Mime::Codecs::implementation();
+    QList<Kolab::Mime::Codecs::Implementation> implementations;
+    implementations << Kolab::Mime::Codecs::Scalar;
+    if (Kolab::Mime::Codecs::setImplementation(Kolab::Mime::Codecs::SSE2)) {
+        implementations << Kolab::Mime::Codecs::SSE2;
+    }
+    foreach (Kolab::Mime::Codecs::Implementation implementation, implementations) {
+        QVERIFY(Kolab::Mime::Codecs::setImplementation(implementation));
+
+        QByteArray encoded;
+        Kolab::Mime::Codecs::encodeBase64(binary.constData(), binary.size(), false, encoded);
+        QCOMPARE(base64Codec->decode(encoded), binary);
+        foreach (const QByteArray &line, encoded.split('\n')) {
+            QVERIFY(line.size() <= 76);
+        }
+        QByteArray decoded;
+        decoded.resize(Kolab::Mime::Codecs::maxDecodedBase64Size(encoded.size()));
+        decoded.resize(Kolab::Mime::Codecs::decodeBase64(encoded.constData(), encoded.size(), decoded.data()));
+        QCOMPARE(decoded, binary);
+        const QByteArray kmimeEncoded = base64Codec->encode(binary);
+        decoded.resize(Kolab::Mime::Codecs::maxDecodedBase64Size(kmimeEncoded.size()));
+        decoded.resize(Kolab::Mime::Codecs::decodeBase64(kmimeEncoded.constData(), kmimeEncoded.size(), decoded.data()));
+        QCOMPARE(decoded, binary);
+
+        encoded.clear();
+        Kolab::Mime::Codecs::encodeQuotedPrintable(text.constData(), text.size(), false, encoded);
+        QCOMPARE(qpCodec->decode(encoded), expectedText);
+        foreach (const QByteArray &line, encoded.split('\n')) {
+            QVERIFY(line.size() <= 76);
+            QVERIFY(!line.endsWith(' ') && !line.endsWith('\t'));
+        }
+        decoded.resize(encoded.size());
+        decoded.resize(Kolab::Mime::Codecs::decodeQuotedPrintable(encoded.constData(), encoded.size(), decoded.data()));
+        QCOMPARE(decoded, expectedText);
+        const QByteArray kmimeQp = qpCodec->encode(text);
+        decoded.resize(kmimeQp.size());
+        decoded.resize(Kolab::Mime::Codecs::decodeQuotedPrintable(kmimeQp.constData(), kmimeQp.size(), decoded.data()));
+        QCOMPARE(decoded, qpCodec->decode(kmimeQp));
+
+        QByteArray crlfEncoded;
+        Kolab::Mime::Codecs::encodeQuotedPrintable(text.constData(), text.size(), true, crlfEncoded);
+        QCOMPARE(crlfEncoded, KMime::LFtoCRLF(encoded));
+    }
+
+    //The blocks of the SSE2 codec produce the same output as the scalar code, whatever the position of the last line break
+    if (implementations.contains(Kolab::Mime::Codecs::SSE2)) {
+        for (int size = 0; size < 200; size++) {
+            QByteArray scalar;
+            Kolab::Mime::Codecs::setImplementation(Kolab::Mime::Codecs::Scalar);
+            Kolab::Mime::Codecs::encodeBase64(binary.constData() + size, size, true, scalar);
+            QByteArray sse2;
+            Kolab::Mime::Codecs::setImplementation(Kolab::Mime::Codecs::SSE2);
+            Kolab::Mime::Codecs::encodeBase64(binary.constData() + size, size, true, sse2);
+            QCOMPARE(sse2, scalar);
+            QByteArray decoded;
+            decoded.resize(Kolab::Mime::Codecs::maxDecodedBase64Size(sse2.size()));
+            decoded.resize(Kolab::Mime::Codecs::decodeBase64(sse2.constData(), sse2.size(), decoded.data()));
+            QCOMPARE(decoded, binary.mid(size, size));
+        }
+    }
+    Kolab::Mime::Codecs::setImplementation(initial);
+}
+
+void KolabObjectTest::mainPartEncoding()
+{
+    const QByteArray ascii("<xml>\n  <text>ascii</text>\n</xml>\n");
+    const QByteArray latin = QString::fromUtf8("<xml>\n  <text>Gr\xc3\xbc\xc3\x9fe aus Z\xc3\xbcrich, a longer text with only a few umlauts</text>\n</xml>\n").toUtf8();
+    QByteArray cyrillic("<xml>\n  <text>");
+    for (int i = 0; i < 50; i++) {
+        cyrillic += "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 ";
+    }
+    cyrillic += "</text>\n</xml>\n";
+    const QByteArray longLine = "<xml>" + QByteArray(2000, 'x') + "</xml>";
+
+    QCOMPARE(Kolab::Mime::mainPartEncoding(), Kolab::Mime::AutomaticEncoding);
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(ascii.constData(), ascii.size()), KMime::Headers::CE7Bit);
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(latin.constData(), latin.size()), KMime::Headers::CEquPr);
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(cyrillic.constData(), cyrillic.size()), KMime::Headers::CEbase64);
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(longLine.constData(), longLine.size()), KMime::Headers::CEquPr);
+    const QByteArray trailing("<xml> \n</xml>");
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(trailing.constData(), trailing.size()), KMime::Headers::CEquPr);
+
+    Kolab::Mime::setMainPartEncoding(Kolab::Mime::EightBitEncoding);
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(cyrillic.constData(), cyrillic.size()), KMime::Headers::CE8Bit);
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(longLine.constData(), longLine.size()), KMime::Headers::CEquPr);
+    Kolab::Mime::setMainPartEncoding(Kolab::Mime::QuotedPrintableEncoding);
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(ascii.constData(), ascii.size()), KMime::Headers::CEquPr);
+    Kolab::Mime::setMainPartEncoding(Kolab::Mime::AutomaticEncoding);
+
+    //Unencoded bodies that already have CRLF line endings are not converted twice
+    const QByteArray crlfBody = KMime::LFtoCRLF(ascii);
+    QCOMPARE(Kolab::Mime::chooseMainPartEncoding(crlfBody.constData(), crlfBody.size()), KMime::Headers::CE7Bit);
+    QByteArray encodedLf;
+    Kolab::Mime::encodeBody(crlfBody.constData(), crlfBody.size(), KMime::Headers::CE7Bit, false, encodedLf);
+    QCOMPARE(encodedLf, ascii + '\n');
+    QByteArray encodedCrlf;
+    Kolab::Mime::encodeBody(crlfBody.constData(), crlfBody.size(), KMime::Headers::CE7Bit, true, encodedCrlf);
+    QCOMPARE(encodedCrlf, crlfBody + "\r\n");
+
+    //The chosen encoding is used by both writers and read back
+    Kolab::Event event;
+    event.setUid("uid");
+    event.setStart(Kolab::cDateTime(2012,11,11,1,1,0,true));
+    event.setSummary(std::string(cyrillic.constData() + 14, 13 * 50));
+    const KMime::Message::Ptr msg = Kolab::KolabObjectWriter::writeEvent(event);
+    KMime::Content *xmlPart = Kolab::Mime::findContentByType(msg, MIME_TYPE_XCAL);
+    QVERIFY(xmlPart);
+    QCOMPARE(xmlPart->contentTransferEncoding()->encoding(), KMime::Headers::CEbase64);
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(Kolab::KolabObjectWriter::writeEvent(event, &buffer));
+    QVERIFY(data.contains("Content-Transfer-Encoding: base64"));
+    foreach (const QByteArray &raw, QList<QByteArray>() << msg->encodedContent() << data) {
+        Kolab::MIMEObject mimeObject;
+        QCOMPARE(mimeObject.parseMessage(std::string(raw.constData(), raw.size())), Kolab::EventObject);
+        QCOMPARE(mimeObject.getEvent().summary(), event.summary());
+    }
+}
+
+static QList<QByteArray> headerNames(const QByteArray &data)
+{
+    QList<QByteArray> names;
+    foreach (const QByteArray &line, data.left(data.indexOf("\n\n")).split('\n')) {
+        names << line.left(line.indexOf(':'));
+    }
+    return names;
+}
+
+void KolabObjectTest::messageSkeleton()
+{
+    Kolab::Contact contact;
+    contact.setUid("uid");
+    contact.setName(std::string("Name \xc3\xa4"));
+    contact.setEmailAddresses(std::vector<std::string>() << std::string("contact@example.com"), 0);
+
+    const KMime::Message::Ptr msg = Kolab::KolabObjectWriter::writeContact(contact);
+    QVERIFY(msg);
+    const QByteArray encoded = msg->encodedContent();
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(Kolab::KolabObjectWriter::writeContact(contact, &buffer));
 
+    //Both writers splice in the same explanation part and header
+    QCOMPARE(headerNames(data), headerNames(encoded));
+    foreach (const QByteArray &raw, QList<QByteArray>() << encoded << data) {
+        QVERIFY(raw.contains(Kolab::Mime::encodedExplanationPart()));
+        KMime::Message::Ptr parsed(new KMime::Message);
+        parsed->setContent(raw);
+        parsed->parse();
+        QCOMPARE(parsed->contents().size(), 2);
+        QCOMPARE(parsed->contents().first()->contentType()->mimeType(), QByteArray("text/plain"));
+        QCOMPARE(parsed->from()->asUnicodeString(), QString::fromUtf8("Name \xc3\xa4 <contact@example.com>"));
+        QVERIFY(parsed->date()->dateTime().isValid());
+        Kolab::MIMEObject mimeObject;
+        QCOMPARE(mimeObject.parseMessage(std::string(raw.constData(), raw.size())), Kolab::ContactObject);
+        QCOMPARE(mimeObject.getVersion(), Kolab::KolabV3);
+        QCOMPARE(mimeObject.getContact().name(), contact.name());
+    }
 
+    //The frozen explanation part still has headers for readers of the unparsed message
+    QCOMPARE(msg->contents().first()->contentType()->mimeType(), QByteArray("text/plain"));
+    const QByteArray explanation = Kolab::Mime::encodedExplanationPart();
+    QCOMPARE(msg->contents().first()->body(), explanation.mid(explanation.indexOf("\n\n") + 2));
+}
+
+void KolabObjectTest::v2StreamLoader()
+{
+    bool ok;
+    const KMime::Message::Ptr msg = readMimeFile(TESTFILEDIR+QString::fromLatin1("v2/event/complex.ics.mime"), ok);
+    QVERIFY(ok);
+    KMime::Content *xmlContent = Kolab::Mime::findContentByType(msg, "application/x-vnd.kolab.event");
+    QVERIFY(xmlContent);
+    const QByteArray xml = xmlContent->decodedContent();
+
+    //The stream loader fills the same incidence as the DOM loader
+    const KCalCore::Event::Ptr dom = KolabV2::Event::fromXml(KolabV2::KolabBase::loadDocument(QString::fromUtf8(xml)), QString());
+    QStringList attachments;
+    const KCalCore::Event::Ptr stream = KolabV2::Event::fromXml(xml, QString(), attachments);
+    QVERIFY(stream);
+    QVERIFY(*stream == *dom);
+    QCOMPARE(attachments, QStringList() << QString::fromLatin1("akonadi.png"));
+
+    //Malformed and mismatching documents are rejected
+    attachments.clear();
+    QVERIFY(!KolabV2::Event::fromXml(xml.left(xml.size() / 2), QString(), attachments));
+    QVERIFY(!KolabV2::Task::fromXml(xml, QString(), attachments));
+
+    //The readers report them as critical errors
+    Kolab::ErrorHandler::setOutputEnabled(false);
+    Kolab::ErrorHandler::clearErrors();
+    QVERIFY(!Kolab::fromXML<KCalCore::Event::Ptr, KolabV2::Event>(xml.left(xml.size() / 2), attachments));
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Critical);
+    Kolab::ErrorHandler::clearErrors();
+    QVERIFY(!Kolab::fromXML<KCalCore::Todo::Ptr, KolabV2::Task>(xml, attachments));
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Critical);
+    Kolab::ErrorHandler::clearErrors();
+    Kolab::ErrorHandler::setOutputEnabled(true);
+}
+
+void KolabObjectTest::v2JournalAttachment()
+{
+    QFile file(TESTFILEDIR+QString::fromLatin1("v2/journal/simple.ics.mime"));
+    QVERIFY(file.open(QFile::ReadOnly));
+    QByteArray data = file.readAll();
+    data.replace("</journal>", " <inline-attachment>note.txt</inline-attachment>\n</journal>");
+    data.replace("--nextPart5948088.KInc4Inoe4--",
+                 "--nextPart5948088.KInc4Inoe4\n"
+                 "Content-Type: text/plain; name=\"note.txt\"\n"
+                 "Content-Transfer-Encoding: base64\n"
+                 "Content-Disposition: attachment; filename=\"note.txt\"\n"
+                 "\n"
+                 "YXR0YWNobWVudA==\n"
+                 "\n"
+                 "--nextPart5948088.KInc4Inoe4--");
+
+    //Journals record the names of their inline attachments like the other incidences
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent(data);
+    msg->parse();
+    KMime::Content *xmlContent = Kolab::Mime::findContentByType(msg, "application/x-vnd.kolab.journal");
+    QVERIFY(xmlContent);
+    QStringList attachments;
+    QVERIFY(KolabV2::Journal::fromXml(xmlContent->decodedContent(), QString(), attachments));
+    QCOMPARE(attachments, QStringList() << QString::fromLatin1("note.txt"));
+
+    Kolab::KolabObjectReader kmimeReader;
+    QCOMPARE(kmimeReader.parseMimeMessage(msg), Kolab::JournalObject);
+    Kolab::KolabObjectReader rawReader;
+    QCOMPARE(rawReader.parseMessage(data), Kolab::JournalObject);
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Debug);
+    foreach (const KCalCore::Journal::Ptr &journal, QList<KCalCore::Journal::Ptr>() << kmimeReader.getJournal() << rawReader.getJournal()) {
+        QVERIFY(journal);
+        QCOMPARE(journal->attachments().size(), 1);
+        QCOMPARE(journal->attachments().first()->label(), QString::fromLatin1("note.txt"));
+        QCOMPARE(journal->attachments().first()->mimeType(), QString::fromLatin1("text/plain"));
+        QCOMPARE(journal->attachments().first()->decodedData(), QByteArray("attachment"));
+    }
+}
+
+/**
+ * Builds a DOM from the calls of the writer, as the former DOM based writer did.
+ */
+class DomWriter : public KolabV2::XmlWriter
+{
+public:
+    DomWriter()
+    {
+        mDocument.appendChild(mDocument.createProcessingInstruction("xml", "version=\"1.0\" encoding=\"UTF-8\""));
+    }
+
+    virtual void writeStartElement(const QString &tag)
+    {
+        const QDomElement element = mDocument.createElement(tag);
+        if (mCurrent.isNull()) {
+            mDocument.appendChild(element);
+        } else {
+            mCurrent.appendChild(element);
+        }
+        mCurrent = element;
+    }
+
+    virtual void writeAttribute(const QString &name, const QString &value)
+    {
+        mCurrent.setAttribute(name, value);
+    }
+
+    virtual void writeCharacters(const QString &text)
+    {
+        mCurrent.appendChild(mDocument.createTextNode(text));
+    }
+
+    virtual void writeEndElement()
+    {
+        mCurrent = mCurrent.parentNode().toElement();
+    }
+
+    /**
+     * The output of the former saveXML()
+     */
+    QByteArray domXml() const
+    {
+        return mDocument.toString().toUtf8();
+    }
+
+private:
+    QDomDocument mDocument;
+    QDomElement mCurrent;
+};
+
+static void compareWithDom(const KolabV2::KolabBase &object)
+{
+    DomWriter domWriter;
+    object.saveXML(domWriter);
+    QCOMPARE(object.saveXML(), domWriter.domXml());
+}
+
+void KolabObjectTest::v2Writer_data()
+{
+    QTest::addColumn<QString>("filename");
+    QDirIterator it(TESTFILEDIR+QString::fromLatin1("v2"), QStringList() << QLatin1String("*.mime"), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString filename = it.next();
+        QTest::newRow(filename.mid(TESTFILEDIR.size()).toLatin1()) << filename;
+    }
+    //There are no v2 distribution lists and notes in the corpus, the v3 ones are written as v2 instead
+    QTest::newRow("v3/contacts/distlist.vcf.mime") << TESTFILEDIR+QString::fromLatin1("v3/contacts/distlist.vcf.mime");
+    QTest::newRow("v3/note/note.mime.mime") << TESTFILEDIR+QString::fromLatin1("v3/note/note.mime.mime");
+}
+
+void KolabObjectTest::v2Writer()
+{
+    QFETCH(QString, filename);
+    bool ok;
+    const KMime::Message::Ptr msg = readMimeFile(filename, ok);
+    QVERIFY(ok);
+    Kolab::KolabObjectReader reader;
+    const Kolab::ObjectType type = reader.parseMimeMessage(msg);
+
+    //The writer produces the same bytes as QDom for the same object, including text and attribute values that need escaping
+    const QString text = QString::fromUtf8("<summary> & \"quotes\" ]]> \xc3\xa4\xc3\xb6\xc3\xbc\rreturn");
+    const QString attribute = QLatin1String("line\nbreak\ttab \"quotes\" <&>\r");
+    switch (type) {
+        case Kolab::EventObject: {
+            const KCalCore::Event::Ptr event = reader.getEvent();
+            QVERIFY(event);
+            compareWithDom(KolabV2::Event(QString(), event));
+            event->setSummary(text);
+            event->setNonKDECustomProperty("X-TEST", attribute);
+            compareWithDom(KolabV2::Event(QString(), event));
+
+            QStringList attachments;
+            const KCalCore::Event::Ptr read = KolabV2::Event::fromXml(KolabV2::Event::eventToXML(event, QString()), QString(), attachments);
+            QVERIFY(read);
+            QCOMPARE(read->summary(), event->summary());
+            QCOMPARE(read->nonKDECustomProperty("X-TEST"), event->nonKDECustomProperty("X-TEST"));
+            QCOMPARE(read->recurrence()->recurrenceType(), event->recurrence()->recurrenceType());
+        }
+            break;
+        case Kolab::TodoObject: {
+            const KCalCore::Todo::Ptr todo = reader.getTodo();
+            QVERIFY(todo);
+            compareWithDom(KolabV2::Task(QString(), todo));
+            todo->setSummary(text);
+            todo->setNonKDECustomProperty("X-TEST", attribute);
+            compareWithDom(KolabV2::Task(QString(), todo));
+        }
+            break;
+        case Kolab::JournalObject: {
+            const KCalCore::Journal::Ptr journal = reader.getJournal();
+            QVERIFY(journal);
+            compareWithDom(KolabV2::Journal(QString(), journal));
+            journal->setSummary(text);
+            compareWithDom(KolabV2::Journal(QString(), journal));
+        }
+            break;
+        case Kolab::ContactObject: {
+            KABC::Addressee addressee = reader.getContact();
+            compareWithDom(KolabV2::Contact(&addressee));
+            //x-custom elements have several attributes
+            addressee.setNote(text);
+            addressee.insertCustom(QLatin1String("KADDRESSBOOK"), QLatin1String("X-Test"), attribute);
+            compareWithDom(KolabV2::Contact(&addressee));
+        }
+            break;
+        case Kolab::DistlistObject: {
+            KABC::ContactGroup contactGroup = reader.getDistlist();
+            compareWithDom(KolabV2::DistributionList(&contactGroup));
+            contactGroup.setName(text);
+            compareWithDom(KolabV2::DistributionList(&contactGroup));
+        }
+            break;
+        case Kolab::NoteObject: {
+            const Akonadi::NoteUtils::NoteMessageWrapper wrapper(reader.getNote());
+            KolabV2::Note note;
+            note.setSummary(wrapper.title());
+            note.setBody(wrapper.text());
+            compareWithDom(note);
+            note.setSummary(text);
+            compareWithDom(note);
+        }
+            break;
+        default:
+            QFAIL("unexpected object type");
+    }
+}
+
+void KolabObjectTest::v2ContactPicture()
+{
+    bool ok;
+    const KMime::Message::Ptr msg = readMimeFile(TESTFILEDIR+QString::fromLatin1("v2/contacts/picture.vcf.mime"), ok);
+    QVERIFY(ok);
+    QByteArray type;
+    KMime::Content *pictureContent = Kolab::Mime::findContentByName(msg, QLatin1String("kolab-picture.png"), type);
+    QVERIFY(pictureContent);
+    const QByteArray picture = pictureContent->decodedContent();
+
+    KMime::Content *xmlContent = Kolab::Mime::findContentByType(msg, "application/x-vnd.kolab.contact");
+    QVERIFY(xmlContent);
+
+    const KABC::Addressee addressee = Kolab::addresseeFromKolab(xmlContent->decodedContent(), msg);
+    QVERIFY(!addressee.photo().isEmpty());
+
+    KolabV2::Contact contact(&addressee);
+    QVERIFY(contact.hasPicture());
+    const KMime::Message::Ptr written = Kolab::contactToKolabFormat(contact, QLatin1String("test"));
+    KMime::Content *writtenContent = Kolab::Mime::findContentByName(written, QLatin1String("kolab-picture.png"), type);
+    QVERIFY(writtenContent);
+    QCOMPARE(type, QByteArray("image/png"));
+#ifdef KABC_PICTURE_RAWDATA
+    //The encoded picture is passed through unchanged
+    QCOMPARE(writtenContent->decodedContent(), picture);
+#else
+    //Without raw data in KABC::Picture the picture is decoded and encoded again
+    QCOMPARE(QImage::fromData(writtenContent->decodedContent()), QImage::fromData(picture));
+#endif
+
+    //Setting an image replaces the encoded picture
+    contact.setPicture(contact.picture(), QLatin1String("image/png"));
+    QVERIFY(contact.pictureData().isEmpty());
+    QVERIFY(contact.hasPicture());
+}
 
 QTEST_MAIN( KolabObjectTest )
 
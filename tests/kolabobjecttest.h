@@ -27,6 +27,31 @@ private slots:
     void preserveUnicode();
     void dontCrashWithEmptyOrganizer();
     void dontCrashWithEmptyIncidence();
+    void batchReader();
+    void peekObjectHeaders_data();
+    void peekObjectHeaders();
+    void mimeObjectReader();
+    void nativeWriter();
+    void streamWriter();
+    void threadLocalErrors();
+    void logThreshold();
+    void errorBuffer();
+    void partIndex();
+    void base64PassThrough();
+    void spilledAttachments();
+    void rawScanner_data();
+    void rawScanner();
+    void rawScannerFallback();
+    void rawReader_data();
+    void rawReader();
+    void codecs();
+    void mainPartEncoding();
+    void messageSkeleton();
+    void v2StreamLoader();
+    void v2JournalAttachment();
+    void v2Writer_data();
+    void v2Writer();
+    void v2ContactPicture();
 };
 
 #endif // KOLABOBJECTTEST_H
@@ -17,6 +17,7 @@
 
 #include "timezonetest.h"
 #include <conversion/timezoneconverter.h>
+#include <conversion/commonconversion.h>
 #include <kolabformat/kolabobject.h>
 #include <kolabformat/errorhandler.h>
 #include "testutils.h"
@@ -145,6 +146,42 @@ void TimezoneTest::testKolabObjectReader()
     QVERIFY( *(realIncidence.data()) ==  *(convertedIncidence.data()) );
 }
 
+void TimezoneTest::testTimeSpecCache()
+{
+    using namespace Kolab::Conversion;
+    clearTimeSpecCache();
+    const KDateTime::Spec &spec = getTimeSpec(false, "Europe/Zurich");
+    QCOMPARE(spec.timeZone().name(), QLatin1String("Europe/Zurich"));
+    QCOMPARE(timeSpecCacheMisses(), 1);
+    QCOMPARE(getTimeSpec(false, "Europe/Zurich"), spec);
+    QCOMPARE(timeSpecCacheHits(), 1);
+
+    //UTC and floating times don't need a lookup
+    getTimeSpec(true, std::string());
+    getTimeSpec(false, std::string());
+    QCOMPARE(timeSpecCacheMisses(), 1);
+    QCOMPARE(timeSpecCacheHits(), 1);
+
+    //Aliases are cached with their normalized timezone
+    QCOMPARE(getTimeSpec(false, "W. Europe Standard Time").timeZone().name(), QLatin1String("Europe/Berlin"));
+    QCOMPARE(getTimeSpec(false, "W. Europe Standard Time").timeZone().name(), QLatin1String("Europe/Berlin"));
+    QCOMPARE(timeSpecCacheMisses(), 2);
+    QCOMPARE(timeSpecCacheHits(), 2);
+
+    //With ktimezoned unknown timezones are cached as well, but still reported on every use
+    getTimeSpec(false, "Unknown/Timezone");
+    Kolab::ErrorHandler::clearErrors();
+    QCOMPARE(getTimeSpec(false, "Unknown/Timezone"), KDateTime::Spec(KTimeZone::utc()));
+    QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Error);
+    QCOMPARE(timeSpecCacheMisses(), 3);
+    QCOMPARE(timeSpecCacheHits(), 3);
+    Kolab::ErrorHandler::clearErrors();
+
+    clearTimeSpecCache();
+    QCOMPARE(timeSpecCacheMisses(), 0);
+    QCOMPARE(timeSpecCacheHits(), 0);
+}
+
 QTEST_MAIN( TimezoneTest )
 
 #include "timezonetest.moc"
@@ -28,6 +28,7 @@ private slots:
     void testFromHardcodedList();
     void testKolabObjectWriter();
     void testKolabObjectReader();
+    void testTimeSpecCache();
 };
 
 #endif // TIMEZONETEST_H
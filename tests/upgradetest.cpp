@@ -19,12 +19,15 @@
 #include "upgradetest.h"
 
 #include <QTest>
+#include <QDir>
+#include <QFile>
 #include <kolabcontainers.h>
 #include <kolabformat.h>
 #include <kolabformat/errorhandler.h>
 
 #include "testutils.h"
 #include "kolabformat/kolabobject.h"
+#include "upgrade/upgrade.h"
 #include <conversion/commonconversion.h>
 #include <kcalcore/icalformat.h>
 #include <kabc/vcardconverter.h>
@@ -181,6 +184,61 @@ void UpgradeTest::testContact()
     QCOMPARE(Kolab::ErrorHandler::instance().error(), Kolab::ErrorHandler::Debug);
 }
 
+static void removeDir(const QString &path)
+{
+    QDir dir(path);
+    foreach (const QFileInfo &info, dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot)) {
+        if (info.isDir()) {
+            removeDir(info.filePath());
+        } else {
+            QFile::remove(info.filePath());
+        }
+    }
+    dir.rmdir(path);
+}
+
+void UpgradeTest::testMaildir()
+{
+    const QString base = QDir::tempPath() + QString::fromLatin1("/libkolab-upgradetest");
+    removeDir(base);
+    const QString source = base + QString::fromLatin1("/source");
+    const QString target = base + QString::fromLatin1("/target");
+    QVERIFY(QDir().mkpath(source + QString::fromLatin1("/cur")));
+    QVERIFY(QDir().mkpath(source + QString::fromLatin1("/new")));
+
+    QVERIFY(QFile::copy(TESTFILEDIR+QString::fromLatin1("v2/event/complex.ics.mime"), source + QString::fromLatin1("/cur/1:2,S")));
+    QVERIFY(QFile::copy(TESTFILEDIR+QString::fromLatin1("v2/task/complex.ics.mime"), source + QString::fromLatin1("/cur/2:2,S")));
+    QVERIFY(QFile::copy(TESTFILEDIR+QString::fromLatin1("v2/contacts/complex.vcf.mime"), source + QString::fromLatin1("/new/3")));
+    QVERIFY(QFile::copy(TESTFILEDIR+QString::fromLatin1("v3/event/simple.ics.mime"), source + QString::fromLatin1("/new/4")));
+    //Same unique name as a message in cur
+    QVERIFY(QFile::copy(TESTFILEDIR+QString::fromLatin1("v2/journal/simple.ics.mime"), source + QString::fromLatin1("/new/1")));
+    QFile garbage(source + QString::fromLatin1("/new/5"));
+    QVERIFY(garbage.open(QIODevice::WriteOnly));
+    garbage.write("Subject: not a kolab object\n\nbody\n");
+    garbage.close();
+
+    Kolab::Upgrade::MaildirUpgrader upgrader(source, target);
+    upgrader.setThreadCount(4);
+    QVERIFY(upgrader.run());
+    QCOMPARE(upgrader.messageCount(), 6);
+    QCOMPARE(upgrader.failedCount(), 1);
+    QCOMPARE(upgrader.severityCounts().value(Kolab::ErrorHandler::Debug), 5);
+
+    //The messages from new get the info of cur, and none overwrites another
+    QStringList written = QDir(target + QString::fromLatin1("/cur")).entryList(QDir::Files, QDir::Name);
+    QCOMPARE(written, QStringList() << QString::fromLatin1("1-1:2,") << QString::fromLatin1("1:2,S") << QString::fromLatin1("2:2,S") << QString::fromLatin1("3:2,") << QString::fromLatin1("4:2,"));
+    QVERIFY(QDir(target + QString::fromLatin1("/tmp")).entryList(QDir::Files).isEmpty());
+
+    foreach (const QString &file, written) {
+        bool ok = false;
+        const KMime::Message::Ptr &msg = readMimeFile(target + QString::fromLatin1("/cur/") + file, ok);
+        QVERIFY(ok);
+        Kolab::KolabObjectReader reader;
+        QVERIFY(reader.parseMimeMessage(msg) != Kolab::InvalidObject);
+        QCOMPARE(reader.getVersion(), Kolab::KolabV3);
+    }
+    removeDir(base);
+}
 
 QTEST_MAIN( UpgradeTest )
 
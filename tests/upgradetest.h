@@ -43,6 +43,8 @@ private slots:
     
     void testContact_data();
     void testContact();
+
+    void testMaildir();
 };
 
 #endif // UPGRADETEST_H
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <iostream>
+#include "upgrade.h"
+
+static const char *severityName(Kolab::ErrorHandler::Severity severity)
+{
+    switch (severity) {
+        case Kolab::ErrorHandler::Debug:
+            return "ok";
+        case Kolab::ErrorHandler::Warning:
+            return "warning";
+        case Kolab::ErrorHandler::Error:
+            return "error";
+        case Kolab::ErrorHandler::Critical:
+            return "critical";
+    }
+    return "";
+}
+
+static int usage()
+{
+    std::cerr << "Usage: kolab-upgrade [-j threads] <source maildir> <target maildir>" << std::endl;
+    return 2;
+}
+
+/**
+ * Upgrades a maildir with Kolab v2 objects to Kolab v3.
+ *
+ * kolab-upgrade [-j threads] <source maildir> <target maildir>
+ *
+ * The messages are upgraded by one thread per core unless -j is given.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    args.removeFirst();
+
+    int threads = 0;
+    if (args.size() >= 2 && args.first() == QLatin1String("-j")) {
+        bool ok = false;
+        threads = args.at(1).toInt(&ok);
+        if (!ok || threads < 1) {
+            return usage();
+        }
+        args = args.mid(2);
+    }
+    if (args.size() != 2) {
+        return usage();
+    }
+
+    Kolab::Upgrade::MaildirUpgrader upgrader(args.at(0), args.at(1));
+    if (threads) {
+        upgrader.setThreadCount(threads);
+    }
+    upgrader.setProductId(QLatin1String("kolab-upgrade"));
+    if (!upgrader.run()) {
+        std::cerr << "failed to create " << args.at(1).toLocal8Bit().constData() << std::endl;
+        return 1;
+    }
+
+    foreach (const Kolab::Upgrade::Result &result, upgrader.results()) {
+        if (result.severity == Kolab::ErrorHandler::Debug && result.written) {
+            continue;
+        }
+        std::cout << result.fileName.toLocal8Bit().constData() << ": " << severityName(result.severity) << (result.written ? "" : ", not written") << std::endl;
+        foreach (const QString &error, result.errors) {
+            std::cout << "    " << error.toLocal8Bit().constData() << std::endl;
+        }
+    }
+
+    std::cout << upgrader.messageCount() << " messages, " << upgrader.failedCount() << " failed, "
+              << upgrader.elapsed() << " ms, " << upgrader.throughput() << " messages/s" << std::endl;
+    const QMap<Kolab::ErrorHandler::Severity, int> counts = upgrader.severityCounts();
+    for (QMap<Kolab::ErrorHandler::Severity, int>::const_iterator it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        std::cout << "    " << severityName(it.key()) << ": " << it.value() << std::endl;
+    }
+    return upgrader.failedCount() ? 1 : 0;
+}
@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "upgrade.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QVector>
+#include <QTime>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <kmime/kmime_message.h>
+#include <kmime/kmime_codecs.h>
+#include <kmime/kmime_util.h>
+#include <ksystemtimezone.h>
+#include "kolabformat/kolabobject.h"
+#include "conversion/kabcconversion.h"
+
+namespace Kolab {
+    namespace Upgrade {
+
+static void collectErrors(Result &result)
+{
+    foreach (const ErrorHandler::Err &error, ErrorHandler::instance().getErrors()) {
+        result.errors.append(error.message);
+    }
+    if (ErrorHandler::instance().error() > result.severity) {
+        result.severity = ErrorHandler::instance().error();
+    }
+}
+
+static KMime::Message::Ptr writeV3(const KolabObjectReader &reader, const QString &productId)
+{
+    switch (reader.getType()) {
+        case EventObject:
+        case TodoObject:
+        case JournalObject:
+            return KolabObjectWriter::writeIncidence(reader.getIncidence(), KolabV3, productId);
+        case ContactObject:
+            return KolabObjectWriter::writeContact(reader.getContact(), KolabV3, productId);
+        case DistlistObject:
+            return KolabObjectWriter::writeDistlist(reader.getDistlist(), KolabV3, productId);
+        case NoteObject:
+            return KolabObjectWriter::writeNote(reader.getNote(), KolabV3, productId);
+        case DictionaryConfigurationObject: {
+            QString lang;
+            const QStringList &dictionary = reader.getDictionary(lang);
+            return KolabObjectWriter::writeDictionary(dictionary, lang, KolabV3, productId);
+        }
+        case FreebusyObject:
+            return KolabObjectWriter::writeFreebusy(reader.getFreebusy(), KolabV3, productId);
+        default:
+            Critical() << "unknown object type";
+    }
+    return KMime::Message::Ptr();
+}
+
+static bool writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        Critical() << "failed to open " << fileName;
+        return false;
+    }
+    if (file.write(data) != data.size()) {
+        Critical() << "failed to write " << fileName;
+        return false;
+    }
+    return true;
+}
+
+Result upgradeMessage(const QString &sourceFile, const QString &targetFile, const QString &productId)
+{
+    Result result;
+    result.fileName = sourceFile;
+
+    ErrorHandler::clearErrors();
+    QFile file(sourceFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        Critical() << "failed to open " << sourceFile;
+        collectErrors(result);
+        return result;
+    }
+    const QByteArray data = file.readAll();
+    file.close();
+
+    KolabObjectReader reader;
+    result.type = reader.parseMessage(data);
+    result.version = reader.getVersion();
+    collectErrors(result);
+    if (result.type == InvalidObject || result.severity >= ErrorHandler::Critical) {
+        return result;
+    }
+
+    if (result.version == KolabV3) {
+        //Nothing to upgrade
+        ErrorHandler::clearErrors();
+        result.written = writeFile(targetFile, data);
+        collectErrors(result);
+        return result;
+    }
+
+    //The writer clears the errors of the reader, which we already collected
+    const KMime::Message::Ptr &v3message = writeV3(reader, productId);
+    if (v3message) {
+        result.written = writeFile(targetFile, v3message->encodedContent());
+    }
+    collectErrors(result);
+    return result;
+}
+
+//@cond PRIVATE
+struct Task {
+    QString source;
+    QString target;
+    QString tmp;
+    QString productId;
+};
+
+static Result runTask(const Task &task)
+{
+    Result result = upgradeMessage(task.source, task.tmp, task.productId);
+    if (result.written) {
+        QFile::remove(task.target);
+        if (!QFile::rename(task.tmp, task.target)) {
+            Critical() << "failed to move " << task.tmp << " to " << task.target;
+            result.written = false;
+            result.severity = ErrorHandler::Critical;
+            result.errors.append(QString::fromLatin1("failed to move the upgraded message to ") + task.target);
+        }
+    } else {
+        QFile::remove(task.tmp);
+    }
+    return result;
+}
+
+class TaskRunnable : public QRunnable
+{
+public:
+    TaskRunnable(const Task &task, Result &result)
+    :   mTask(task),
+        mResult(result)
+    {
+    }
+
+    void run()
+    {
+        mResult = runTask(mTask);
+    }
+
+private:
+    const Task &mTask;
+    Result &mResult;
+};
+
+/**
+ * Initializes lazily created global state, which must not be initialized concurrently from the worker threads.
+ *
+ * The workers don't share KTimeZone instances afterwards, the conversion reads its own per thread (see getTimeSpec()).
+ */
+static void warmUp()
+{
+    KMime::Codec::codecForName("base64");
+    KMime::Codec::codecForName("quoted-printable");
+    KSystemTimeZones::zones();
+    KSystemTimeZones::readZone(KSystemTimeZones::local().name());
+    KTimeZone::utc();
+}
+
+/**
+ * Returns the name of the source @param file in the cur folder of the target maildir.
+ *
+ * Messages without maildir info (i.e. from new) get the ":2," info that messages in cur carry.
+ * If the unique part of the name is already used by another message, it gets a suffix, so no message overwrites another.
+ */
+static QString curName(const QString &file, QSet<QString> &uniqueNames)
+{
+    const QString &name = QFileInfo(file).fileName();
+    const int colon = name.indexOf(QLatin1Char(':'));
+    const QString unique = (colon < 0) ? name : name.left(colon);
+    const QString info = (colon < 0) ? QString::fromLatin1(":2,") : name.mid(colon);
+    QString candidate = unique;
+    for (int i = 1; uniqueNames.contains(candidate); i++) {
+        candidate = unique + QLatin1Char('-') + QString::number(i);
+    }
+    uniqueNames.insert(candidate);
+    return candidate + info;
+}
+
+class MaildirUpgrader::Private
+{
+public:
+    Private(const QString &source, const QString &target)
+    :   mSourceDir(source),
+        mTargetDir(target),
+        mThreadCount(QThread::idealThreadCount()),
+        mElapsed(0)
+    {
+    }
+
+    QStringList sourceFiles() const;
+
+    QString mSourceDir;
+    QString mTargetDir;
+    QString mProductId;
+    int mThreadCount;
+    int mElapsed;
+    QList<Result> mResults;
+};
+
+QStringList MaildirUpgrader::Private::sourceFiles() const
+{
+    const QDir source(mSourceDir);
+    QStringList dirs;
+    if (source.exists(QLatin1String("cur")) || source.exists(QLatin1String("new"))) {
+        dirs << source.filePath(QLatin1String("cur")) << source.filePath(QLatin1String("new"));
+    } else {
+        dirs << mSourceDir;
+    }
+    QStringList files;
+    foreach (const QString &dir, dirs) {
+        const QDir d(dir);
+        foreach (const QString &entry, d.entryList(QDir::Files, QDir::Name)) {
+            files << d.filePath(entry);
+        }
+    }
+    return files;
+}
+//@endcond
+
+MaildirUpgrader::MaildirUpgrader(const QString &sourceDir, const QString &targetDir)
+: d( new MaildirUpgrader::Private(sourceDir, targetDir) )
+{
+}
+
+MaildirUpgrader::~MaildirUpgrader()
+{
+    delete d;
+}
+
+void MaildirUpgrader::setThreadCount(int count)
+{
+    d->mThreadCount = count;
+}
+
+void MaildirUpgrader::setProductId(const QString &productId)
+{
+    d->mProductId = productId;
+}
+
+bool MaildirUpgrader::run()
+{
+    d->mResults.clear();
+    d->mElapsed = 0;
+    QDir target(d->mTargetDir);
+    if (!target.mkpath(QLatin1String("cur")) || !target.mkpath(QLatin1String("new")) || !target.mkpath(QLatin1String("tmp"))) {
+        Critical() << "failed to create the maildir " << d->mTargetDir;
+        return false;
+    }
+
+    QList<Task> tasks;
+    QSet<QString> uniqueNames;
+    foreach (const QString &file, d->sourceFiles()) {
+        const QString &name = curName(file, uniqueNames);
+        Task task;
+        task.source = file;
+        task.target = target.filePath(QLatin1String("cur/") + name);
+        task.tmp = target.filePath(QLatin1String("tmp/") + name);
+        task.productId = d->mProductId;
+        tasks.append(task);
+    }
+
+    warmUp();
+    //The contacts of the maildir share their pictures, which are released when the run is done
+    const Conversion::PictureCacheBatch pictureCache;
+    QTime time;
+    time.start();
+    //A private pool, so the upgrade neither waits for nor limits other users of the global pool
+    QVector<Result> results(tasks.size());
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, d->mThreadCount));
+    for (int i = 0; i < tasks.size(); i++) {
+        pool.start(new TaskRunnable(tasks.at(i), results[i]));
+    }
+    pool.waitForDone();
+    d->mResults = results.toList();
+    d->mElapsed = time.elapsed();
+    return true;
+}
+
+const QList<Result> &MaildirUpgrader::results() const
+{
+    return d->mResults;
+}
+
+int MaildirUpgrader::messageCount() const
+{
+    return d->mResults.size();
+}
+
+int MaildirUpgrader::failedCount() const
+{
+    int count = 0;
+    foreach (const Result &result, d->mResults) {
+        if (!result.written || result.severity >= ErrorHandler::Error) {
+            count++;
+        }
+    }
+    return count;
+}
+
+QMap<ErrorHandler::Severity, int> MaildirUpgrader::severityCounts() const
+{
+    QMap<ErrorHandler::Severity, int> counts;
+    foreach (const Result &result, d->mResults) {
+        counts[result.severity]++;
+    }
+    return counts;
+}
+
+int MaildirUpgrader::elapsed() const
+{
+    return d->mElapsed;
+}
+
+double MaildirUpgrader::throughput() const
+{
+    if (d->mElapsed <= 0) {
+        return 0;
+    }
+    return d->mResults.size() * 1000.0 / d->mElapsed;
+}
+
+    }
+}
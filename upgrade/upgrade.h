@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2012  Christian Mollekopf <mollekopf@kolabsys.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KOLABUPGRADE_H
+#define KOLABUPGRADE_H
+
+#include "kolab_export.h"
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include "kolabformat/kolabdefinitions.h"
+#include "kolabformat/errorhandler.h"
+
+namespace Kolab {
+    namespace Upgrade {
+
+/**
+ * The outcome of the upgrade of a single message.
+ */
+struct KOLAB_EXPORT Result {
+    Result(): type(InvalidObject), version(KolabV2), written(false), severity(ErrorHandler::Debug) {};
+    QString fileName;
+    Kolab::ObjectType type;
+    /**
+     * The version of the source message
+     */
+    Kolab::Version version;
+    /**
+     * True if an upgraded message has been written.
+     */
+    bool written;
+    /**
+     * The worst error reported while reading and writing the message
+     */
+    ErrorHandler::Severity severity;
+    QStringList errors;
+};
+
+/**
+ * Upgrades a single v2 message in @param sourceFile to v3, and writes the result to @param targetFile.
+ *
+ * Messages which already are in v3 are copied unmodified.
+ */
+KOLAB_EXPORT Result upgradeMessage(const QString &sourceFile, const QString &targetFile, const QString &productId = QString());
+
+/**
+ * Upgrades all v2 messages in a maildir to v3.
+ *
+ * The messages in the cur and new subfolders of the source maildir (or the files in the source directory if it isn't a maildir),
+ * are written with the same file name to the cur subfolder of the target maildir. Messages without maildir info get ":2,",
+ * and a message whose unique name is already taken by another one gets a suffix.
+ * Files are first written to tmp and then moved to cur, so a partially written file never shows up in the target.
+ *
+ * Usage:
+ * @code
+ * MaildirUpgrader upgrader("/var/spool/imap/user/Calendar", "/tmp/Calendar");
+ * upgrader.run();
+ * if (upgrader.failedCount()) { ... }
+ * @endcode
+ */
+class KOLAB_EXPORT MaildirUpgrader
+{
+public:
+    MaildirUpgrader(const QString &sourceDir, const QString &targetDir);
+    ~MaildirUpgrader();
+
+    /**
+     * The number of threads, defaults to QThread::idealThreadCount().
+     *
+     * Each worker resolves its own KTimeZone instances, as these are not thread-safe to copy with kdelibs4.
+     * Other code in the process must not copy the timezones of KSystemTimeZones concurrently while the upgrade runs.
+     */
+    void setThreadCount(int);
+    void setProductId(const QString &);
+
+    /**
+     * Upgrades all messages and blocks until done.
+     *
+     * @return false if the target directory could not be created.
+     */
+    bool run();
+
+    const QList<Result> &results() const;
+    int messageCount() const;
+    /**
+     * The number of messages that could not be written or have been written with a severity of ErrorHandler::Error or worse.
+     */
+    int failedCount() const;
+    /**
+     * The number of messages per severity
+     */
+    QMap<ErrorHandler::Severity, int> severityCounts() const;
+    /**
+     * Elapsed time of the last run in milliseconds
+     */
+    int elapsed() const;
+    /**
+     * Messages per second of the last run
+     */
+    double throughput() const;
+
+private:
+    class Private;
+    Private *const d;
+};
+
+    }
+}
+
+#endif